@@ -1,16 +1,26 @@
 #include "baseparser.h"
 #include "datalog.h"
 #include "dataprocessing.h"
+#include "geokernels.h"
 
 #include <fstream>
 #include <iostream>
 #include <cassert>
 #include <math.h>
+#include <cfloat>
+#include <algorithm>
 
 #include <QDateTime.h>
 
+#define DIST_STUCK_FRACTION 0.5 // distance is stuck if it covers less than this fraction of the GPS distance
+#define DIST_STUCK_MIN_GPS_DIST 100.0 // m, GPS distance needed before the distance can be stuck
+#define GRADIENT_LIMIT 30.0 // %, max gradient (incase of noise in signal)
+#define FILTER_WINDOW_SIZE 10 // points, of the smoothed altitude and gradient
+
 /******************************************************/
-BaseParser::BaseParser()
+BaseParser::BaseParser():
+_parse_time(0.0),
+_post_process_time(0.0)
 {}
 
 /******************************************************/
@@ -18,87 +28,204 @@ BaseParser::~BaseParser()
 {}
 
 /******************************************************/
-void BaseParser::setDataValidFlags(DataLog& data_log)
+bool BaseParser::rebuildFromGps(DataLog& data_log)
 {
-	for (int i=0; i < data_log.numPoints(); ++i)
+	const int n = data_log.numPoints();
+	if (n < 3 || !data_log.ltdValid() || !data_log.lgdValid())
+		return false;
+
+	// Distance between consecutive points in one batch
+	data_log.computeGeoColumns();
+	const double* ltd_rad = &data_log.ltdRad()[0];
+	const double* lgd_rad = &data_log.lgdRad()[0];
+	const double* cos_ltd = &data_log.cosLtd()[0];
+	std::vector<double> gps_dist(n);
+	GeoKernels::haversineSegments(ltd_rad, lgd_rad, cos_ltd, n, &gps_dist[0]);
+
+	// Accumulate, measuring across points with no GPS fix from the last point with one
+	int last_fix = data_log.sampleValid(LOG_GPS, 0) ? 0 : -1;
+	for (int i=1; i < n; ++i)
 	{
-		if (data_log.time(i) != 0.0)
+		double step = 0.0;
+		if (data_log.sampleValid(LOG_GPS, i))
 		{
-			data_log.timeValid() = true;
+			if (last_fix == i-1)
+				step = gps_dist[i];
+			else if (last_fix >= 0)
+				GeoKernels::haversineDistances(ltd_rad+last_fix, lgd_rad+last_fix, cos_ltd+last_fix, ltd_rad+i, lgd_rad+i, cos_ltd+i, 1, &step);
+			last_fix = i;
 		}
+		gps_dist[i] = gps_dist[i-1] + step;
+	}
 
-		if (data_log.ltd(i) != 0.0 || data_log.lgd(i) != 0.0)
-		{
-			data_log.lgdValid() = true;
-			data_log.ltdValid() = true;
-		}
+	// Keep the recorded distance unless it is missing, or stuck well short of the GPS distance
+	const bool dist_stuck = gps_dist[n-1] > DIST_STUCK_MIN_GPS_DIST && data_log.dist(n-1) < DIST_STUCK_FRACTION*gps_dist[n-1];
+	if (data_log.distValid() && !dist_stuck)
+		return false;
 
-		if (data_log.alt(i) != 0.0)
-		{
-			data_log.altValid() = true;
-		}
+	std::copy(gps_dist.begin(), gps_dist.end(), data_log.dist().begin());
+	data_log.distValid() = true;
+	data_log.setAllSamplesValid(LOG_DIST);
+	return true;
+}
 
-		if (data_log.speed(i) != 0.0)
+/******************************************************/
+void BaseParser::postProcess(DataLog& data_log)
+{
+	const int n = data_log.numPoints();
+	if (n == 0)
+		return;
+
+	// Columns are allocated when first used, so only the channels the log has are read
+	const bool fill_gps = data_log.numValidSamples(LOG_GPS) > 0 && data_log.numValidSamples(LOG_DIST) > 0;
+	double* time = &data_log.time()[0];
+	double* ltd = fill_gps ? &data_log.ltd()[0] : 0;
+	double* lgd = fill_gps ? &data_log.lgd()[0] : 0;
+	const double* dist = fill_gps ? &data_log.dist()[0] : 0;
+	const quint64* gps_bits = &data_log.sampleValidBits(LOG_GPS)[0];
+
+	// Pass 1: relative times, and sporadic empty GPS points take the position of the point
+	// before. Filled points are read back as valid, so a run of empty points is filled
+	const double start_time = time[0];
+	bool time_valid = false;
+	time[0] = 0.0;
+	for (int i=1; i < n; ++i)
+	{
+		time[i] -= start_time;
+		time_valid |= (time[i] != 0.0);
+		if (!fill_gps)
+			continue;
+
+		const bool gps = (gps_bits[i >> 6] >> (i & 63)) & 1;
+		const bool gps_before = (gps_bits[(i-1) >> 6] >> ((i-1) & 63)) & 1;
+		if (!gps && gps_before && dist[i] != 0)
 		{
-			data_log.speedValid() = true;
+			ltd[i] = ltd[i-1];
+			lgd[i] = lgd[i-1];
+			data_log.setSampleValid(LOG_GPS, i);
 		}
+	}
 
-		if (data_log.heartRate(i) != 0.0)
-		{
-			data_log.heartRateValid() = true;
-		}
+	// A channel is valid if any of its samples is, counted a word of the bitmaps at a time
+	data_log.timeValid() = time_valid;
+	data_log.ltdValid() = data_log.lgdValid() = (data_log.numValidSamples(LOG_GPS) > 0);
+	data_log.altValid() = (data_log.numValidSamples(LOG_ALT) > 0);
+	data_log.speedValid() = (data_log.numValidSamples(LOG_SPEED) > 0);
+	data_log.heartRateValid() = (data_log.numValidSamples(LOG_HEART_RATE) > 0);
+	data_log.cadenceValid() = (data_log.numValidSamples(LOG_CADENCE) > 0);
+	data_log.distValid() = (data_log.numValidSamples(LOG_DIST) > 0);
+	data_log.powerValid() = (data_log.numValidSamples(LOG_POWER) > 0);
+	data_log.tempValid() = (data_log.numValidSamples(LOG_TEMP) > 0);
+
+	// Pass 2: smooth the altitude for computing the gradient
+	if (data_log.altValid() && n > 1)
+	{
+		DataProcessing::lowPassFilterSignal(data_log.alt(), data_log.altFltd(), FILTER_WINDOW_SIZE);
+		data_log.altFltdValid() = true;
+	}
 
-		if (data_log.cadence(i) != 0.0)
-		{
-			data_log.cadenceValid() = true;
-		}
+	// Rebuild a missing or stuck distance from GPS, so the speed and gradient follow it
+	if (rebuildFromGps(data_log))
+		data_log.computeMaps(); // the distance map is out of date
+
+	// The gradient and the speed (if not measured) are computed in the pass below, at every
+	// sample, from the distance
+	dist = data_log.distValid() ? &data_log.dist()[0] : 0;
+	const bool compute_gradient = data_log.altValid() && data_log.distValid() && n > 1;
+	const bool compute_speed = !data_log.speedValid() && data_log.distValid() && n > 1;
+	if (compute_gradient)
+	{
+		data_log.gradientValid() = true;
+		data_log.setAllSamplesValid(LOG_GRADIENT);
+	}
+	if (compute_speed)
+	{
+		data_log.speedValid() = true;
+		data_log.setAllSamplesValid(LOG_SPEED);
+	}
 
-		if (data_log.dist(i) != 0.0)
+	// Pass 3: the raw gradient, smoothed with a running sum over a window centred on each point
+	// (so the raw gradient runs half a window ahead), the speed, and the averages and maxima of
+	// all the channels over the samples with a reading. Each sample is weighted by its bit, and
+	// invalid samples are replaced with the lowest value. Channels with no reading are skipped
+	const double* alt_fltd = compute_gradient ? &data_log.altFltd()[0] : 0;
+	double* gradient = data_log.gradientValid() ? &data_log.gradient()[0] : 0;
+	double* speed = data_log.speedValid() ? &data_log.speed()[0] : 0;
+	std::vector<double> grad_raw(compute_gradient ? n : 0, 0.0);
+	const int half_window = FILTER_WINDOW_SIZE/2;
+	double grad_sum = 0.0;
+	int grad_lo = 0;
+	int grad_hi = 0;
+
+	const int num_stats = 5;
+	const LogChannel stats_channels[num_stats] = {LOG_SPEED, LOG_HEART_RATE, LOG_GRADIENT, LOG_CADENCE, LOG_POWER};
+	const double* stats_values[num_stats] = {
+		speed,
+		data_log.heartRateValid() ? &data_log.heartRate()[0] : 0,
+		gradient,
+		data_log.cadenceValid() ? &data_log.cadence()[0] : 0,
+		data_log.powerValid() ? &data_log.power()[0] : 0};
+	const quint64* stats_bits[num_stats];
+	double sum[num_stats];
+	int count[num_stats];
+	double max[num_stats];
+	for (int c=0; c < num_stats; ++c)
+	{
+		stats_bits[c] = &data_log.sampleValidBits(stats_channels[c])[0];
+		sum[c] = 0.0;
+		count[c] = 0;
+		max[c] = -DBL_MAX;
+	}
+
+	for (int i=0; i < n; ++i)
+	{
+		if (compute_gradient)
 		{
-			data_log.distValid() = true;
+			const int window_hi = std::min(n, i + half_window);
+			const int window_lo = std::max(0, i - half_window);
+			for (; grad_hi < window_hi; ++grad_hi)
+			{
+				const int j = grad_hi;
+				if (j > 0 && dist[j] - dist[j-1] > 1.0)
+					grad_raw[j] = std::min(std::max(100*(alt_fltd[j] - alt_fltd[j-1])/(dist[j] - dist[j-1]), -GRADIENT_LIMIT), GRADIENT_LIMIT);
+				grad_sum += grad_raw[j];
+			}
+			for (; grad_lo < window_lo; ++grad_lo)
+				grad_sum -= grad_raw[grad_lo];
+			gradient[i] = grad_sum/(grad_hi - grad_lo);
 		}
+		if (compute_speed && i > 1 && time[i] - time[i-2] > 0)
+			speed[i] = 3.6*(dist[i] - dist[i-2])/(time[i] - time[i-2]);
 
-		if (data_log.temp(i) != 0.0)
+		for (int c=0; c < num_stats; ++c)
 		{
-			data_log.tempValid() = true;
+			if (!stats_values[c])
+				continue;
+			const int valid = (int)((stats_bits[c][i >> 6] >> (i & 63)) & 1);
+			sum[c] += valid*stats_values[c][i];
+			count[c] += valid;
+			max[c] = std::max(max[c], valid ? stats_values[c][i] : -DBL_MAX);
 		}
 	}
 
-}
-
-/******************************************************/
-void BaseParser::computeAdditionalDetailts(DataLog& data_log)
-{
-	// Compute grad from smoothed gradient
-	if (data_log.altValid())
+	for (int c=0; c < num_stats; ++c)
 	{
-		DataProcessing::lowPassFilterSignal(data_log.alt(), data_log.altFltd());
-		data_log.altFltdValid() = true;
-		DataProcessing::computeGradient(data_log.altFltd(), data_log.dist(), data_log.gradient());
-		data_log.gradientValid() = true;
-	}
-	
-	// Compute speed if not already measured
-	if (!data_log.speedValid())
-	{
-		DataProcessing::computeSpeed(data_log.time(), data_log.dist(), data_log.speed());
-		data_log.speedValid() = true;
+		sum[c] = (count[c] > 0) ? sum[c]/count[c] : 0.0;
+		max[c] = (max[c] > -DBL_MAX) ? max[c] : 0.0;
 	}
-	
-	// Compute max and avg of all signals
-	data_log.avgSpeed() = DataProcessing::computeAverage(data_log.speed().begin(), data_log.speed().end());
-	data_log.avgHeartRate() = DataProcessing::computeAverage(data_log.heartRate().begin(), data_log.heartRate().end());
-	data_log.avgGradient() = DataProcessing::computeAverage(data_log.gradient().begin(), data_log.gradient().end());
-	data_log.avgCadence() = DataProcessing::computeAverage(data_log.cadence().begin(), data_log.cadence().end());
-	data_log.avgPower() = DataProcessing::computeAverage(data_log.power().begin(), data_log.power().end());
-
-	data_log.maxSpeed() = DataProcessing::computeMax(data_log.speed().begin(), data_log.speed().end());
-	data_log.maxHeartRate() = DataProcessing::computeMax(data_log.heartRate().begin(), data_log.heartRate().end());
-	data_log.maxGradient() = DataProcessing::computeMax(data_log.gradient().begin(), data_log.gradient().end());
-	data_log.maxCadence() = DataProcessing::computeMax(data_log.cadence().begin(), data_log.cadence().end());
-	data_log.maxPower() = DataProcessing::computeMax(data_log.power().begin(), data_log.power().end());
+	data_log.avgSpeed() = sum[0];
+	data_log.avgHeartRate() = sum[1];
+	data_log.avgGradient() = sum[2];
+	data_log.avgCadence() = sum[3];
+	data_log.avgPower() = sum[4];
+
+	data_log.maxSpeed() = max[0];
+	data_log.maxHeartRate() = max[1];
+	data_log.maxGradient() = max[2];
+	data_log.maxCadence() = max[3];
+	data_log.maxPower() = max[4];
 
 	// Totals
-	data_log.totalTime() = data_log.time(data_log.numPoints()-1);
-	data_log.totalDist() = data_log.dist(data_log.numPoints()-1);
+	data_log.totalTime() = time[n-1];
+	data_log.totalDist() = dist ? dist[n-1] : 0.0;
 }
\ No newline at end of file
@@ -16,11 +16,25 @@ class BaseParser
 	// Parses data from filename. Returns true if file was parsed successfully
 	virtual bool parse(const QString& filename, boost::shared_ptr<DataLog> data_log) = 0;
 
-	static void setDataValidFlags(DataLog& data_log);
-	static void computeAdditionalDetailts(DataLog& data_log);
+	// Post-processing stage run on every parsed or edited log: makes the times relative to the
+	// first point, fills sporadic GPS gaps, sets the validity flags, computes the smoothed
+	// altitude, rebuilds a missing distance from GPS, and computes the gradient, speed, averages,
+	// maxima and totals. The passes over the columns are fused, so each column is read as few times as possible
+	static void postProcess(DataLog& data_log);
+
+	// Time (ms) of the parse and post-process stages of the last parse
+	double parseTime() const { return _parse_time; }
+	double postProcessTime() const { return _post_process_time; }
+
  protected:
 	virtual bool parseRideDetails(boost::shared_ptr<DataLog> data_log) = 0;
-	
+
+	double _parse_time;
+	double _post_process_time;
+
+ private:
+	// Rebuild the distance from GPS if it is missing or stuck. Returns false if the distance was kept
+	static bool rebuildFromGps(DataLog& data_log);
  };
 
 #endif // BASEPARSER_H
\ No newline at end of file
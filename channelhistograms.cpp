@@ -0,0 +1,144 @@
+#include "channelhistograms.h"
+#include "datalog.h"
+#include "uniformlog.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+/**********************************/
+struct BinLayout
+{
+	double _min;
+	double _width;
+	int _num_bins;
+};
+
+// Bins of each channel, in HistogramChannel order
+static const BinLayout BIN_LAYOUTS[NUM_HISTOGRAM_CHANNELS] =
+{
+	{0.0, 5.0, 50}, // heart rate, 0-250 bpm
+	{0.0, 25.0, 80}, // power, 0-2000 W
+	{0.0, 5.0, 40}, // cadence, 0-200 rpm
+	{0.0, 1.0, 100}, // speed, 0-100 kmh
+	{-30.0, 1.0, 60} // gradient, -30-30 %
+};
+
+/****************************************/
+ChannelHistograms::ChannelHistograms()
+{
+	clear();
+}
+
+/****************************************/
+ChannelHistograms::~ChannelHistograms()
+{}
+
+/****************************************/
+void ChannelHistograms::clear()
+{
+	for (int c=0; c < NUM_HISTOGRAM_CHANNELS; ++c)
+		_bins[c].assign(BIN_LAYOUTS[c]._num_bins, 0.0);
+}
+
+/****************************************/
+int ChannelHistograms::numBins(HistogramChannel channel)
+{
+	return BIN_LAYOUTS[channel]._num_bins;
+}
+
+/****************************************/
+double ChannelHistograms::binWidth(HistogramChannel channel)
+{
+	return BIN_LAYOUTS[channel]._width;
+}
+
+/****************************************/
+double ChannelHistograms::binMin(HistogramChannel channel)
+{
+	return BIN_LAYOUTS[channel]._min;
+}
+
+/****************************************/
+int ChannelHistograms::bin(HistogramChannel channel, double value)
+{
+	const BinLayout& layout = BIN_LAYOUTS[channel];
+	const int b = (int)floor((value - layout._min)/layout._width);
+	return std::min(std::max(b, 0), layout._num_bins - 1);
+}
+
+/****************************************/
+void ChannelHistograms::addRide(DataLog& data_log, int idx_start, int idx_end)
+{
+	if (idx_end < 0)
+		idx_end = data_log.numPoints();
+	assert(idx_start >= 0 && idx_end <= data_log.numPoints());
+
+	const bool valid[NUM_HISTOGRAM_CHANNELS] =
+	{
+		data_log.heartRateValid(),
+		data_log.powerValid(),
+		data_log.cadenceValid(),
+		data_log.speedValid(),
+		data_log.gradientValid()
+	};
+
+	for (int i=std::max(idx_start, 1); i < idx_end; ++i)
+	{
+		// Gaps (auto-pause, lost signal) have no data, as in UniformLog
+		const double dt = data_log.time(i) - data_log.time(i-1);
+		if (dt <= 0.0 || dt > UNIFORM_GAP_THD)
+			continue;
+
+		if (valid[HISTOGRAM_HEART_RATE] && data_log.sampleValid(LOG_HEART_RATE, i))
+			_bins[HISTOGRAM_HEART_RATE][bin(HISTOGRAM_HEART_RATE, data_log.heartRate(i))] += dt;
+		if (valid[HISTOGRAM_POWER] && data_log.sampleValid(LOG_POWER, i))
+			_bins[HISTOGRAM_POWER][bin(HISTOGRAM_POWER, data_log.power(i))] += dt;
+		if (valid[HISTOGRAM_CADENCE] && data_log.sampleValid(LOG_CADENCE, i))
+			_bins[HISTOGRAM_CADENCE][bin(HISTOGRAM_CADENCE, data_log.cadence(i))] += dt;
+		if (valid[HISTOGRAM_SPEED] && data_log.sampleValid(LOG_SPEED, i))
+			_bins[HISTOGRAM_SPEED][bin(HISTOGRAM_SPEED, data_log.speed(i))] += dt;
+		if (valid[HISTOGRAM_GRADIENT])
+			_bins[HISTOGRAM_GRADIENT][bin(HISTOGRAM_GRADIENT, data_log.gradient(i))] += dt;
+	}
+}
+
+/****************************************/
+void ChannelHistograms::merge(const ChannelHistograms& other)
+{
+	for (int c=0; c < NUM_HISTOGRAM_CHANNELS; ++c)
+	{
+		for (unsigned int b=0; b < _bins[c].size(); ++b)
+			_bins[c][b] += other._bins[c][b];
+	}
+}
+
+/****************************************/
+double ChannelHistograms::binTime(HistogramChannel channel, int bin) const
+{
+	assert(bin >= 0 && bin < (int)_bins[channel].size());
+	return _bins[channel][bin];
+}
+
+/****************************************/
+double ChannelHistograms::timeInRange(HistogramChannel channel, double min_value, double max_value) const
+{
+	// Bins whose lower edge is in the range
+	const BinLayout& layout = BIN_LAYOUTS[channel];
+	const int first = std::max((int)ceil((min_value - layout._min)/layout._width), 0);
+	const int last = std::min((int)ceil((max_value - layout._min)/layout._width), layout._num_bins);
+
+	double time = 0.0;
+	for (int b=first; b < last; ++b)
+		time += _bins[channel][b];
+	return time;
+}
+
+/****************************************/
+double ChannelHistograms::totalTime(HistogramChannel channel) const
+{
+	double time = 0.0;
+	for (unsigned int b=0; b < _bins[channel].size(); ++b)
+		time += _bins[channel][b];
+	return time;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef CHANNELHISTOGRAMS_H
+#define CHANNELHISTOGRAMS_H
+
+#include <vector>
+
+class DataLog;
+
+// Channels with a histogram
+enum HistogramChannel
+{
+	HISTOGRAM_HEART_RATE = 0,
+	HISTOGRAM_POWER,
+	HISTOGRAM_CADENCE,
+	HISTOGRAM_SPEED,
+	HISTOGRAM_GRADIENT,
+	NUM_HISTOGRAM_CHANNELS
+};
+
+/* Class to hold the time spent in fixed width bins of each channel (eg. seconds at
+   250-275 W). The bins are the same for every ride, so the histograms of several rides
+   are merged by adding them. Values outside the bins count in the first or last bin. */
+
+class ChannelHistograms
+ {
+ public:
+	ChannelHistograms();
+	~ChannelHistograms();
+
+	void clear();
+
+	// Add the points of a log from idx_start to idx_end (exclusive, -1 for all points), in one pass.
+	// The time since the previous point counts towards the value of the point, unless it is a gap
+	void addRide(DataLog& data_log, int idx_start = 0, int idx_end = -1);
+
+	// Add the histograms of other rides
+	void merge(const ChannelHistograms& other);
+
+	// Bin layout of a channel
+	static int numBins(HistogramChannel channel);
+	static double binWidth(HistogramChannel channel);
+	static double binMin(HistogramChannel channel); // lower edge of the first bin
+	static int bin(HistogramChannel channel, double value);
+
+	// Time (sec) in a bin
+	double binTime(HistogramChannel channel, int bin) const;
+	std::vector<double>& bins(HistogramChannel channel) { return _bins[channel]; }
+	const std::vector<double>& bins(HistogramChannel channel) const { return _bins[channel]; }
+
+	// Time (sec) in the bins from min_value to max_value (exclusive)
+	double timeInRange(HistogramChannel channel, double min_value, double max_value) const;
+
+	// Total time (sec) with a value of the channel
+	double totalTime(HistogramChannel channel) const;
+
+ private:
+	std::vector<double> _bins[NUM_HISTOGRAM_CHANNELS]; // sec
+ };
+
+#endif // CHANNELHISTOGRAMS_H
\ No newline at end of file
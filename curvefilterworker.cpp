@@ -0,0 +1,135 @@
+#include "curvefilterworker.h"
+#include "datalog.h"
+#include "dataprocessing.h"
+
+#include <QMutexLocker.h>
+
+/****************************************/
+// Swap the vectors of 2 sets of curves
+static void swapCurves(FilteredCurves& curves1, FilteredCurves& curves2)
+{
+	curves1._heart_rate.swap(curves2._heart_rate);
+	curves1._speed.swap(curves2._speed);
+	curves1._cadence.swap(curves2._cadence);
+	curves1._alt.swap(curves2._alt);
+	curves1._gradient.swap(curves2._gradient);
+	curves1._power.swap(curves2._power);
+}
+
+/****************************************/
+CurveFilterWorker::CurveFilterWorker():
+_request_window_size(0),
+_quit(false),
+_generation(0),
+_started_generation(0),
+_result_generation(-1),
+_result_window_size(0)
+{}
+
+/****************************************/
+CurveFilterWorker::~CurveFilterWorker()
+{
+	{
+		QMutexLocker lock(&_mutex);
+		_quit = true;
+		_generation.fetchAndAddOrdered(1); // drop the current request
+		_request_added.wakeAll();
+	}
+	wait();
+}
+
+/****************************************/
+void CurveFilterWorker::request(boost::shared_ptr<DataLog> data_log, int window_size)
+{
+	QMutexLocker lock(&_mutex);
+	_request_log = data_log;
+	_request_window_size = window_size;
+	_generation.fetchAndAddOrdered(1);
+	_request_added.wakeAll();
+
+	if (!isRunning())
+		start(QThread::LowPriority);
+}
+
+/****************************************/
+void CurveFilterWorker::cancel()
+{
+	QMutexLocker lock(&_mutex);
+	_request_log.reset();
+	_generation.fetchAndAddOrdered(1);
+}
+
+/****************************************/
+bool CurveFilterWorker::takeResult(boost::shared_ptr<DataLog>& data_log)
+{
+	QMutexLocker lock(&_mutex);
+	if (!_result_log || _result_generation != _generation.loadAcquire() || _result_log.get() != data_log.get())
+		return false;
+
+	// Swap the buffers, the old filtered channels are reused for the next result
+	data_log->heartRateFltd().swap(_result._heart_rate);
+	data_log->speedFltd().swap(_result._speed);
+	data_log->cadenceFltd().swap(_result._cadence);
+	data_log->altFltd().swap(_result._alt);
+	data_log->gradientFltd().swap(_result._gradient);
+	data_log->powerFltd().swap(_result._power);
+	data_log->filterWindowSize() = _result_window_size;
+	_result_log.reset();
+	return true;
+}
+
+/****************************************/
+bool CurveFilterWorker::filter(int generation, int window_size, const std::vector<double>& signal, std::vector<double>& filtered) const
+{
+	if (_generation.loadAcquire() != generation)
+		return false;
+
+	DataProcessing::lowPassFilterSignal(signal, filtered, window_size);
+	return true;
+}
+
+/****************************************/
+void CurveFilterWorker::run()
+{
+	while (true)
+	{
+		// Wait for a request newer than the last one taken
+		boost::shared_ptr<DataLog> data_log;
+		int window_size, generation;
+		{
+			QMutexLocker lock(&_mutex);
+			while (!_quit && (!_request_log || _generation.loadAcquire() == _started_generation))
+				_request_added.wait(&_mutex);
+			if (_quit)
+				break;
+
+			data_log = _request_log;
+			window_size = _request_window_size;
+			generation = _generation.loadAcquire();
+			_started_generation = generation;
+		}
+
+		// Filter channel by channel, giving up as soon as a newer request comes in
+		const bool complete =
+			filter(generation, window_size, data_log->heartRate(), _work._heart_rate) &&
+			filter(generation, window_size, data_log->speed(), _work._speed) &&
+			filter(generation, window_size, data_log->cadence(), _work._cadence) &&
+			filter(generation, window_size, data_log->alt(), _work._alt) &&
+			filter(generation, window_size, data_log->gradient(), _work._gradient) &&
+			filter(generation, window_size, data_log->power(), _work._power);
+		if (!complete)
+			continue;
+
+		{
+			QMutexLocker lock(&_mutex);
+			if (_generation.loadAcquire() != generation)
+				continue;
+
+			swapCurves(_work, _result);
+			_result_log = data_log;
+			_result_generation = generation;
+			_result_window_size = window_size;
+		}
+		emit resultReady();
+	}
+}
\ No newline at end of file
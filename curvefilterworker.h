@@ -0,0 +1,80 @@
+#ifndef CURVEFILTERWORKER_H
+#define CURVEFILTERWORKER_H
+
+#include <QThread.h>
+#include <QMutex.h>
+#include <QWaitCondition.h>
+#include <QAtomicInt.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class DataLog;
+
+/**********************************/
+// The smoothed channels of a log
+struct FilteredCurves
+{
+	std::vector<double> _heart_rate;
+	std::vector<double> _speed;
+	std::vector<double> _cadence;
+	std::vector<double> _alt;
+	std::vector<double> _gradient;
+	std::vector<double> _power;
+};
+
+/* Thread which smooths the channels of a log in the background, so changing the smoothing
+   does not block the GUI. Only the latest request matters: a new request makes the worker
+   drop the one it is working on, and results of old requests are never handed over.
+   The worker filters into its own buffer and swaps it with a ready buffer when done, which
+   the GUI thread then swaps with the filtered channels of the log, so no vectors are copied. */
+
+class CurveFilterWorker : public QThread
+{
+	Q_OBJECT
+ public:
+	CurveFilterWorker();
+	~CurveFilterWorker();
+
+	// Smooth the channels of a log with a window size, replacing any earlier request.
+	// The raw channels of the log must not change until the result is taken
+	void request(boost::shared_ptr<DataLog> data_log, int window_size);
+
+	// Drop any request, eg. when another log is displayed
+	void cancel();
+
+	// Swap the result of the latest request into the filtered channels of its log, and set the
+	// filter window size of the log. Returns false if there is no result, or it is for an old request
+	bool takeResult(boost::shared_ptr<DataLog>& data_log);
+
+ signals:
+	// Emitted from the worker thread when a result is ready
+	void resultReady();
+
+ protected:
+	void run();
+
+ private:
+	// Filter a channel unless the request has been replaced. Returns false if it was
+	bool filter(int generation, int window_size, const std::vector<double>& signal, std::vector<double>& filtered) const;
+
+	QMutex _mutex;
+	QWaitCondition _request_added;
+
+	// Latest request, guarded by the mutex
+	boost::shared_ptr<DataLog> _request_log;
+	int _request_window_size;
+	bool _quit;
+
+	QAtomicInt _generation; // incremented by each request, the worker drops work for older ones
+	int _started_generation; // generation of the request taken by the worker
+
+	FilteredCurves _work; // filled by the worker
+	FilteredCurves _result; // latest complete result, guarded by the mutex
+	boost::shared_ptr<DataLog> _result_log;
+	int _result_generation;
+	int _result_window_size;
+};
+
+#endif // CURVEFILTERWORKER_H
\ No newline at end of file
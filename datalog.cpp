@@ -1,5 +1,9 @@
 #include "datalog.h"
+#include "geokernels.h"
+#include "dataprocessing.h"
 #include <cassert>
+#include <cmath>
+#include <limits>
 #include <numeric>
 #include <algorithm>
 #include <iostream>
@@ -7,6 +11,75 @@
 
 #include <QDateTime.h>
 
+/****************************************/
+bool DerivedKey::operator<(const DerivedKey& other) const
+{
+	if (_channel != other._channel)
+		return _channel < other._channel;
+	if (_operation != other._operation)
+		return _operation < other._operation;
+	if (_param1 != other._param1)
+		return _param1 < other._param1;
+	return _param2 < other._param2;
+}
+
+/****************************************/
+// Pack a column into integers of value*scale, clamped to the range of the type. Columns with
+// no valid samples are not stored. The double column is freed
+template <typename T>
+static void packIntColumn(std::vector<double>& column, bool valid, double scale, std::vector<T>& packed)
+{
+	packed.clear();
+	if (valid)
+	{
+		const double min_value = (double)std::numeric_limits<T>::min();
+		const double max_value = (double)std::numeric_limits<T>::max();
+		packed.resize(column.size());
+		for (unsigned int i=0; i < column.size(); ++i)
+			packed[i] = (T)std::min(std::max(floor(column[i]*scale + 0.5), min_value), max_value);
+	}
+	std::vector<double>().swap(column);
+}
+
+/****************************************/
+// Pack a column into floats
+static void packFloatColumn(std::vector<double>& column, bool valid, std::vector<float>& packed)
+{
+	packed.clear();
+	if (valid)
+		packed.assign(column.begin(), column.end());
+	std::vector<double>().swap(column);
+}
+
+/****************************************/
+// Unpack a column packed with packIntColumn or packFloatColumn. A column which was not stored
+// is left unallocated, it is allocated with zeros when first used
+template <typename T>
+static void unpackColumn(std::vector<T>& packed, double scale, std::vector<double>& column)
+{
+	column.resize(packed.size());
+	for (unsigned int i=0; i < packed.size(); ++i)
+		column[i] = packed[i]/scale;
+	std::vector<T>().swap(packed);
+}
+
+/****************************************/
+// Resize a column of the points if it is allocated
+static void resizeColumn(std::vector<double>& column, int size)
+{
+	if (!column.empty())
+		column.resize(size, 0.0);
+}
+
+/****************************************/
+// Reallocate a column to its size
+template <typename T>
+static void shrinkColumn(std::vector<T>& column)
+{
+	if (column.capacity() > column.size())
+		std::vector<T>(column).swap(column);
+}
+
 /****************************************/
 DataLog::DataLog():
 _filename(""),
@@ -21,6 +94,14 @@ _avg_speed(0.0),
 _avg_heart_rate(0.0),
 _avg_gradient(0.0),
 _avg_cadence(0.0),
+_compact(false),
+_origin_ltd(0.0),
+_origin_lgd(0.0),
+_geo_columns_valid(false),
+_derived_use_count(0),
+_derived_bytes(0),
+_derived_budget(DERIVED_CACHE_BUDGET),
+_filter_window_size(0),
 _lap_indecies(),
 _modified(false)
 {
@@ -44,7 +125,7 @@ double& DataLog::time(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _time[idx]; 
+	return column(_time)[idx]; 
 }
 
 /****************************************/
@@ -52,7 +133,7 @@ double& DataLog::ltd(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _ltd[idx]; 
+	return column(_ltd)[idx]; 
 }
 
 /****************************************/
@@ -60,7 +141,7 @@ double& DataLog::lgd(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _lgd[idx]; 
+	return column(_lgd)[idx]; 
 }
 
 /****************************************/
@@ -68,7 +149,7 @@ double& DataLog::alt(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _alt[idx]; 
+	return column(_alt)[idx]; 
 }
 
 /****************************************/
@@ -76,7 +157,7 @@ double& DataLog::dist(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _dist[idx]; 
+	return column(_dist)[idx]; 
 }
 
 /****************************************/
@@ -84,7 +165,7 @@ double& DataLog::heartRate(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _heart_rate[idx]; 
+	return column(_heart_rate)[idx]; 
 }
 
 /****************************************/
@@ -92,7 +173,7 @@ double& DataLog::cadence(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _cadence[idx]; 
+	return column(_cadence)[idx]; 
 }
 
 /****************************************/
@@ -100,7 +181,7 @@ double& DataLog::speed(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _speed[idx]; 
+	return column(_speed)[idx]; 
 }
 
 /****************************************/
@@ -108,7 +189,7 @@ double& DataLog::gradient(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _gradient[idx]; 
+	return column(_gradient)[idx]; 
 }
 
 /****************************************/
@@ -116,7 +197,7 @@ double& DataLog::power(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _power[idx]; 
+	return column(_power)[idx]; 
 }
 
 /****************************************/
@@ -124,7 +205,7 @@ double& DataLog::temp(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _temp[idx]; 
+	return column(_temp)[idx]; 
 }
 
 /****************************************/
@@ -132,7 +213,7 @@ double& DataLog::altFltd(int idx)
 { 
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _alt_fltd[idx]; 
+	return column(_alt_fltd)[idx]; 
 }
 
 /****************************************/
@@ -140,7 +221,7 @@ double& DataLog::heartRateFltd(int idx)
 {
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _heart_rate_fltd[idx]; 
+	return column(_heart_rate_fltd)[idx]; 
 }
 
 /****************************************/
@@ -148,7 +229,7 @@ double& DataLog::cadenceFltd(int idx)
 {
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _cadence_fltd[idx]; 
+	return column(_cadence_fltd)[idx]; 
 }
 
 /****************************************/
@@ -156,7 +237,7 @@ double& DataLog::speedFltd(int idx)
 {
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _speed_fltd[idx]; 
+	return column(_speed_fltd)[idx]; 
 }
 
 /****************************************/
@@ -164,7 +245,7 @@ double& DataLog::gradientFltd(int idx)
 {
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _gradient_fltd[idx]; 
+	return column(_gradient_fltd)[idx]; 
 }
 
 /****************************************/
@@ -172,7 +253,7 @@ double& DataLog::powerFltd(int idx)
 {
 	assert(idx >= 0); 
 	assert(idx < _num_points);
-	return _power_fltd[idx]; 
+	return column(_power_fltd)[idx]; 
 }
 
 
@@ -181,25 +262,35 @@ void DataLog::resize(int size)
 {
 	assert(size >= 0);
 
+	// Columns are allocated when first used, so only the allocated columns are resized
 	_num_points = size;
-	_time.resize(size);
-	_ltd.resize(size);
-	_lgd.resize(size);
-	_alt.resize(size);
-	_dist.resize(size);
-	_heart_rate.resize(size);
-	_cadence.resize(size);
-	_speed.resize(size);
-	_gradient.resize(size);
-	_power.resize(size);
-	_temp.resize(size);
-
-	_alt_fltd.resize(size);
-	_heart_rate_fltd.resize(size);
-	_cadence_fltd.resize(size);
-	_speed_fltd.resize(size);
-	_gradient_fltd.resize(size);
-	_power_fltd.resize(size);
+	resizeColumn(_time, size);
+	resizeColumn(_ltd, size);
+	resizeColumn(_lgd, size);
+	resizeColumn(_alt, size);
+	resizeColumn(_dist, size);
+	resizeColumn(_heart_rate, size);
+	resizeColumn(_cadence, size);
+	resizeColumn(_speed, size);
+	resizeColumn(_gradient, size);
+	resizeColumn(_power, size);
+	resizeColumn(_temp, size);
+
+	resizeColumn(_alt_fltd, size);
+	resizeColumn(_heart_rate_fltd, size);
+	resizeColumn(_cadence_fltd, size);
+	resizeColumn(_speed_fltd, size);
+	resizeColumn(_gradient_fltd, size);
+	resizeColumn(_power_fltd, size);
+
+	// Bits past the last sample are kept clear
+	const int num_words = (size + 63)/64;
+	for (int c=0; c < NUM_LOG_CHANNELS; ++c)
+	{
+		_sample_valid[c].resize(num_words, 0);
+		if (size % 64 != 0)
+			_sample_valid[c].back() &= (Q_UINT64_C(1) << (size % 64)) - 1;
+	}
 
 	_time_to_index.clear();
 	_dist_to_index.clear();
@@ -222,6 +313,70 @@ void DataLog::resize(int size)
 	_speed_fltd_valid = false;
 	_gradient_fltd_valid = false;
 	_power_fltd_valid = false;
+
+	_ltd_rad.clear();
+	_lgd_rad.clear();
+	_cos_ltd.clear();
+	_east.clear();
+	_north.clear();
+	_geo_columns_valid = false;
+
+	_compact_columns = CompactColumns();
+	_compact = false;
+
+	clearDerived();
+}
+
+/****************************************/
+void DataLog::setSampleValid(LogChannel channel, int idx, bool valid)
+{
+	assert(idx >= 0 && idx < _num_points);
+
+	const quint64 bit = Q_UINT64_C(1) << (idx % 64);
+	if (valid)
+		_sample_valid[channel][idx/64] |= bit;
+	else
+		_sample_valid[channel][idx/64] &= ~bit;
+}
+
+/****************************************/
+bool DataLog::sampleValid(LogChannel channel, int idx) const
+{
+	assert(idx >= 0 && idx < _num_points);
+	return (_sample_valid[channel][idx/64] >> (idx % 64)) & 1;
+}
+
+/****************************************/
+void DataLog::setAllSamplesValid(LogChannel channel)
+{
+	std::vector<quint64>& bits = _sample_valid[channel];
+	std::fill(bits.begin(), bits.end(), ~Q_UINT64_C(0));
+	if (_num_points % 64 != 0)
+		bits.back() = (Q_UINT64_C(1) << (_num_points % 64)) - 1;
+}
+
+/****************************************/
+int DataLog::numValidSamples(LogChannel channel) const
+{
+	int count = 0;
+	const std::vector<quint64>& bits = _sample_valid[channel];
+	for (unsigned int w=0; w < bits.size(); ++w)
+	{
+		// Population count of the word
+		quint64 x = bits[w];
+		x = x - ((x >> 1) & Q_UINT64_C(0x5555555555555555));
+		x = (x & Q_UINT64_C(0x3333333333333333)) + ((x >> 2) & Q_UINT64_C(0x3333333333333333));
+		x = (x + (x >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+		count += (int)((x*Q_UINT64_C(0x0101010101010101)) >> 56);
+	}
+	return count;
+}
+
+/****************************************/
+void DataLog::copySampleValid(const DataLog& source, int source_idx, int idx)
+{
+	for (int c=0; c < NUM_LOG_CHANNELS; ++c)
+		setSampleValid((LogChannel)c, idx, source.sampleValid((LogChannel)c, source_idx));
 }
 
 /****************************************/
@@ -243,9 +398,66 @@ void DataLog::addLap(std::pair<int, int>& lap)
 	_lap_indecies.push_back(lap);
 }
 
+/****************************************/
+void DataLog::computeGeoColumns()
+{
+	if (_geo_columns_valid)
+		return;
+
+	const int n = numPoints();
+	const std::vector<double>& ltd = column(_ltd);
+	const std::vector<double>& lgd = column(_lgd);
+	_ltd_rad.resize(n);
+	_lgd_rad.resize(n);
+	_cos_ltd.resize(n);
+	_east.resize(n);
+	_north.resize(n);
+
+	// Centroid of the points with a GPS fix
+	double sum_ltd = 0.0;
+	double sum_lgd = 0.0;
+	int num_gps = 0;
+	for (int i=0; i < n; ++i)
+	{
+		if (sampleValid(LOG_GPS, i))
+		{
+			sum_ltd += ltd[i];
+			sum_lgd += lgd[i];
+			++num_gps;
+		}
+	}
+	_origin_ltd = (num_gps > 0) ? sum_ltd/num_gps : 0.0;
+	_origin_lgd = (num_gps > 0) ? sum_lgd/num_gps : 0.0;
+
+	const double origin_ltd_rad = _origin_ltd*DEG_TO_RAD;
+	const double origin_lgd_rad = _origin_lgd*DEG_TO_RAD;
+	const double origin_cos_ltd = cos(origin_ltd_rad);
+	for (int i=0; i < n; ++i)
+	{
+		_ltd_rad[i] = ltd[i]*DEG_TO_RAD;
+		_lgd_rad[i] = lgd[i]*DEG_TO_RAD;
+		_cos_ltd[i] = cos(_ltd_rad[i]);
+		_east[i] = EARTH_RADIUS_M*(_lgd_rad[i] - origin_lgd_rad)*origin_cos_ltd;
+		_north[i] = EARTH_RADIUS_M*(_ltd_rad[i] - origin_ltd_rad);
+	}
+
+	_geo_columns_valid = true;
+}
+
+/****************************************/
+void DataLog::toLocal(double ltd_rad, double lgd_rad, double& east, double& north) const
+{
+	const double origin_ltd_rad = _origin_ltd*DEG_TO_RAD;
+	east = EARTH_RADIUS_M*(lgd_rad - _origin_lgd*DEG_TO_RAD)*cos(origin_ltd_rad);
+	north = EARTH_RADIUS_M*(ltd_rad - origin_ltd_rad);
+}
+
 /****************************************/
 void DataLog::computeMaps()
 {
+	_time_to_index.clear();
+	_dist_to_index.clear();
+
 	// Time to index
 	for (int i=0; i < numPoints(); ++i)
 	{
@@ -306,6 +518,103 @@ void DataLog::saveToTextFile(const QString& filename)
 	file.close();
 }
 
+/****************************************/
+void DataLog::shrinkToFit()
+{
+	shrinkColumn(_time);
+	shrinkColumn(_ltd);
+	shrinkColumn(_lgd);
+	shrinkColumn(_alt);
+	shrinkColumn(_dist);
+	shrinkColumn(_heart_rate);
+	shrinkColumn(_cadence);
+	shrinkColumn(_speed);
+	shrinkColumn(_gradient);
+	shrinkColumn(_power);
+	shrinkColumn(_temp);
+
+	shrinkColumn(_alt_fltd);
+	shrinkColumn(_heart_rate_fltd);
+	shrinkColumn(_cadence_fltd);
+	shrinkColumn(_speed_fltd);
+	shrinkColumn(_gradient_fltd);
+	shrinkColumn(_power_fltd);
+
+	for (int c=0; c < NUM_LOG_CHANNELS; ++c)
+		shrinkColumn(_sample_valid[c]);
+}
+
+/****************************************/
+void DataLog::compact()
+{
+	if (_compact)
+		return;
+
+	packFloatColumn(_time, _time_valid, _compact_columns._time);
+	packIntColumn(_ltd, _ltd_valid, 1e7, _compact_columns._ltd);
+	packIntColumn(_lgd, _lgd_valid, 1e7, _compact_columns._lgd);
+	packFloatColumn(_alt, _alt_valid, _compact_columns._alt);
+	packFloatColumn(_dist, _dist_valid, _compact_columns._dist);
+	packIntColumn(_heart_rate, _heart_rate_valid, 1.0, _compact_columns._heart_rate);
+	packIntColumn(_cadence, _cadence_valid, 1.0, _compact_columns._cadence);
+	packFloatColumn(_speed, _speed_valid, _compact_columns._speed);
+	packFloatColumn(_gradient, _gradient_valid, _compact_columns._gradient);
+	packIntColumn(_power, _power_valid, 1.0, _compact_columns._power);
+	packIntColumn(_temp, _temp_valid, 1.0, _compact_columns._temp);
+
+	// Filtered and derived data is recomputed when needed
+	std::vector<double>().swap(_alt_fltd);
+	std::vector<double>().swap(_heart_rate_fltd);
+	std::vector<double>().swap(_cadence_fltd);
+	std::vector<double>().swap(_speed_fltd);
+	std::vector<double>().swap(_gradient_fltd);
+	std::vector<double>().swap(_power_fltd);
+	_alt_fltd_valid = false;
+	_heart_rate_fltd_valid = false;
+	_cadence_fltd_valid = false;
+	_speed_fltd_valid = false;
+	_gradient_fltd_valid = false;
+	_power_fltd_valid = false;
+
+	std::vector<double>().swap(_ltd_rad);
+	std::vector<double>().swap(_lgd_rad);
+	std::vector<double>().swap(_cos_ltd);
+	std::vector<double>().swap(_east);
+	std::vector<double>().swap(_north);
+	_geo_columns_valid = false;
+	clearDerived();
+
+	_compact = true;
+}
+
+/****************************************/
+void DataLog::expand()
+{
+	if (!_compact)
+		return;
+
+	unpackColumn(_compact_columns._time, 1.0, _time);
+	unpackColumn(_compact_columns._ltd, 1e7, _ltd);
+	unpackColumn(_compact_columns._lgd, 1e7, _lgd);
+	unpackColumn(_compact_columns._alt, 1.0, _alt);
+	unpackColumn(_compact_columns._dist, 1.0, _dist);
+	unpackColumn(_compact_columns._heart_rate, 1.0, _heart_rate);
+	unpackColumn(_compact_columns._cadence, 1.0, _cadence);
+	unpackColumn(_compact_columns._speed, 1.0, _speed);
+	unpackColumn(_compact_columns._gradient, 1.0, _gradient);
+	unpackColumn(_compact_columns._power, 1.0, _power);
+	unpackColumn(_compact_columns._temp, 1.0, _temp);
+
+	_compact = false;
+
+	// The smoothed altitude is used for the gradient and elevation gain
+	if (_alt_valid && _num_points > 1)
+	{
+		DataProcessing::lowPassFilterSignal(_alt, _alt_fltd);
+		_alt_fltd_valid = true;
+	}
+}
+
 /****************************************/
 bool DataLog::isModified() const
 {
@@ -316,4 +625,76 @@ bool DataLog::isModified() const
 void DataLog::setModified(bool modified)
 {
 	_modified = modified;
+
+	// The GPS points and channels may have been edited
+	if (modified)
+	{
+		_geo_columns_valid = false;
+		clearDerived();
+	}
+}
+
+/****************************************/
+const std::vector<double>* DataLog::findDerived(const DerivedKey& key)
+{
+	QMap<DerivedKey, DerivedEntry>::iterator it = _derived.find(key);
+	if (it == _derived.end())
+		return 0;
+
+	it.value()._last_use = ++_derived_use_count;
+	return &it.value()._values;
+}
+
+/****************************************/
+void DataLog::storeDerived(const DerivedKey& key, const std::vector<double>& values)
+{
+	QMap<DerivedKey, DerivedEntry>::iterator it = _derived.find(key);
+	if (it != _derived.end())
+	{
+		_derived_bytes -= it.value()._values.size()*sizeof(double);
+		_derived.erase(it);
+	}
+
+	const int bytes = values.size()*sizeof(double);
+	if (bytes > _derived_budget)
+		return;
+
+	evictDerived(_derived_budget - bytes);
+
+	DerivedEntry& entry = _derived[key];
+	entry._values = values;
+	entry._last_use = ++_derived_use_count;
+	_derived_bytes += bytes;
+}
+
+/****************************************/
+void DataLog::clearDerived()
+{
+	_derived.clear();
+	_derived_bytes = 0;
+	_filter_window_size = 0;
+}
+
+/****************************************/
+void DataLog::setDerivedBudget(int bytes)
+{
+	_derived_budget = bytes;
+	evictDerived(_derived_budget);
+}
+
+/****************************************/
+void DataLog::evictDerived(int max_bytes)
+{
+	// Drop the least recently used data until the cache fits
+	while (_derived_bytes > max_bytes && !_derived.empty())
+	{
+		QMap<DerivedKey, DerivedEntry>::iterator oldest = _derived.begin();
+		for (QMap<DerivedKey, DerivedEntry>::iterator it = _derived.begin(); it != _derived.end(); ++it)
+		{
+			if (it.value()._last_use < oldest.value()._last_use)
+				oldest = it;
+		}
+		_derived_bytes -= oldest.value()._values.size()*sizeof(double);
+		_derived.erase(oldest);
+	}
 }
@@ -6,6 +6,49 @@
 #include <QDateTime.h>
 
 #include <vector>
+#include <cassert>
+
+#define DERIVED_CACHE_BUDGET (32*1024*1024) // bytes, default memory budget of the derived data cache
+
+// Channels of a log with per sample validity or derived data
+enum LogChannel
+{
+	LOG_ALT = 0,
+	LOG_HEART_RATE,
+	LOG_CADENCE,
+	LOG_SPEED,
+	LOG_GRADIENT,
+	LOG_POWER,
+	LOG_DIST,
+	LOG_GPS, // ltd and lgd
+	LOG_TEMP,
+	NUM_LOG_CHANNELS
+};
+
+// Operations which derive data from a channel
+enum DerivedOperation
+{
+	DERIVED_LOW_PASS = 0, // filtered series, param1 = window size
+	DERIVED_AVG_MAX, // average and max of the filtered series, param1 = window size
+	DERIVED_GAIN_LOSS, // gain and loss of the filtered series, param1 = window size
+	DERIVED_ZONE_TIME // time (sec) with values in [param1, param2)
+};
+
+/**********************************/
+// Key of the derived data cache
+struct DerivedKey
+{
+	int _channel;
+	int _operation;
+	int _param1;
+	int _param2;
+
+	DerivedKey(LogChannel channel, DerivedOperation operation, int param1 = 0, int param2 = 0):
+	_channel(channel), _operation(operation), _param1(param1), _param2(param2)
+	{}
+
+	bool operator<(const DerivedKey& other) const;
+};
 
 /* Class to represent a single ride log */
 
@@ -17,6 +60,8 @@ class DataLog
 	~DataLog();
 
 	void resize(int size);
+	// Release the capacity left over from growing the log while it was parsed
+	void shrinkToFit();
 
 	QString& filename() { return _filename; };
 	QDateTime& date() { return _date; };
@@ -58,24 +103,24 @@ class DataLog
 	double& gradientFltd(int idx);
 	double& powerFltd(int idx);
 
-	std::vector<double>& time() { return _time; }
-	std::vector<double>& ltd() { return _ltd; }
-	std::vector<double>& lgd() { return _lgd; }
-	std::vector<double>& alt() { return _alt; }
-	std::vector<double>& dist() { return _dist; }
-	std::vector<double>& heartRate() { return _heart_rate; }
-	std::vector<double>& cadence() { return _cadence; }
-	std::vector<double>& speed() { return _speed; }
-	std::vector<double>& gradient() { return _gradient; }
-	std::vector<double>& power() { return _power; }
-	std::vector<double>& temp() { return _temp; }
-
-	std::vector<double>& altFltd() { return _alt_fltd; }
-	std::vector<double>& heartRateFltd() { return _heart_rate_fltd; }
-	std::vector<double>& cadenceFltd() { return _cadence_fltd; }
-	std::vector<double>& speedFltd() { return _speed_fltd; }
-	std::vector<double>& gradientFltd() { return _gradient_fltd; }
-	std::vector<double>& powerFltd() { return _power_fltd; }
+	std::vector<double>& time() { return column(_time); }
+	std::vector<double>& ltd() { return column(_ltd); }
+	std::vector<double>& lgd() { return column(_lgd); }
+	std::vector<double>& alt() { return column(_alt); }
+	std::vector<double>& dist() { return column(_dist); }
+	std::vector<double>& heartRate() { return column(_heart_rate); }
+	std::vector<double>& cadence() { return column(_cadence); }
+	std::vector<double>& speed() { return column(_speed); }
+	std::vector<double>& gradient() { return column(_gradient); }
+	std::vector<double>& power() { return column(_power); }
+	std::vector<double>& temp() { return column(_temp); }
+
+	std::vector<double>& altFltd() { return column(_alt_fltd); }
+	std::vector<double>& heartRateFltd() { return column(_heart_rate_fltd); }
+	std::vector<double>& cadenceFltd() { return column(_cadence_fltd); }
+	std::vector<double>& speedFltd() { return column(_speed_fltd); }
+	std::vector<double>& gradientFltd() { return column(_gradient_fltd); }
+	std::vector<double>& powerFltd() { return column(_power_fltd); }
 
 	bool& timeValid() { return _time_valid; }
 	bool& ltdValid() { return _ltd_valid; }
@@ -96,6 +141,33 @@ class DataLog
 	bool& gradientFltdValid() { return _gradient_fltd_valid; }
 	bool& powerFltdValid() { return _power_fltd_valid; }
 
+	// Validity of each sample of a channel, packed 64 samples per word (sample i is bit i%64 of
+	// word i/64). Set by the parsers for the samples with a reading, so a reading of 0 is told
+	// apart from a missing reading. The channel flags above are set if any sample is valid
+	void setSampleValid(LogChannel channel, int idx, bool valid = true);
+	bool sampleValid(LogChannel channel, int idx) const;
+	const std::vector<quint64>& sampleValidBits(LogChannel channel) const { return _sample_valid[channel]; }
+	void setAllSamplesValid(LogChannel channel);
+	int numValidSamples(LogChannel channel) const;
+	// Copy the validity of a sample of another log, in every channel
+	void copySampleValid(const DataLog& source, int source_idx, int idx);
+
+	// Derived geo columns, computed from ltd/lgd by computeGeoColumns. Points with no GPS
+	// fix get zeros. East/north are metres from the centroid of the ride (local tangent plane)
+	std::vector<double>& ltdRad() { return _ltd_rad; }
+	std::vector<double>& lgdRad() { return _lgd_rad; }
+	std::vector<double>& cosLtd() { return _cos_ltd; }
+	std::vector<double>& east() { return _east; }
+	std::vector<double>& north() { return _north; }
+	// East/north (m) of any point (rad) in the local frame of this ride, so points of another
+	// ride can be compared with east()/north()
+	void toLocal(double ltd_rad, double lgd_rad, double& east, double& north) const;
+
+	// Compute the derived geo columns, if not already valid
+	void computeGeoColumns();
+	// Returns true if the derived geo columns match the current ltd/lgd
+	bool geoColumnsValid() const { return _geo_columns_valid; }
+
 	// Compute mappings from time to index and dist to index
 	void computeMaps();
 	// Return the index at the specified time
@@ -106,12 +178,44 @@ class DataLog
 	// Save log to text file
 	void saveToTextFile(const QString& filename);
 
+	// Pack the channels into quantized typed columns and free the double columns, for rides held
+	// in memory in bulk. Channels with no valid samples and the filtered channels are not stored.
+	// The point accessors must not be used on a compact log until it is expanded
+	void compact();
+	// Unpack the channels, refiltering the altitude. Other filtered channels are left invalid
+	void expand();
+	bool isCompact() const { return _compact; }
+
+	// Cache of data derived from the channels (filtered series, statistics, zone times), so
+	// repeated views of a ride do not compute them again. Returns 0 if the data is not cached
+	const std::vector<double>* findDerived(const DerivedKey& key);
+	// Add derived data to the cache, dropping the least recently used data over the budget
+	void storeDerived(const DerivedKey& key, const std::vector<double>& values);
+	void clearDerived();
+	void setDerivedBudget(int bytes);
+
+	// Window size of the filtered channels (altFltd, heartRateFltd, ...), 0 if not known
+	int& filterWindowSize() { return _filter_window_size; }
+
 	// Returns true if the data log has been modified, otherwise false
 	bool isModified() const;
 	// Sets the state of the modified flag for this log
 	void setModified(bool modified);
 
  private:
+	// A column of the points, allocated with zeros when first used, so the channels a log does
+	// not have and the filtered channels it never shows take no memory
+	std::vector<double>& column(std::vector<double>& values)
+	{
+		assert(!_compact);
+		if ((int)values.size() != _num_points)
+			values.resize(_num_points, 0.0);
+		return values;
+	}
+
+	// Drop the least recently used derived data until the cache uses at most max_bytes
+	void evictDerived(int max_bytes);
+
 	// Summary data
 	QString _filename;
 	QDateTime _date;
@@ -149,6 +253,49 @@ class DataLog
 	std::vector<double> _gradient_fltd; //%
 	std::vector<double> _power_fltd; //W
 
+	// Validity bitmaps of the samples
+	std::vector<quint64> _sample_valid[NUM_LOG_CHANNELS];
+
+	// Quantized columns of a compact log
+	struct CompactColumns
+	{
+		std::vector<float> _time; //sec
+		std::vector<qint32> _ltd; //1e-7 deg
+		std::vector<qint32> _lgd; //1e-7 deg
+		std::vector<float> _alt; //m
+		std::vector<float> _dist; //m
+		std::vector<quint8> _heart_rate; //bpm
+		std::vector<quint8> _cadence; //rpm
+		std::vector<float> _speed; //kmh
+		std::vector<float> _gradient; //%
+		std::vector<quint16> _power; //W
+		std::vector<qint8> _temp; //C
+	};
+	CompactColumns _compact_columns;
+	bool _compact;
+
+	// Derived geo columns
+	std::vector<double> _ltd_rad; //rad
+	std::vector<double> _lgd_rad; //rad
+	std::vector<double> _cos_ltd;
+	std::vector<double> _east; //m
+	std::vector<double> _north; //m
+	double _origin_ltd; //deg
+	double _origin_lgd; //deg
+	bool _geo_columns_valid;
+
+	// Derived data cache
+	struct DerivedEntry
+	{
+		std::vector<double> _values;
+		quint64 _last_use;
+	};
+	QMap<DerivedKey, DerivedEntry> _derived;
+	quint64 _derived_use_count;
+	int _derived_bytes;
+	int _derived_budget;
+	int _filter_window_size;
+
 	// Lap indexes (first = start index, second = end index)
 	std::vector<std::pair<int, int> > _lap_indecies;
 
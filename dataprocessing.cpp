@@ -1,9 +1,42 @@
 #include "dataprocessing.h"
+#include "datalog.h"
+#include "uniformlog.h"
 #include <cassert>
+#include <cfloat>
 #include <numeric>
 #include <algorithm>
 #include <iostream>
 
+/****************************************/
+// Channel of a log
+static std::vector<double>& rawChannel(DataLog& data_log, LogChannel channel)
+{
+	switch (channel)
+	{
+	case LOG_ALT: return data_log.alt();
+	case LOG_HEART_RATE: return data_log.heartRate();
+	case LOG_CADENCE: return data_log.cadence();
+	case LOG_SPEED: return data_log.speed();
+	case LOG_GRADIENT: return data_log.gradient();
+	default: return data_log.power();
+	}
+}
+
+/****************************************/
+// Filtered channel of a log
+static std::vector<double>& filteredChannel(DataLog& data_log, LogChannel channel)
+{
+	switch (channel)
+	{
+	case LOG_ALT: return data_log.altFltd();
+	case LOG_HEART_RATE: return data_log.heartRateFltd();
+	case LOG_CADENCE: return data_log.cadenceFltd();
+	case LOG_SPEED: return data_log.speedFltd();
+	case LOG_GRADIENT: return data_log.gradientFltd();
+	default: return data_log.powerFltd();
+	}
+}
+
 /****************************************/
 void DataProcessing::computePower()
 {
@@ -42,13 +75,20 @@ void DataProcessing::lowPassFilterSignal(
 	filtered.resize(signal.size());
 	if (window_size > 2)
 	{
-		// Smooth altitude with averaging filter
-		std::vector<double>::const_iterator signal_it = signal.begin();
-		for (int i=0; i < (int)signal.size(); ++i)
+		// Smooth with averaging filter, keeping a running sum of the window as it slides
+		const int n = (int)signal.size();
+		double sum = 0.0;
+		int lo = 0;
+		int hi = 0;
+		for (int i=0; i < n; ++i)
 		{
-			int x = i - std::max(0, i - window_size/2);
-			int y = std::min((int)signal.size(), i + window_size/2) - i;
-			filtered[i] = std::accumulate(signal_it+i-x, signal_it+i+y,0.0)/double(x + y);	
+			const int window_hi = std::min(n, i + window_size/2);
+			const int window_lo = std::max(0, i - window_size/2);
+			while (hi < window_hi)
+				sum += signal[hi++];
+			while (lo < window_lo)
+				sum -= signal[lo++];
+			filtered[i] = sum/double(hi - lo);
 		}
 	}
 	else
@@ -178,6 +218,157 @@ double DataProcessing::computeLoss(
 	return loss;
 }
 
+/****************************************/
+double DataProcessing::computeMaskedAverage(
+	const std::vector<double>& signal,
+	const std::vector<quint64>& valid_bits,
+	int idx_start,
+	int idx_end)
+{
+	assert(idx_start >= 0 && idx_end <= (int)signal.size() && idx_end <= (int)valid_bits.size()*64);
+
+	// Each sample is weighted by its bit, so the loop has no branches
+	double sum = 0.0;
+	int count = 0;
+	for (int i=idx_start; i < idx_end; ++i)
+	{
+		const int valid = (int)((valid_bits[i >> 6] >> (i & 63)) & 1);
+		sum += valid*signal[i];
+		count += valid;
+	}
+	return (count > 0) ? sum/count : 0.0;
+}
+
+/****************************************/
+double DataProcessing::computeMaskedMax(
+	const std::vector<double>& signal,
+	const std::vector<quint64>& valid_bits,
+	int idx_start,
+	int idx_end)
+{
+	assert(idx_start >= 0 && idx_end <= (int)signal.size() && idx_end <= (int)valid_bits.size()*64);
+
+	// Invalid samples are replaced with the lowest value, a select rather than a branch
+	double max = -DBL_MAX;
+	for (int i=idx_start; i < idx_end; ++i)
+	{
+		const bool valid = (valid_bits[i >> 6] >> (i & 63)) & 1;
+		max = std::max(max, valid ? signal[i] : -DBL_MAX);
+	}
+	return (max > -DBL_MAX) ? max : 0.0;
+}
+
+/****************************************/
+void DataProcessing::lowPassFilterChannel(
+	DataLog& data_log,
+	LogChannel channel,
+	int window_size)
+{
+	const DerivedKey key(channel, DERIVED_LOW_PASS, window_size);
+	const std::vector<double>* cached = data_log.findDerived(key);
+	if (cached)
+	{
+		filteredChannel(data_log, channel) = *cached;
+	}
+	else
+	{
+		lowPassFilterSignal(rawChannel(data_log, channel), filteredChannel(data_log, channel), window_size);
+		data_log.storeDerived(key, filteredChannel(data_log, channel));
+	}
+}
+
+/****************************************/
+void DataProcessing::computeFilteredAvgMax(
+	DataLog& data_log,
+	LogChannel channel,
+	double& avg,
+	double& max)
+{
+	// Only cached when the window of the filtered channels is known
+	const DerivedKey key(channel, DERIVED_AVG_MAX, data_log.filterWindowSize());
+	const std::vector<double>* cached = (data_log.filterWindowSize() > 0) ? data_log.findDerived(key) : 0;
+	if (cached)
+	{
+		avg = (*cached)[0];
+		max = (*cached)[1];
+		return;
+	}
+
+	// Only the samples with data, the validity of a filtered sample is that of the raw sample
+	const std::vector<double>& filtered = filteredChannel(data_log, channel);
+	avg = computeMaskedAverage(filtered, data_log.sampleValidBits(channel), 0, (int)filtered.size());
+	max = computeMaskedMax(filtered, data_log.sampleValidBits(channel), 0, (int)filtered.size());
+
+	if (data_log.filterWindowSize() > 0)
+	{
+		std::vector<double> values(2);
+		values[0] = avg;
+		values[1] = max;
+		data_log.storeDerived(key, values);
+	}
+}
+
+/****************************************/
+void DataProcessing::computeFilteredGainLoss(
+	DataLog& data_log,
+	double& gain,
+	double& loss)
+{
+	const DerivedKey key(LOG_ALT, DERIVED_GAIN_LOSS, data_log.filterWindowSize());
+	const std::vector<double>* cached = (data_log.filterWindowSize() > 0) ? data_log.findDerived(key) : 0;
+	if (cached)
+	{
+		gain = (*cached)[0];
+		loss = (*cached)[1];
+		return;
+	}
+
+	std::vector<double>::const_iterator start = data_log.altFltd().begin();
+	std::vector<double>::const_iterator end = data_log.altFltd().end();
+	gain = computeGain(start, end);
+	loss = computeLoss(start, end);
+
+	if (data_log.filterWindowSize() > 0)
+	{
+		std::vector<double> values(2);
+		values[0] = gain;
+		values[1] = loss;
+		data_log.storeDerived(key, values);
+	}
+}
+
+/****************************************/
+void DataProcessing::computeTimeInHRZones(
+	DataLog& data_log,
+	const std::vector<int>& zones,
+	std::vector<double>& zone_times)
+{
+	assert(zones.size() > 1);
+	const int num_zones = zones.size()-1;
+	zone_times.resize(num_zones);
+
+	bool cached = true;
+	for (int z=0; z < num_zones && cached; ++z)
+	{
+		const std::vector<double>* zone_time = data_log.findDerived(DerivedKey(LOG_HEART_RATE, DERIVED_ZONE_TIME, zones[z], zones[z+1]));
+		if (zone_time)
+			zone_times[z] = (*zone_time)[0];
+		else
+			cached = false;
+	}
+	if (cached)
+		return;
+
+	// Resample once for all the zones
+	UniformLog uniform_log;
+	uniform_log.resample(data_log);
+	for (int z=0; z < num_zones; ++z)
+	{
+		zone_times[z] = uniform_log.timeInRange(uniform_log.heartRate(), zones[z], zones[z+1]);
+		data_log.storeDerived(DerivedKey(LOG_HEART_RATE, DERIVED_ZONE_TIME, zones[z], zones[z+1]), std::vector<double>(1, zone_times[z]));
+	}
+}
+
 /****************************************/
 const QString DataProcessing::minsFromSecs(int seconds)
 {
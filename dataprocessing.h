@@ -1,6 +1,8 @@
 #ifndef DATAPROCESSING_H
 #define DATAPROCESSING_H
 
+#include "datalog.h"
+
 #include <QString.h>
 #include <vector>
 
@@ -54,6 +56,48 @@ namespace DataProcessing
 		std::vector<double>::const_iterator& start,
 		std::vector<double>::const_iterator& end);
 
+	// Average and max of the valid samples from idx_start to idx_end (exclusive), where
+	// valid_bits is a validity bitmap of the samples (see DataLog::sampleValidBits).
+	// Return 0 if no sample is valid
+	double computeMaskedAverage(
+		const std::vector<double>& signal,
+		const std::vector<quint64>& valid_bits,
+		int idx_start,
+		int idx_end);
+
+	double computeMaskedMax(
+		const std::vector<double>& signal,
+		const std::vector<quint64>& valid_bits,
+		int idx_start,
+		int idx_end);
+
+	// Versions of the above which keep their results in the derived data cache of the log.
+	// Filter a channel into its filtered channel
+	void lowPassFilterChannel(
+		DataLog& data_log,
+		LogChannel channel,
+		int window_size);
+
+	// Average and max of a filtered channel
+	void computeFilteredAvgMax(
+		DataLog& data_log,
+		LogChannel channel,
+		double& avg,
+		double& max);
+
+	// Gain and loss of the filtered altitude
+	void computeFilteredGainLoss(
+		DataLog& data_log,
+		double& gain,
+		double& loss);
+
+	// Time in each HR zone, zones holds the lower bound of each zone and the upper bound of the last.
+	// Computed from the log resampled at a uniform rate, so gaps (auto-pause) are not counted
+	void computeTimeInHRZones(
+		DataLog& data_log,
+		const std::vector<int>& zones,
+		std::vector<double>& zone_times);
+
 	// Some functions to convert data to text
 	const QString minsFromSecs(int seconds);
 	const QString kmFromMeters(double meters, int prec=1);
@@ -2,6 +2,8 @@
 #include "dataprocessing.h"
 #include "datalog.h"
 #include "user.h"
+#include "uniformlog.h"
+#include "logdirectorysummary.h"
 
 #include <QTableWidget.h>
 #include <QBoxLayout.h>
@@ -44,7 +46,9 @@ public:
 };
 
 /******************************************************/
-DataStatisticsWindow::DataStatisticsWindow()
+DataStatisticsWindow::DataStatisticsWindow():
+_uniform_log(new UniformLog()),
+_uniform_log_valid(false)
 {
 	_table = new QTableWidget(19,2,this);
 	_table->setSelectionMode(QAbstractItemView::NoSelection);
@@ -93,6 +97,7 @@ void DataStatisticsWindow::displayRide(boost::shared_ptr<DataLog> data_log, boos
 	if (data_log.get() != _data_log.get() || data_log->isModified())
 	{
 		_data_log = data_log;
+		_uniform_log_valid = false;
 
 		_head_label->setText("<b>Ride Statistics For:</b> " + _data_log->dateString());
 		displayCompleteRideStats();
@@ -114,36 +119,23 @@ void DataStatisticsWindow::displayCompleteRideStats()
 	// Compute totals
 	double time = _data_log->totalTime();
 	double dist = _data_log->totalDist();
-	double elev_gain = DataProcessing::computeGain(_data_log->altFltd().begin(), _data_log->altFltd().end());
-	double elev_loss = DataProcessing::computeLoss(_data_log->altFltd().begin(), _data_log->altFltd().end());
-
-	// Compute avgs
-	double avg_speed = DataProcessing::computeAverage(_data_log->speedFltd().begin(), _data_log->speedFltd().end());
-	double avg_hr = DataProcessing::computeAverage(_data_log->heartRateFltd().begin(), _data_log->heartRateFltd().end());
-	double avg_grad = DataProcessing::computeAverage(_data_log->gradientFltd().begin(), _data_log->gradientFltd().end());
-	double avg_cadence = DataProcessing::computeAverage(_data_log->cadenceFltd().begin(), _data_log->cadenceFltd().end());
-	double avg_power = DataProcessing::computeAverage(_data_log->powerFltd().begin(), _data_log->powerFltd().end());
-	
-	// Compute maxs
-	double max_speed = DataProcessing::computeMax(_data_log->speedFltd().begin(), _data_log->speedFltd().end());
-	double max_hr = DataProcessing::computeMax(_data_log->heartRateFltd().begin(), _data_log->heartRateFltd().end());
-	double max_gradient = DataProcessing::computeMax(_data_log->gradientFltd().begin(), _data_log->gradientFltd().end());
-	double max_cadence = DataProcessing::computeMax(_data_log->cadenceFltd().begin(), _data_log->cadenceFltd().end());
-	double max_power = DataProcessing::computeMax(_data_log->powerFltd().begin(), _data_log->powerFltd().end());
+	double elev_gain, elev_loss;
+	DataProcessing::computeFilteredGainLoss(*_data_log, elev_gain, elev_loss);
+
+	// Compute avgs and maxs of the samples with data, cached in the log for the current smoothing
+	double avg_speed, avg_hr, avg_grad, avg_cadence, avg_power;
+	double max_speed, max_hr, max_gradient, max_cadence, max_power;
+	DataProcessing::computeFilteredAvgMax(*_data_log, LOG_SPEED, avg_speed, max_speed);
+	DataProcessing::computeFilteredAvgMax(*_data_log, LOG_HEART_RATE, avg_hr, max_hr);
+	DataProcessing::computeFilteredAvgMax(*_data_log, LOG_GRADIENT, avg_grad, max_gradient);
+	DataProcessing::computeFilteredAvgMax(*_data_log, LOG_CADENCE, avg_cadence, max_cadence);
+	DataProcessing::computeFilteredAvgMax(*_data_log, LOG_POWER, avg_power, max_power);
 	
 	// Compute HR zone times
-	double hr_zone1 = DataProcessing::computeTimeInHRZone(
-		_data_log->heartRate(), _data_log->time(), _user->zone1(), _user->zone2());
-	double hr_zone2 = DataProcessing::computeTimeInHRZone(
-		_data_log->heartRate(), _data_log->time(), _user->zone2(), _user->zone3());
-	double hr_zone3 = DataProcessing::computeTimeInHRZone(
-		_data_log->heartRate(), _data_log->time(), _user->zone3(), _user->zone4());
-	double hr_zone4 = DataProcessing::computeTimeInHRZone(
-		_data_log->heartRate(), _data_log->time(), _user->zone4(), _user->zone5());
-	double hr_zone5 = DataProcessing::computeTimeInHRZone(
-		_data_log->heartRate(), _data_log->time(), _user->zone5(), 1000.0);
-
-	// Update the data log with these stats
+	std::vector<double> hr_zone_times;
+	DataProcessing::computeTimeInHRZones(*_data_log, hrZones(), hr_zone_times);
+
+	// Update the data log with these stats, the map colours are scaled by the filtered maximums
 	_data_log->avgSpeed() = avg_speed;
 	_data_log->avgHeartRate() = avg_hr;
 	_data_log->avgGradient() = avg_grad;
@@ -174,11 +166,36 @@ void DataStatisticsWindow::displayCompleteRideStats()
 	_table->item(12,0)->setText(QString::number(max_cadence, 'f', 0));
 	_table->item(13,0)->setText(QString::number(max_power, 'f', 2));
 
-	_table->item(14,0)->setText(DataProcessing::minsFromSecs(hr_zone1));
-	_table->item(15,0)->setText(DataProcessing::minsFromSecs(hr_zone2));
-	_table->item(16,0)->setText(DataProcessing::minsFromSecs(hr_zone3));
-	_table->item(17,0)->setText(DataProcessing::minsFromSecs(hr_zone4));
-	_table->item(18,0)->setText(DataProcessing::minsFromSecs(hr_zone5));
+	_table->item(14,0)->setText(DataProcessing::minsFromSecs(hr_zone_times[0]));
+	_table->item(15,0)->setText(DataProcessing::minsFromSecs(hr_zone_times[1]));
+	_table->item(16,0)->setText(DataProcessing::minsFromSecs(hr_zone_times[2]));
+	_table->item(17,0)->setText(DataProcessing::minsFromSecs(hr_zone_times[3]));
+	_table->item(18,0)->setText(DataProcessing::minsFromSecs(hr_zone_times[4]));
+}
+
+/******************************************************/
+std::vector<int> DataStatisticsWindow::hrZones() const
+{
+	std::vector<int> zones;
+	zones.push_back(_user->zone1());
+	zones.push_back(_user->zone2());
+	zones.push_back(_user->zone3());
+	zones.push_back(_user->zone4());
+	zones.push_back(_user->zone5());
+	zones.push_back(1000);
+	return zones;
+}
+
+/******************************************************/
+const UniformLog& DataStatisticsWindow::uniformLog()
+{
+	// Resampled when first needed for a ride, then shared by every selection
+	if (!_uniform_log_valid)
+	{
+		_uniform_log->resample(*_data_log);
+		_uniform_log_valid = true;
+	}
+	return *_uniform_log;
 }
 
 /******************************************************/
@@ -242,28 +259,27 @@ void DataStatisticsWindow::displaySelectedRideStats(int idx_start, int idx_end)
 		double elev_gain = DataProcessing::computeGain(_data_log->altFltd().begin() + idx_start, _data_log->altFltd().begin() + idx_end);
 		double elev_loss = DataProcessing::computeLoss(_data_log->altFltd().begin() + idx_start, _data_log->altFltd().begin() + idx_end);
 		
-		// Compute avgs
-		double avg_speed = DataProcessing::computeAverage(_data_log->speedFltd().begin() + idx_start, _data_log->speedFltd().begin() + idx_end);
-		double avg_hr = DataProcessing::computeAverage(_data_log->heartRateFltd().begin() + idx_start, _data_log->heartRateFltd().begin() + idx_end);
-		double avg_grad = DataProcessing::computeAverage(_data_log->gradientFltd().begin() + idx_start, _data_log->gradientFltd().begin() + idx_end);
-		double avg_cadence = DataProcessing::computeAverage(_data_log->cadenceFltd().begin() + idx_start, _data_log->cadenceFltd().begin() + idx_end);
-		double avg_power = DataProcessing::computeAverage(_data_log->powerFltd().begin() + idx_start, _data_log->powerFltd().begin() + idx_end);
+		// Compute avgs and maxs of the samples with data
+		double avg_speed = DataProcessing::computeMaskedAverage(_data_log->speedFltd(), _data_log->sampleValidBits(LOG_SPEED), idx_start, idx_end);
+		double avg_hr = DataProcessing::computeMaskedAverage(_data_log->heartRateFltd(), _data_log->sampleValidBits(LOG_HEART_RATE), idx_start, idx_end);
+		double avg_grad = DataProcessing::computeMaskedAverage(_data_log->gradientFltd(), _data_log->sampleValidBits(LOG_GRADIENT), idx_start, idx_end);
+		double avg_cadence = DataProcessing::computeMaskedAverage(_data_log->cadenceFltd(), _data_log->sampleValidBits(LOG_CADENCE), idx_start, idx_end);
+		double avg_power = DataProcessing::computeMaskedAverage(_data_log->powerFltd(), _data_log->sampleValidBits(LOG_POWER), idx_start, idx_end);
 		
-		// Compute maxs
-		double max_speed = DataProcessing::computeMax(_data_log->speedFltd().begin() + idx_start, _data_log->speedFltd().begin() + idx_end);
-		double max_hr = DataProcessing::computeMax(_data_log->heartRateFltd().begin() + idx_start, _data_log->heartRateFltd().begin() + idx_end);
-		double max_gradient = DataProcessing::computeMax(_data_log->gradientFltd().begin() + idx_start, _data_log->gradientFltd().begin() + idx_end);
-		double max_cadence = DataProcessing::computeMax(_data_log->cadenceFltd().begin() + idx_start, _data_log->cadenceFltd().begin() + idx_end);
-		double max_power = DataProcessing::computeMax(_data_log->powerFltd().begin() + idx_start, _data_log->powerFltd().begin() + idx_end);
+		double max_speed = DataProcessing::computeMaskedMax(_data_log->speedFltd(), _data_log->sampleValidBits(LOG_SPEED), idx_start, idx_end);
+		double max_hr = DataProcessing::computeMaskedMax(_data_log->heartRateFltd(), _data_log->sampleValidBits(LOG_HEART_RATE), idx_start, idx_end);
+		double max_gradient = DataProcessing::computeMaskedMax(_data_log->gradientFltd(), _data_log->sampleValidBits(LOG_GRADIENT), idx_start, idx_end);
+		double max_cadence = DataProcessing::computeMaskedMax(_data_log->cadenceFltd(), _data_log->sampleValidBits(LOG_CADENCE), idx_start, idx_end);
+		double max_power = DataProcessing::computeMaskedMax(_data_log->powerFltd(), _data_log->sampleValidBits(LOG_POWER), idx_start, idx_end);
 		
-		// Compute HR zone times
-		std::vector<double> sub_heart_rate(_data_log->heartRate().begin() + idx_start, _data_log->heartRate().begin() + idx_end);
-		std::vector<double> sub_time(_data_log->time().begin() + idx_start, _data_log->time().begin() + idx_end);
-		double hr_zone1 = DataProcessing::computeTimeInHRZone(sub_heart_rate, sub_time, _user->zone1(), _user->zone2());
-		double hr_zone2 = DataProcessing::computeTimeInHRZone(sub_heart_rate, sub_time, _user->zone2(), _user->zone3());
-		double hr_zone3 = DataProcessing::computeTimeInHRZone(sub_heart_rate, sub_time, _user->zone3(), _user->zone4());
-		double hr_zone4 = DataProcessing::computeTimeInHRZone(sub_heart_rate, sub_time, _user->zone4(), _user->zone5());
-		double hr_zone5 = DataProcessing::computeTimeInHRZone(sub_heart_rate, sub_time, _user->zone5(), 1000.0);
+		// Compute HR zone times on the uniform samples of the selection, so gaps are not counted
+		const UniformLog& uniform_log = uniformLog();
+		const int sample_start = uniform_log.index(_data_log->time(idx_start));
+		const int sample_end = uniform_log.index(_data_log->time(idx_end));
+		const std::vector<int> zones = hrZones();
+		std::vector<double> hr_zone_times(NUM_HR_ZONES);
+		for (int z=0; z < NUM_HR_ZONES; ++z)
+			hr_zone_times[z] = uniform_log.timeInRange(uniform_log.heartRate(), zones[z], zones[z+1], sample_start, sample_end);
 
 		// Set selection column
 		_table->item(0,1)->setText(DataProcessing::minsFromSecs(time));
@@ -283,10 +299,10 @@ void DataStatisticsWindow::displaySelectedRideStats(int idx_start, int idx_end)
 		_table->item(12,1)->setText(QString::number(max_cadence, 'f', 0));
 		_table->item(13,1)->setText(QString::number(max_power, 'f', 2));
 
-		_table->item(14,1)->setText(DataProcessing::minsFromSecs(hr_zone1));
-		_table->item(15,1)->setText(DataProcessing::minsFromSecs(hr_zone2));
-		_table->item(16,1)->setText(DataProcessing::minsFromSecs(hr_zone3));
-		_table->item(17,1)->setText(DataProcessing::minsFromSecs(hr_zone4));
-		_table->item(18,1)->setText(DataProcessing::minsFromSecs(hr_zone5));
+		_table->item(14,1)->setText(DataProcessing::minsFromSecs(hr_zone_times[0]));
+		_table->item(15,1)->setText(DataProcessing::minsFromSecs(hr_zone_times[1]));
+		_table->item(16,1)->setText(DataProcessing::minsFromSecs(hr_zone_times[2]));
+		_table->item(17,1)->setText(DataProcessing::minsFromSecs(hr_zone_times[3]));
+		_table->item(18,1)->setText(DataProcessing::minsFromSecs(hr_zone_times[4]));
 	}
 }
\ No newline at end of file
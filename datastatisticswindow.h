@@ -4,11 +4,14 @@
 #include <Qwidget.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <vector>
 
 class QTableWidget;
 class QLabel;
 class DataLog;
 class User;
+class UniformLog;
 
 class DataStatisticsWindow : public QWidget
  {
@@ -30,10 +33,18 @@ class DataStatisticsWindow : public QWidget
 	void clearTotalsColumn();
 	void clearSelectionColumn();
 
+	// Lower bounds of the HR zones of the user, and the upper bound of the last zone
+	std::vector<int> hrZones() const;
+
+	// The ride resampled at a uniform rate
+	const UniformLog& uniformLog();
+
 	QTableWidget* _table;
 	QLabel* _head_label;
 	boost::shared_ptr<DataLog> _data_log;
 	boost::shared_ptr<User> _user;
+	boost::scoped_ptr<UniformLog> _uniform_log;
+	bool _uniform_log_valid;
 
 	// The start index of selection to highlight
 	int _selection_begin_idx;
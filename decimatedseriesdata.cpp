@@ -0,0 +1,152 @@
+#include "decimatedseriesdata.h"
+
+#include <QWidget.h>
+
+#include <algorithm>
+
+#define BLOCKS_PER_PIXEL 1 // blocks drawn per pixel of canvas width, each gives up to 4 points
+#define MIN_CANVAS_WIDTH 2048 // pixels, the canvas can be resized without a replot so allow for a wide one
+
+/******************************************************/
+DecimatedSeriesData::DecimatedSeriesData(const double* x, const double* y, int num_points, const QWidget* canvas):
+_x(x),
+_y(y),
+_num_points(num_points),
+_canvas(canvas)
+{
+	buildPyramid();
+
+	// Until the axes are set, draw everything
+	setRectOfInterest(QRectF());
+}
+
+/******************************************************/
+DecimatedSeriesData::~DecimatedSeriesData()
+{}
+
+/******************************************************/
+void DecimatedSeriesData::buildPyramid()
+{
+	_pyramid.clear();
+	_pyramid.push_back(std::vector<std::pair<int, int> >()); // level 0 is the points themselves
+	if (_num_points <= 0)
+	{
+		_bounding_rect = QRectF();
+		return;
+	}
+
+	double min_y = _y[0], max_y = _y[0];
+	for (int i=1; i < _num_points; ++i)
+	{
+		min_y = std::min(min_y, _y[i]);
+		max_y = std::max(max_y, _y[i]);
+	}
+	_bounding_rect = QRectF(_x[0], min_y, _x[_num_points-1] - _x[0], max_y - min_y);
+
+	// Each level from pairs of blocks of the level below
+	int block_size = 2;
+	while (block_size < _num_points)
+	{
+		const std::vector<std::pair<int, int> >& below = _pyramid.back();
+		const int num_blocks = (_num_points + block_size - 1)/block_size;
+		std::vector<std::pair<int, int> > level(num_blocks);
+		for (int b=0; b < num_blocks; ++b)
+		{
+			int min_idx, max_idx;
+			if (below.empty()) // from the points
+			{
+				const int i = 2*b;
+				min_idx = max_idx = i;
+				if (i+1 < _num_points)
+				{
+					min_idx = (_y[i+1] < _y[i]) ? i+1 : i;
+					max_idx = (_y[i+1] > _y[i]) ? i+1 : i;
+				}
+			}
+			else
+			{
+				min_idx = below[2*b].first;
+				max_idx = below[2*b].second;
+				if (2*b+1 < (int)below.size())
+				{
+					if (_y[below[2*b+1].first] < _y[min_idx])
+						min_idx = below[2*b+1].first;
+					if (_y[below[2*b+1].second] > _y[max_idx])
+						max_idx = below[2*b+1].second;
+				}
+			}
+			level[b] = std::make_pair(min_idx, max_idx);
+		}
+		_pyramid.push_back(level);
+		block_size *= 2;
+	}
+}
+
+/******************************************************/
+void DecimatedSeriesData::addBlock(int level, int block)
+{
+	const int first = block << level;
+	const int last = std::min(((block+1) << level), _num_points) - 1;
+	const std::pair<int, int>& min_max = _pyramid[level][block];
+
+	// The 4 points in the order they are drawn, skipping repeats
+	int idx[4] = {first, std::min(min_max.first, min_max.second), std::max(min_max.first, min_max.second), last};
+	for (int k=0; k < 4; ++k)
+	{
+		if (k == 0 || idx[k] != idx[k-1])
+			_samples.push_back(QPointF(_x[idx[k]], _y[idx[k]]));
+	}
+}
+
+/******************************************************/
+void DecimatedSeriesData::setRectOfInterest(const QRectF& rect)
+{
+	_samples.clear();
+	if (_num_points <= 0)
+		return;
+
+	// Visible points, with one more at each end so the lines off the canvas are drawn too
+	int first = 0, last = _num_points-1;
+	if (rect.isValid())
+	{
+		first = std::lower_bound(_x, _x + _num_points, rect.left()) - _x;
+		last = std::upper_bound(_x, _x + _num_points, rect.right()) - _x;
+		first = std::max(first-1, 0);
+		last = std::min(last, _num_points-1);
+	}
+
+	// Lowest level with no more blocks than the canvas has pixels
+	const int max_blocks = std::max(_canvas ? _canvas->width() : 0, MIN_CANVAS_WIDTH)*BLOCKS_PER_PIXEL;
+	int level = 0;
+	while (level+1 < (int)_pyramid.size() && ((last >> level) - (first >> level) + 1) > max_blocks)
+		++level;
+
+	if (level == 0)
+	{
+		for (int i=first; i <= last; ++i)
+			_samples.push_back(QPointF(_x[i], _y[i]));
+	}
+	else
+	{
+		for (int b=(first >> level); b <= (last >> level); ++b)
+			addBlock(level, b);
+	}
+}
+
+/******************************************************/
+size_t DecimatedSeriesData::size() const
+{
+	return _samples.size();
+}
+
+/******************************************************/
+QPointF DecimatedSeriesData::sample(size_t i) const
+{
+	return _samples[i];
+}
+
+/******************************************************/
+QRectF DecimatedSeriesData::boundingRect() const
+{
+	return _bounding_rect;
+}
\ No newline at end of file
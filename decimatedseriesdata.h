@@ -0,0 +1,50 @@
+#ifndef DECIMATEDSERIESDATA_H
+#define DECIMATEDSERIESDATA_H
+
+#include <qwt_series_data.h>
+
+#include <vector>
+
+class QWidget;
+
+/* Curve data which only gives Qwt the points needed to draw the visible part of a curve.
+   A pyramid holds the index of the min and max point of every block of 2, 4, 8, ... points.
+   When the axes change, the level with at most one block per pixel is picked and each visible
+   block is reduced to its first, min, max and last points, which draw the same line as all
+   of its points. Drawing then depends on the canvas width rather than the number of points.
+   Like setRawSamples, the data is not copied, so the arrays must outlive the curve. */
+
+class DecimatedSeriesData : public QwtSeriesData<QPointF>
+{
+public:
+	// x must be increasing (time or distance)
+	DecimatedSeriesData(const double* x, const double* y, int num_points, const QWidget* canvas);
+	~DecimatedSeriesData();
+
+	virtual size_t size() const;
+	virtual QPointF sample(size_t i) const;
+	virtual QRectF boundingRect() const;
+
+	// Called by the curve when the axes change. Picks the points to draw
+	virtual void setRectOfInterest(const QRectF& rect);
+
+private:
+	void buildPyramid();
+
+	// Add the points of a block of a level to _samples
+	void addBlock(int level, int block);
+
+	const double* _x;
+	const double* _y;
+	int _num_points;
+	const QWidget* _canvas;
+
+	QRectF _bounding_rect;
+
+	// Level k (k >= 1) holds blocks of 2^k points, as pairs of the indices of the min and max point
+	std::vector<std::vector<std::pair<int, int> > > _pyramid;
+
+	std::vector<QPointF> _samples; // points to draw
+};
+
+#endif // DECIMATEDSERIESDATA_H
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "derivedstores.h"
+#include "datalog.h"
+#include "user.h"
+#include "logdirectorysummary.h"
+#include "heatmappyramid.h"
+#include "histogramstore.h"
+#include "rollupcube.h"
+#include "trainingload.h"
+
+/****************************************/
+DerivedStores::DerivedStores(const LogDirectorySummary& log_dir_summary, const User& user):
+_log_dir_summary(log_dir_summary),
+_user(user)
+{
+	const QString& log_directory = log_dir_summary.logDirectory();
+
+	// The heat map of the ride collage
+	_heat_map_pyramid.reset(new HeatMapPyramid(log_directory));
+	_heat_map_pyramid->readFromFile();
+
+	// The channel histograms, for the time in HR/power/cadence/speed/gradient bins over a date range
+	_histogram_store.reset(new HistogramStore(log_directory));
+	_histogram_store->readFromFile();
+
+	// The rollup of the totals window, which only needs the summary of a ride
+	_rollup_cube.reset(new RollupCube(log_directory));
+	_rollup_read = _rollup_cube->readFromFile();
+
+	// The training load, where each ride only updates the series from its day on
+	_training_load.reset(new TrainingLoad(log_directory));
+	_training_load_read = _training_load->readFromFile(user);
+}
+
+/****************************************/
+DerivedStores::~DerivedStores()
+{}
+
+/****************************************/
+void DerivedStores::removeRide(const QString& filename)
+{
+	_heat_map_pyramid->removeRideByName(filename);
+	_histogram_store->removeRideByName(filename);
+	_rollup_cube->removeRideByName(filename);
+	if (_training_load_read)
+		_training_load->removeRideByName(filename);
+}
+
+/****************************************/
+void DerivedStores::addRide(DataLog& data_log)
+{
+	_heat_map_pyramid->addRide(data_log);
+	_histogram_store->addRide(data_log);
+
+	const int log_index = _log_dir_summary.indexOf(data_log.filename());
+	if (log_index >= 0)
+	{
+		_rollup_cube->addRide(_log_dir_summary.log(log_index));
+		if (_training_load_read)
+			_training_load->addRide(_log_dir_summary.log(log_index), _user);
+	}
+}
+
+/****************************************/
+void DerivedStores::writeToFile()
+{
+	_heat_map_pyramid->removeMissingRides(_log_dir_summary);
+	_heat_map_pyramid->writeToFile();
+
+	_histogram_store->removeMissingRides(_log_dir_summary);
+	_histogram_store->writeToFile();
+
+	if (!_rollup_read || _rollup_cube->numRides() != _log_dir_summary.numLogs())
+		_rollup_cube->rebuild(_log_dir_summary);
+	_rollup_cube->writeToFile();
+
+	if (_training_load_read)
+	{
+		_training_load->removeMissingRides(_log_dir_summary);
+		_training_load->addMissingRides(_log_dir_summary, _user);
+	}
+	else
+	{
+		_training_load->rebuild(_log_dir_summary, _user);
+	}
+	_training_load->writeToFile();
+}
+
+/****************************************/
+void DerivedStores::update(
+	const LogDirectorySummary& log_dir_summary,
+	const QStringList& removed,
+	const std::vector<boost::shared_ptr<DataLog> >& added,
+	const User& user)
+{
+	DerivedStores derived_stores(log_dir_summary, user);
+	for (int i=0; i < removed.size(); ++i)
+		derived_stores.removeRide(removed[i]);
+	for (unsigned int i=0; i < added.size(); ++i)
+		derived_stores.addRide(*added[i]);
+	derived_stores.writeToFile();
+}
+
+/****************************************/
+QStringList DerivedStores::logsToUpdate(const LogDirectorySummary& log_dir_summary)
+{
+	HistogramStore histogram_store(log_dir_summary.logDirectory());
+	histogram_store.readFromFile();
+
+	QStringList filenames;
+	for (int i=0; i < log_dir_summary.numLogs(); ++i)
+	{
+		if (!histogram_store.contains(log_dir_summary.log(i)._filename))
+			filenames << log_dir_summary.log(i)._filename;
+	}
+	return filenames;
+}
\ No newline at end of file
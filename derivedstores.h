@@ -0,0 +1,65 @@
+#ifndef DERIVEDSTORES_H
+#define DERIVEDSTORES_H
+
+#include <QStringList.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+
+class DataLog;
+class User;
+class LogDirectorySummary;
+class HeatMapPyramid;
+class HistogramStore;
+class RollupCube;
+class TrainingLoad;
+
+/* Class to update the stores kept next to the log directory summary so windows do not need
+   to parse the logs: the heat map of the ride collage, the channel histograms, the rollup of
+   the totals window and the training load. They are updated together whenever the summary
+   changes. */
+
+class DerivedStores
+ {
+ public:
+	// Read the stores of the log directory of the summary
+	DerivedStores(const LogDirectorySummary& log_dir_summary, const User& user);
+	~DerivedStores();
+
+	// Remove a ride, or add a parsed ride which replaces any ride of the same filename. A ride
+	// is added once it is in the summary, and the parsed ride is not needed after, so rides
+	// can be parsed and added a few at a time
+	void removeRide(const QString& filename);
+	void addRide(DataLog& data_log);
+
+	// Purge the rides no longer in the summary, fill in those the summary-only stores are
+	// missing, and write the stores. Call once the summary is written
+	void writeToFile();
+
+	// Update the stores once the summary is written. removed are the filenames of the rides
+	// removed from the summary and added the parsed rides added to it
+	static void update(
+		const LogDirectorySummary& log_dir_summary,
+		const QStringList& removed,
+		const std::vector<boost::shared_ptr<DataLog> >& added,
+		const User& user);
+
+	// Filenames of the rides in the summary which a store can only add from the parsed ride
+	// (the channel histograms) and does not hold, eg. rides summarised before the store existed
+	static QStringList logsToUpdate(const LogDirectorySummary& log_dir_summary);
+
+ private:
+	const LogDirectorySummary& _log_dir_summary;
+	const User& _user;
+
+	boost::scoped_ptr<HeatMapPyramid> _heat_map_pyramid;
+	boost::scoped_ptr<HistogramStore> _histogram_store;
+	boost::scoped_ptr<RollupCube> _rollup_cube;
+	boost::scoped_ptr<TrainingLoad> _training_load;
+	bool _rollup_read;
+	bool _training_load_read;
+ };
+
+#endif // DERIVEDSTORES_H
\ No newline at end of file
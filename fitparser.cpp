@@ -4,16 +4,22 @@
 
 #include <iostream>
 #include <cassert>
+#include <climits>
+#include <algorithm>
 #include <math.h>
 
+#include <QElapsedTimer.h>
+
 #include "garminfitsdk/fit_decode.hpp"
 
 /******************************************************/
 Listener::Listener(boost::shared_ptr<DataLog> data_log):
 	_data_log(data_log),
 	_track_point_index(0),
+	_size_hint(0),
 	_start_time(0)
 {
+	_data_log->resize(0);
 	_pos_factor = 180.0 / pow(2.0,31.0); // degrees = semicircles * ( 180 / 2^31 )
 	_base_date = QDateTime(QDate(1989,12,31)); // start date of all .fit dates
 }
@@ -24,46 +30,84 @@ int Listener::numPointsRead()
 	return _track_point_index; 
 }
 
+/******************************************************/
+void Listener::setSizeHint(int num_points)
+{
+	_size_hint = num_points;
+}
+
+/******************************************************/
+const std::vector<std::pair<int, int> >& Listener::lapTimes() const
+{
+	return _lap_times;
+}
+
 /******************************************************/
 void Listener::OnMesg(fit::RecordMesg& mesg)
 {
+	// Double the log when it is full, so appending is amortized constant time and there is
+	// no limit on the length of the ride. Unused points are culled after parsing
+	if (_track_point_index >= _data_log->numPoints())
+		_data_log->resize(std::max(2*_data_log->numPoints(), std::max(_size_hint, FIT_MIN_POINTS)));
+
 	if (mesg.GetTimestamp() != FIT_DATE_TIME_INVALID)
 	{
 		if (_track_point_index == 0)
 		{
-			const int max_size = 40000; // 11.1 hrs, 1 sample per sec
-			_data_log->resize(max_size);
 			_data_log->date() = _base_date.addSecs((int)mesg.GetTimestamp());
 			_start_time = (int)mesg.GetTimestamp();
 		}
 		_data_log->time(_track_point_index) = (int)mesg.GetTimestamp() - _start_time;
 	}
-	if (mesg.GetPositionLat() != FIT_SINT32_INVALID)
+	// Readings which are present are flagged valid, so a reading of 0 is kept apart from no reading
+	if (mesg.GetPositionLat() != FIT_SINT32_INVALID && mesg.GetPositionLong() != FIT_SINT32_INVALID)
+	{
 		_data_log->ltd(_track_point_index) = mesg.GetPositionLat()*_pos_factor;
-	
-	if (mesg.GetPositionLong() != FIT_SINT32_INVALID)
 		_data_log->lgd(_track_point_index) = mesg.GetPositionLong()*_pos_factor;
+		_data_log->setSampleValid(LOG_GPS, _track_point_index);
+	}
 	
 	if (mesg.GetAltitude() != FIT_UINT8_INVALID)
+	{
 		_data_log->alt(_track_point_index) = (float)mesg.GetAltitude();
+		_data_log->setSampleValid(LOG_ALT, _track_point_index);
+	}
 		
 	if (mesg.GetHeartRate() != FIT_UINT8_INVALID)
+	{
 		_data_log->heartRate(_track_point_index) = (int)mesg.GetHeartRate();
+		_data_log->setSampleValid(LOG_HEART_RATE, _track_point_index);
+	}
 
 	if (mesg.GetCadence() != FIT_UINT8_INVALID)
+	{
 		_data_log->cadence(_track_point_index) = (int)mesg.GetCadence();
+		_data_log->setSampleValid(LOG_CADENCE, _track_point_index);
+	}
 
 	if (mesg.GetDistance() != FIT_FLOAT32_INVALID)
+	{
 		_data_log->dist(_track_point_index) = (double)mesg.GetDistance();
+		_data_log->setSampleValid(LOG_DIST, _track_point_index);
+	}
 
 	if (mesg.GetSpeed() != FIT_FLOAT32_INVALID)
+	{
 		_data_log->speed(_track_point_index) = (double)mesg.GetSpeed()*3.6;
+		_data_log->setSampleValid(LOG_SPEED, _track_point_index);
+	}
 
 	if (mesg.GetPower() != FIT_UINT16_INVALID)
+	{
 		_data_log->power(_track_point_index) = (int)mesg.GetPower();
+		_data_log->setSampleValid(LOG_POWER, _track_point_index);
+	}
 
 	if (mesg.GetTemperature() != FIT_SINT8_INVALID)
+	{
 		_data_log->temp(_track_point_index) = (int)mesg.GetTemperature();
+		_data_log->setSampleValid(LOG_TEMP, _track_point_index);
+	}
 
 	_track_point_index++;
 }
@@ -83,8 +127,10 @@ void Listener::OnMesg(fit::LapMesg& mesg)
 		lap_start_time = (int)mesg.GetStartTime() - _start_time + 1;
 	}
 
-	if (lap_start_time >= 0 && lap_end_time >= 0 && lap_start_time < _data_log->numPoints() && lap_end_time < _data_log->numPoints()) // sanity check
-		_data_log->addLap(std::make_pair(lap_start_time, lap_end_time));
+	// The log holds the points read so far, not seconds, so times past its end are clamped
+	// when converted to indexes
+	if (lap_start_time >= 0 && lap_start_time <= lap_end_time) // sanity check
+		_lap_times.push_back(std::make_pair(lap_start_time, lap_end_time));
 }
 
 /******************************************************/
@@ -107,27 +153,18 @@ bool FitParser::parseRideDetails(boost::shared_ptr<DataLog> data_log)
 
 		// Cull unused points
 		data_log->resize(_listener->numPointsRead());
+		data_log->shrinkToFit();
 		data_log->computeMaps();
 
 		// Convert laps from time to index
-		for (int i=0; i < data_log->numLaps(); ++i)
+		const std::vector<std::pair<int, int> >& lap_times = _listener->lapTimes();
+		for (unsigned int i=0; i < lap_times.size(); ++i)
 		{
-			data_log->lap(i).first = data_log->indexFromTime(data_log->lap(i).first);
-			data_log->lap(i).second = data_log->indexFromTime(data_log->lap(i).second);
+			std::pair<int, int> lap(data_log->indexFromTime(lap_times[i].first), data_log->indexFromTime(lap_times[i].second));
+			if (lap.first < lap.second)
+				data_log->addLap(lap);
 		}
 
-		// Clean up sporadic empty GPS points
-		for (int i=1; i < data_log->numPoints(); ++i)
-		{
-			if (data_log->lgd(i) == 0 && data_log->ltd(i) == 0 && data_log->dist(i) != 0)
-			{
-				data_log->lgd(i) = data_log->lgd(i-1);
-				data_log->ltd(i) = data_log->ltd(i-1);
-			}
-		}
-
-		setDataValidFlags(*data_log);
-
 		return true;
 	}
 	catch (const fit::RuntimeException&)
@@ -136,6 +173,22 @@ bool FitParser::parseRideDetails(boost::shared_ptr<DataLog> data_log)
 	}
 }
 
+/******************************************************/
+int FitParser::estimateNumPoints()
+{
+	FIT_UINT8 header[8];
+	_file->read((char*)header, sizeof(header));
+	const bool header_read = _file->good();
+	_file->clear();
+	_file->seekg(0, std::ios::beg);
+	if (!header_read)
+		return 0;
+
+	// Data size is little endian at bytes 4-7 of the file header
+	const FIT_UINT32 data_size = header[4] | (header[5] << 8) | (header[6] << 16) | ((FIT_UINT32)header[7] << 24);
+	return (int)std::min(data_size/FIT_BYTES_PER_RECORD, (FIT_UINT32)INT_MAX/2);
+}
+
 /******************************************************/
 bool FitParser::parse(const QString& filename, boost::shared_ptr<DataLog> data_log)
 {
@@ -145,11 +198,14 @@ bool FitParser::parse(const QString& filename, boost::shared_ptr<DataLog> data_l
 	_file.reset(new std::fstream);
     _file->open(filename.toStdString().c_str(), std::ios::in | std::ios::binary);
 	
+	const int size_hint = _file->is_open() ? estimateNumPoints() : 0;
+
 	fit::Decode decode;
 	read_success = _file->is_open() && decode.CheckIntegrity(*_file);
 	
 	_mesg_broadcaster.reset(new fit::MesgBroadcaster);
 	_listener.reset(new Listener(data_log));
+	_listener->setSizeHint(size_hint);
 	_mesg_broadcaster->AddListener((fit::RecordMesgListener &)*_listener);
 	_mesg_broadcaster->AddListener((fit::LapMesgListener &)*_listener);
 	
@@ -157,10 +213,16 @@ bool FitParser::parse(const QString& filename, boost::shared_ptr<DataLog> data_l
 	if (read_success)
 	{
 		data_log->filename() = filename;
+		QElapsedTimer timer;
+		timer.start();
 		read_success = parseRideDetails(data_log);
+		_parse_time = timer.nsecsElapsed()*1e-6;
+		_post_process_time = 0.0;
 		if (read_success)
 		{
-			computeAdditionalDetailts(*data_log);
+			timer.restart();
+			postProcess(*data_log);
+			_post_process_time = timer.nsecsElapsed()*1e-6;
 		}
 	}
 	_file->close();
@@ -4,6 +4,7 @@
 #include "baseparser.h"
 
 #include <fstream>
+#include <vector>
 
 #include <QDateTime.h>
 
@@ -12,6 +13,9 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#define FIT_MIN_POINTS 1024 // initial size of the log when the size of the file is not known
+#define FIT_BYTES_PER_RECORD 24 // bytes, a small record message, so the size hint is an upper bound
+
 class DataLog;
 class QString;
 
@@ -22,15 +26,23 @@ public:
 	Listener(boost::shared_ptr<DataLog> data_log);
 	int numPointsRead();
 
+	// Expected number of points, the log grows past it if needed
+	void setSizeHint(int num_points);
+
+	// Laps read (first = start time, second = end time), converted to indexes once the points are read
+	const std::vector<std::pair<int, int> >& lapTimes() const;
+
 	void OnMesg(fit::RecordMesg& mesg);
 	void OnMesg(fit::LapMesg& mesg);
 
 private:
 	boost::shared_ptr<DataLog> _data_log;
 	int _track_point_index;
+	int _size_hint;
 	int _start_time; // secs
 	double _pos_factor;
 	QDateTime _base_date;
+	std::vector<std::pair<int, int> > _lap_times; // secs
 };
 
 //***********************************************************
@@ -47,6 +59,9 @@ class FitParser : public BaseParser
 	bool parseRideDetails(boost::shared_ptr<DataLog> data_log);
 
  private:
+	// Number of points of the data size in the file header, 0 if the header can't be read
+	int estimateNumPoints();
+
 	boost::scoped_ptr<fit::MesgBroadcaster> _mesg_broadcaster;
 	boost::scoped_ptr<std::fstream> _file;
 	boost::scoped_ptr<Listener> _listener;
@@ -0,0 +1,162 @@
+#include "geokernels.h"
+
+#include <cmath>
+
+// MSVC compiles AVX2 intrinsics without /arch:AVX2, so the AVX2 kernel is built in and only
+// run when the CPU supports it
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define GEOKERNELS_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#define SMALL_ANGLE_MAX_DIST 10000.0 // m, segments longer than this are recomputed exactly
+
+/****************************************/
+// Haversine distance between 2 points
+static inline double haversine(
+	double ltd_rad_a, double lgd_rad_a, double cos_ltd_a,
+	double ltd_rad_b, double lgd_rad_b, double cos_ltd_b)
+{
+	const double sin_d_ltd = sin(0.5*(ltd_rad_b - ltd_rad_a));
+	const double sin_d_lgd = sin(0.5*(lgd_rad_b - lgd_rad_a));
+	const double a = sin_d_ltd*sin_d_ltd + sin_d_lgd*sin_d_lgd*cos_ltd_a*cos_ltd_b;
+	return 2.0*EARTH_RADIUS_M*asin(sqrt(a < 1.0 ? a : 1.0));
+}
+
+#ifdef GEOKERNELS_AVX2
+/****************************************/
+// True if the CPU has AVX2 and the OS saves the AVX registers
+static bool cpuHasAvx2()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	const bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+	if (!os_saves_avx)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+static const bool has_avx2 = cpuHasAvx2();
+
+/****************************************/
+// sin(x) for small x (|x| < 1e-3 gives ~1e-24 error): x - x^3/6 + x^5/120
+static inline __m256d smallAngleSin(__m256d x)
+{
+	const __m256d x2 = _mm256_mul_pd(x, x);
+	__m256d p = _mm256_add_pd(_mm256_mul_pd(x2, _mm256_set1_pd(1.0/120.0)), _mm256_set1_pd(-1.0/6.0));
+	p = _mm256_add_pd(_mm256_mul_pd(x2, p), _mm256_set1_pd(1.0));
+	return _mm256_mul_pd(x, p);
+}
+
+/****************************************/
+// asin(x) for small x: x + x^3/6 + 3x^5/40
+static inline __m256d smallAngleAsin(__m256d x)
+{
+	const __m256d x2 = _mm256_mul_pd(x, x);
+	__m256d p = _mm256_add_pd(_mm256_mul_pd(x2, _mm256_set1_pd(3.0/40.0)), _mm256_set1_pd(1.0/6.0));
+	p = _mm256_add_pd(_mm256_mul_pd(x2, p), _mm256_set1_pd(1.0));
+	return _mm256_mul_pd(x, p);
+}
+
+/****************************************/
+// Segments from 1 in blocks of 4, returns the first segment not computed
+static int haversineSegmentsAvx2(
+	const double* ltd_rads, const double* lgd_rads, const double* cos_ltds,
+	int n, double* seg_dist)
+{
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d diameter = _mm256_set1_pd(2.0*EARTH_RADIUS_M);
+	int i = 1;
+	for (; i+4 <= n; i+=4)
+	{
+		const __m256d d_ltd = _mm256_mul_pd(half, _mm256_sub_pd(_mm256_loadu_pd(ltd_rads+i), _mm256_loadu_pd(ltd_rads+i-1)));
+		const __m256d d_lgd = _mm256_mul_pd(half, _mm256_sub_pd(_mm256_loadu_pd(lgd_rads+i), _mm256_loadu_pd(lgd_rads+i-1)));
+		const __m256d cos_cos = _mm256_mul_pd(_mm256_loadu_pd(cos_ltds+i), _mm256_loadu_pd(cos_ltds+i-1));
+		const __m256d sin_d_ltd = smallAngleSin(d_ltd);
+		const __m256d sin_d_lgd = smallAngleSin(d_lgd);
+		const __m256d a = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(sin_d_lgd, sin_d_lgd), cos_cos), _mm256_mul_pd(sin_d_ltd, sin_d_ltd));
+		_mm256_storeu_pd(seg_dist+i, _mm256_mul_pd(diameter, smallAngleAsin(_mm256_sqrt_pd(a))));
+	}
+
+	// The polynomials are only accurate for small steps, so redo any large jumps exactly
+	for (int j=1; j < i; ++j)
+	{
+		if (seg_dist[j] > SMALL_ANGLE_MAX_DIST)
+			seg_dist[j] = haversine(ltd_rads[j-1], lgd_rads[j-1], cos_ltds[j-1], ltd_rads[j], lgd_rads[j], cos_ltds[j]);
+	}
+	return i;
+}
+#endif
+
+/****************************************/
+void GeoKernels::haversineDistances(
+	const double* ltd_rad_a, const double* lgd_rad_a, const double* cos_ltd_a,
+	const double* ltd_rad_b, const double* lgd_rad_b, const double* cos_ltd_b,
+	int n, double* dist)
+{
+	for (int i=0; i < n; ++i)
+	{
+		dist[i] = haversine(ltd_rad_a[i], lgd_rad_a[i], cos_ltd_a[i], ltd_rad_b[i], lgd_rad_b[i], cos_ltd_b[i]);
+	}
+}
+
+/****************************************/
+void GeoKernels::haversineSegments(
+	const double* ltd_rads, const double* lgd_rads, const double* cos_ltds,
+	int n, double* seg_dist)
+{
+	if (n <= 0)
+		return;
+
+	seg_dist[0] = 0.0;
+	int i = 1;
+
+#ifdef GEOKERNELS_AVX2
+	if (has_avx2)
+		i = haversineSegmentsAvx2(ltd_rads, lgd_rads, cos_ltds, n, seg_dist);
+#endif
+
+	for (; i < n; ++i)
+	{
+		seg_dist[i] = haversine(ltd_rads[i-1], lgd_rads[i-1], cos_ltds[i-1], ltd_rads[i], lgd_rads[i], cos_ltds[i]);
+	}
+}
+
+/****************************************/
+void GeoKernels::localDistancesSq(
+	double east, double north,
+	const double* easts, const double* norths,
+	int n, double* dist_sq)
+{
+	for (int i=0; i < n; ++i)
+	{
+		const double de = easts[i] - east;
+		const double dn = norths[i] - north;
+		dist_sq[i] = de*de + dn*dn;
+	}
+}
+
+/****************************************/
+void GeoKernels::bearings(
+	const double* ltd_rads, const double* lgd_rads, const double* cos_ltds,
+	int n, double* bearing)
+{
+	for (int i=0; i < n-1; ++i)
+	{
+		const double x = (lgd_rads[i+1] - lgd_rads[i])*cos_ltds[i];
+		const double y = ltd_rads[i+1] - ltd_rads[i];
+		bearing[i] = atan2(x, y)*RAD_TO_DEG;
+	}
+
+	if (n > 1)
+		bearing[n-1] = bearing[n-2];
+	else if (n == 1)
+		bearing[0] = 0.0;
+}
\ No newline at end of file
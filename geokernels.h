@@ -0,0 +1,41 @@
+#ifndef GEOKERNELS_H
+#define GEOKERNELS_H
+
+#define EARTH_RADIUS_M 6371000.0 // m, mean radius of the earth
+#define DEG_TO_RAD 0.017453292519943295
+#define RAD_TO_DEG 57.29577951308232
+
+// Distance and bearing calculations over arrays of GPS points. They take the precomputed
+// radians and cos(lat) columns of a DataLog (see DataLog::computeGeoColumns), so no
+// trigonometry is needed for distances, and the loops have no branches so the compiler
+// can vectorise them.
+
+namespace GeoKernels
+{
+	// Great circle (haversine) distance between points a[i] and b[i]
+	void haversineDistances(
+		const double* ltd_rad_a, const double* lgd_rad_a, const double* cos_ltd_a,
+		const double* ltd_rad_b, const double* lgd_rad_b, const double* cos_ltd_b,
+		int n, double* dist);
+
+	// Great circle (haversine) distance from point i-1 to point i, with seg_dist[0] = 0.
+	// Uses AVX2 when the CPU has it (small angle polynomials, exact for steps over 10km),
+	// otherwise the same scalar loop as haversineDistances
+	void haversineSegments(
+		const double* ltd_rads, const double* lgd_rads, const double* cos_ltds,
+		int n, double* seg_dist);
+
+	// Squared distance from one point to each point of an east/north (metres) frame
+	void localDistancesSq(
+		double east, double north,
+		const double* easts, const double* norths,
+		int n, double* dist_sq);
+
+	// Bearing (deg, -180 to 180, 0=north) from point i to point i+1, using a flat earth approximation.
+	// The last bearing is a copy of the one before it so there are n values
+	void bearings(
+		const double* ltd_rads, const double* lgd_rads, const double* cos_ltds,
+		int n, double* bearing);
+};
+
+#endif // GEOKERNELS_H
\ No newline at end of file
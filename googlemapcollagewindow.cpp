@@ -1,11 +1,12 @@
 #include "googlemapcollagewindow.h"
 #include "datalog.h"
 #include "dataprocessing.h"
-#include "tcxparser.h"
-#include "fitparser.h"
 #include "user.h"
 #include "dateselectorwidget.h"
 #include "logdirectorysummary.h"
+#include "heatmapbuilder.h"
+#include "heatmappyramid.h"
+#include "maprenderer.h"
 
 #include <QtWebEngineWidgets/QtWebEngineWidgets>
 #include <QDir.h>
@@ -15,6 +16,7 @@
 #include <QLabel.h>
 #include <QBoxLayout.h>
 #include <QProgressDialog.h>
+#include <QFileDialog.h>
 
 #include <qwt_scale_widget.h>
 #include <qwt_color_map.h>
@@ -92,9 +94,6 @@ _user(user)
 	_view = new QWebEngineView();
 	_view->setPage(new ChromePage()); // hack required to get google maps to display for a desktop, not touchscreen
 
-	_tcx_parser = new TcxParser();
-	_fit_parser = new FitParser();
-
 	// Create the widget for selecting dates
 	_date_selector_widget = new DateSelectorWidget();
 
@@ -106,6 +105,8 @@ _user(user)
 	// Create pushbutton
 	QPushButton* create_collage_button = new QPushButton("Create Collage");
 	connect(create_collage_button, SIGNAL(clicked()),this,SLOT(createCollage()));
+	QPushButton* save_image_button = new QPushButton("Save Image...");
+	connect(save_image_button, SIGNAL(clicked()),this,SLOT(saveImage()));
 
 	// Create label for a ledgend
 	QLabel* label = new QLabel("Path coloured to ride frequency");
@@ -122,6 +123,7 @@ _user(user)
 	QVBoxLayout* vlayout = new QVBoxLayout(this);
 	vlayout->addWidget(_date_selector_widget);
 	vlayout->addWidget(create_collage_button);
+	vlayout->addWidget(save_image_button);
 	vlayout->addWidget(_view);
 	vlayout->addWidget(key_widget);
 	vlayout->setSpacing(0);
@@ -136,82 +138,72 @@ GoogleMapCollageWindow::~GoogleMapCollageWindow()
 /******************************************************/
 void GoogleMapCollageWindow::createCollage()
 {
-	// Warn user about slowness...
-	QMessageBox::information(this, tr("RideCollage"), tr("Warning! This can be slow, please be patient. You can abort at anytime to see partial results. Click OK to continue."));
+	// Load the stored heat map, so only logs registered since it was written need parsing
+	HeatMapPyramid heat_map_pyramid(_user->logDirectory(), _heat_map_grid.zoom());
+	heat_map_pyramid.readFromFile();
+	bool heat_map_changed = (heat_map_pyramid.removeMissingRides(*_log_dir_summary) > 0);
 
-	// Get a list of the relevant log fles to work with (between selected dates)
+	// Get a list of the relevant log fles which are not in the heat map yet (between selected dates)
 	std::vector<QString> filenames;
-	for (int j=0; j < _log_dir_summary->numLogs(); ++j)
+	std::vector<QDate> dates;
+	const std::pair<int, int> range = _log_dir_summary->logsInRange(_date_selector_widget->minDate(), _date_selector_widget->maxDate());
+	for (int j=range.first; j < range.second; ++j)
 	{
 		const QDate date = _log_dir_summary->log(j).date();
-		if (date >= _date_selector_widget->minDate() && date <= _date_selector_widget->maxDate())
+		if (!heat_map_pyramid.contains(_log_dir_summary->log(j)._filename))
 		{
 			filenames.push_back(_log_dir_summary->log(j)._filename);
+			dates.push_back(date);
 		}
 	}
 
 	// Initialise
-	_accumulated_points.clear();
-	_accumulated_point_extra_info.clear();
+	_heat_map_grid.clear();
+	_accumulated_cells.clear();
 	_max_count=0;
 
-	// Create a small progress bar
-	QProgressDialog load_progress("Loading log:", "Cancel load", 0, filenames.size()-1, this);
-	load_progress.setWindowModality(Qt::WindowModal);
-	load_progress.setMinimumDuration(0); //msec
-	load_progress.setWindowTitle("RideCollage");
-
-	// Load new log files in the directory
-	for (unsigned int i=0; i < filenames.size(); ++i)
+	if (filenames.size() > 0)
 	{
-		load_progress.setValue(i);
-		load_progress.setLabelText("Loading log: " + filenames[i]);
-		if (load_progress.wasCanceled())
-			break;
-
-		boost::shared_ptr<DataLog> data_log(new DataLog);	
-		if (parse(filenames[i], data_log))
-		{	
-			if (data_log->lgdValid() && data_log->ltdValid())
-			{
-				for (int pt=0; pt < data_log->numPoints(); pt+=4)
-				{
-					LatLng lat_lng(data_log->ltd(pt), data_log->lgd(pt));
-					bool found = false;
-					
-					int a_pt=_accumulated_points.size()-1; // going backwards is slightly faster because the latest points are at the end (so break quicker)
-					while (a_pt >= 0)
-					{
-						// Check if we have visited this point previously
-						if (lat_lng == _accumulated_points[a_pt].first)
-						{
-							// Only increment frequency if we have not been here in this ride, or it is this ride but more than 60 secs ago
-							if (i != _accumulated_point_extra_info[a_pt].first || 
-								0)//abs(data_log->time(pt) - _accumulated_point_extra_info[a_pt].second) > 60)
-							{
-								_accumulated_points[a_pt].second++;
-								_accumulated_point_extra_info[a_pt].first = i;
-								_accumulated_point_extra_info[a_pt].second = data_log->time(pt);
-								if (_accumulated_points[a_pt].second > _max_count)
-									_max_count = _accumulated_points[a_pt].second;
-							}
-							found = true;
-							break;
-						}
-						--a_pt;
-					}
-
-					if (!found)
-					{
-						_accumulated_points.push_back(std::make_pair(lat_lng,1));
-						_accumulated_point_extra_info.push_back(std::make_pair(i,data_log->time(pt)));
-					}
-				}
-			}
+		// Create a small progress bar
+		QProgressDialog load_progress("Loading logs:", "Cancel load", 0, filenames.size(), this);
+		load_progress.setWindowModality(Qt::WindowModal);
+		load_progress.setMinimumDuration(0); //msec
+		load_progress.setWindowTitle("RideCollage");
+
+		// Parse and bin the log files on several threads, each cell is counted once per ride
+		HeatMapBuilder builder(_heat_map_grid.zoom());
+		builder.start(filenames);
+		while (!builder.isFinished())
+		{
+			load_progress.setValue(builder.numProcessed());
+			load_progress.setLabelText("Loading logs: " + QString::number(builder.numProcessed()) + " of " + QString::number(filenames.size()));
+			if (load_progress.wasCanceled())
+				builder.cancel(); // keep the rides loaded so far
+			QCoreApplication::processEvents();
+			QThread::msleep(50);
 		}
+		HeatMapGrid new_rides_grid(_heat_map_grid.zoom());
+		builder.merge(new_rides_grid);
+		load_progress.setValue(filenames.size());
+
+		// Store the newly loaded rides
+		for (unsigned int i=0; i < filenames.size(); ++i)
+		{
+			std::vector<HeatMapCell> cells;
+			if (builder.rideCells(i, cells))
+				heat_map_pyramid.addRide(filenames[i], dates[i], cells);
+		}
+		heat_map_changed = true;
 	}
+
+	if (heat_map_changed)
+		heat_map_pyramid.writeToFile();
+
+	heat_map_pyramid.query(_date_selector_widget->minDate(), _date_selector_widget->maxDate(), _heat_map_grid);
+	_heat_map_grid.cells(_accumulated_cells);
+	_max_count = _heat_map_grid.maxCount();
 	
-	if (_accumulated_points.size() > 0) // we have a valid path to show
+	if (_accumulated_cells.size() > 0) // we have a valid path to show
 	{
 		// Create the google map web page
 		ostringstream page;
@@ -222,20 +214,22 @@ void GoogleMapCollageWindow::createCollage()
 }
 
 /******************************************************/
-bool GoogleMapCollageWindow::parse(const QString filename, boost::shared_ptr<DataLog> data_log)
+void GoogleMapCollageWindow::saveImage()
 {
-	if (filename.contains(".fit"))
-	{
-		return _fit_parser->parse(filename, data_log);
-	}
-	else if (filename.contains(".tcx"))
+	if (_accumulated_cells.size() == 0)
 	{
-		return _tcx_parser->parse(filename, data_log);
-	}
-	else
-	{
-		return false; // unknown log type
+		QMessageBox::information(this, tr("RideCollage"), tr("Create a collage first."));
+		return;
 	}
+
+	const QString filename = QFileDialog::getSaveFileName(this, tr("Save Image"), _user->logDirectory() + "/collage.png", tr("Images (*.png *.jpg *.bmp)"));
+	if (filename.isEmpty())
+		return;
+
+	MapRenderer renderer(1600, 1200);
+	renderer.fitHeatMap(_heat_map_grid);
+	if (!MapRenderer::saveImage(renderer.renderHeatMap(_heat_map_grid), filename))
+		QMessageBox::warning(this, tr("RideCollage"), tr("Failed to write image."));
 }
 
 /******************************************************/
@@ -246,9 +240,9 @@ std::string GoogleMapCollageWindow::defineColours()
 	stream.precision(2); // only need low precision
 	stream.setf(ios::fixed,ios::floatfield);
 
-	for (unsigned int i=0; i < _accumulated_points.size(); ++i) // one less key since there is one more polyline segment in the path
+	for (unsigned int i=0; i < _accumulated_cells.size(); ++i)
 	{
-		double key = std::min((double)_accumulated_points[i].second/_max_count, 1.0);
+		double key = std::min((double)_accumulated_cells[i]._count/_max_count, 1.0);
 		stream << key << ", ";
 	}
 
@@ -264,9 +258,9 @@ std::string GoogleMapCollageWindow::defineCoords()
 	stream.precision(6); // set precision so we plot lat/long correctly
 	stream.setf(ios::fixed,ios::floatfield);
 
-	for (unsigned int i=0; i < _accumulated_points.size(); ++i)
+	for (unsigned int i=0; i < _accumulated_cells.size(); ++i)
 	{
-		stream << "new google.maps.LatLng(" << _accumulated_points[i].first._lat << "," << _accumulated_points[i].first._lng<< ")," << endl;
+		stream << "new google.maps.LatLng(" << _heat_map_grid.cellLtd(_accumulated_cells[i]) << "," << _heat_map_grid.cellLgd(_accumulated_cells[i]) << ")," << endl;
 	}
 
 	return stream.str();
@@ -1,7 +1,7 @@
 #ifndef GOOGLEMAPCOLLAGE_H
 #define GOOGLEMAPCOLLAGE_H
 
-#include "latlng.h"
+#include "heatmapgrid.h"
 
 #include <qtxml/qdomdocument>
 #include <QWidget.h>
@@ -14,8 +14,6 @@
 #include <boost/shared_ptr.hpp>
 
 class DataLog;
-class TcxParser;
-class FitParser;
 class QComboBox;
 class ColourBar;
 class DateSelectorWidget;
@@ -34,6 +32,9 @@ class GoogleMapCollageWindow : public QWidget
 	// Display selected the rides on a google map
 	void createCollage();
 
+	// Save the collage as an image, drawn without google maps
+	void saveImage();
+
  private:
 	// Create the webpage to display google maps
 	void createPage(std::ostringstream& page);
@@ -41,16 +42,11 @@ class GoogleMapCollageWindow : public QWidget
 	std::string defineColours();
 	std::string defineCoords();
 
-	bool parse(const QString filename, boost::shared_ptr<DataLog> data_log);
-
-	TcxParser* _tcx_parser;
-	FitParser* _fit_parser;
-
 	// The window to display google maps
 	QWebEngineView *_view;
 
-	std::vector<std::pair<LatLng, int> > _accumulated_points; // first=lat,long, second=count
-	std::vector<std::pair<int, double> > _accumulated_point_extra_info; // first=ride id, second=time
+	HeatMapGrid _heat_map_grid; // ride frequency of each grid cell
+	std::vector<HeatMapCell> _accumulated_cells; // cells to draw, ordered by grid key
 	ColourBar* _colour_bar;
 	int _max_count;
 	
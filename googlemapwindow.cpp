@@ -3,12 +3,15 @@
 #include "user.h"
 #include "dataprocessing.h"
 #include "colours.h"
+#include "polylineencoder.h"
 
 #include <QtWebEngineWidgets/QtWebEngineWidgets>
 #include <QDir.h>
 #include <QComboBox.h>
 #include <QLabel.h>
 #include <QBoxLayout.h>
+#include <QTimer.h>
+#include <QPointer.h>
 
 #include <qwt_scale_widget.h>
 #include <qwt_color_map.h>
@@ -20,6 +23,22 @@
 using namespace std;
 
 #define UNDEFINED_IDX -1
+#define MAP_UPDATE_INTERVAL 16 // msec, about the display refresh rate
+
+/******************************************************/
+// Callback for when the page has run a map update, so the next one can be sent. The window
+// may be closed while the update runs, so it is held by a guarded pointer
+struct MapUpdateDone
+{
+	MapUpdateDone(GoogleMapWindow* window): _window(window) {}
+	void operator()(const QVariant&) const
+	{
+		if (_window.isNull())
+			return;
+		_window->mapUpdateDone();
+	}
+	QPointer<GoogleMapWindow> _window;
+};
 
 /******************************************************/
 // Function to convert a QColor into a hex rgb representation
@@ -151,6 +170,14 @@ _data_log()
 	_selection_begin_idx = UNDEFINED_IDX;
 	_selection_end_idx = UNDEFINED_IDX;
 
+	// Marker and selection changes are coalesced and sent at most once per interval
+	_update_timer = new QTimer(this);
+	_update_timer->setSingleShot(true);
+	_update_timer->setInterval(MAP_UPDATE_INTERVAL);
+	connect(_update_timer, SIGNAL(timeout()), this, SLOT(sendMapUpdate()));
+	_update_in_flight = false;
+	clearMapUpdate();
+
 	// Selection for path colour scheme
 	_path_colour_scheme = new QComboBox();
 	_path_colour_scheme->setMaximumWidth(120);
@@ -207,8 +234,14 @@ void GoogleMapWindow::displayRide(boost::shared_ptr<DataLog> data_log, boost::sh
 		_data_log = data_log;
 		_user = user;
 
+		// Pending updates refer to the previous page
+		clearMapUpdate();
+		_update_in_flight = false;
+
 		if (_data_log->lgdValid() && _data_log->ltdValid()) // we have a valid path to show
 		{
+			_path_simplifier.simplify(*_data_log);
+
 			// Create the google map web page
 			ostringstream page;
 			createPage(page);
@@ -222,6 +255,8 @@ void GoogleMapWindow::displayRide(boost::shared_ptr<DataLog> data_log, boost::sh
 		}
 		else // no valid path to show
 		{
+			_path_simplifier.clear();
+
 			// Create the google map web page
 			ostringstream page;
 			createEmptyPage(page);
@@ -245,30 +280,18 @@ void GoogleMapWindow::setMarkerPosition(int idx)
 {
 	if (idx > 0 && idx < _data_log->numPoints())
 	{
-		double ltd = _data_log->ltd(idx);
-		double lgd = _data_log->lgd(idx);
-
-		ostringstream stream;
-		stream.precision(6); // set precision so we plot lat/long correctly
-		stream.setf(ios::fixed,ios::floatfield);
-
-		stream << "setMarker(" << ltd << "," << lgd << ");";
-		_view->page()->runJavaScript(QString::fromStdString(stream.str()));
+		_pending_marker_idx = idx;
+		scheduleMapUpdate();
 	}
 }
 
 /******************************************************/
 void GoogleMapWindow::setSelection(int idx_start, int idx_end, bool zoom_map)
 {
-	ostringstream stream;
-	stream << "var coords = [" << endl
-		<< defineCoords(idx_start, idx_end) << endl // create a path from GPS coords
-		<< "];" << endl;
-	if (zoom_map)
-		stream << "setSelectionPath(coords, true);";
-	else
-		stream << "setSelectionPath(coords, false);";
-	_view->page()->runJavaScript(QString::fromStdString(stream.str()));
+	_pending_selection_start = idx_start;
+	_pending_selection_end = idx_end;
+	_pending_selection_zoom = _pending_selection_zoom || zoom_map; // don't lose a zoom requested earlier in the interval
+	scheduleMapUpdate();
 }
 
 /******************************************************/
@@ -295,13 +318,9 @@ void GoogleMapWindow::setStartEndMarkers(int idx_start, int idx_end)
 	if (idx_end < 1)
 		idx_end = 1;
 
-	// Now define coords between start and end
-	ostringstream stream;
-	stream << "var coords = [" << endl
-		<< defineStartEndCoords(idx_start, idx_end) << endl // create a path from GPS coords
-		<< "];" << endl;
-	stream << "setSelectionStartEnd(coords);";
-	_view->page()->runJavaScript(QString::fromStdString(stream.str()));
+	_pending_start_end_start = idx_start;
+	_pending_start_end_end = idx_end;
+	scheduleMapUpdate();
 }
 
 /******************************************************/
@@ -339,9 +358,67 @@ void GoogleMapWindow::deleteSelection()
 	_selection_begin_idx = UNDEFINED_IDX;
 	_selection_end_idx = UNDEFINED_IDX;
 
-	ostringstream stream;
-	stream << "deleteSelectionPath();";
-	_view->page()->runJavaScript(QString::fromStdString(stream.str()));
+	// Deleting replaces any selection still waiting to be sent
+	_pending_delete_selection = true;
+	_pending_selection_start = UNDEFINED_IDX;
+	_pending_selection_end = UNDEFINED_IDX;
+	_pending_selection_zoom = false;
+	_pending_start_end_start = UNDEFINED_IDX;
+	_pending_start_end_end = UNDEFINED_IDX;
+	scheduleMapUpdate();
+}
+
+/******************************************************/
+void GoogleMapWindow::clearMapUpdate()
+{
+	_pending_marker_idx = UNDEFINED_IDX;
+	_pending_selection_start = UNDEFINED_IDX;
+	_pending_selection_end = UNDEFINED_IDX;
+	_pending_selection_zoom = false;
+	_pending_start_end_start = UNDEFINED_IDX;
+	_pending_start_end_end = UNDEFINED_IDX;
+	_pending_delete_selection = false;
+}
+
+/******************************************************/
+void GoogleMapWindow::scheduleMapUpdate()
+{
+	if (!_update_timer->isActive() && !_update_in_flight)
+		_update_timer->start();
+}
+
+/******************************************************/
+void GoogleMapWindow::sendMapUpdate()
+{
+	if (_update_in_flight) // the page is still busy, mapUpdateDone will schedule another
+		return;
+
+	// Only the latest state is sent, and selections as index ranges into the coords already on the page
+	QString script;
+	if (_pending_delete_selection)
+		script += "deleteSelectionPath();";
+	if (_pending_selection_start != UNDEFINED_IDX)
+		script += "setSelectionRange(" + QString::number(_pending_selection_start) + "," + QString::number(_pending_selection_end) + (_pending_selection_zoom ? ",true);" : ",false);");
+	if (_pending_start_end_start != UNDEFINED_IDX)
+		script += "setSelectionStartEndRange(" + QString::number(_pending_start_end_start) + "," + QString::number(_pending_start_end_end) + ");";
+	if (_pending_marker_idx != UNDEFINED_IDX)
+		script += "setMarker(" + QString::number(_data_log->ltd(_pending_marker_idx),'f',6) + "," + QString::number(_data_log->lgd(_pending_marker_idx),'f',6) + ");";
+	clearMapUpdate();
+
+	if (!script.isEmpty())
+	{
+		_update_in_flight = true;
+		_view->page()->runJavaScript(script, MapUpdateDone(this));
+	}
+}
+
+/******************************************************/
+void GoogleMapWindow::mapUpdateDone()
+{
+	_update_in_flight = false;
+	if (_pending_marker_idx != UNDEFINED_IDX || _pending_selection_start != UNDEFINED_IDX ||
+		_pending_start_end_start != UNDEFINED_IDX || _pending_delete_selection)
+		scheduleMapUpdate();
 }
 
 /******************************************************/
@@ -364,10 +441,6 @@ void GoogleMapWindow::moveAndHoldSelection(int delta_idx)
 void GoogleMapWindow::definePathColour()
 {
 	// Colour the path and set the colour bar correspondingly
-	ostringstream stream;
-	stream.precision(2); // only need low precision
-	stream.setf(ios::fixed,ios::floatfield);
-	
 	// First determine min and max of signal to colour code
 	double max = 0.0;
 	double min = 0.0;
@@ -401,9 +474,10 @@ void GoogleMapWindow::definePathColour()
 
 	double factor;
 	double min_key = 1.0;
-	stream << "var key = [" << endl;
-	for (int i=0; i < _data_log->numPoints()-1; ++i) // one less key since there is one more polyline segment in the path
+	std::vector<double> keys(_path_simplifier.numPoints()); // one key per coord on the map, each colours the segment it starts
+	for (int pt=0; pt < _path_simplifier.numPoints(); ++pt)
 	{
+		const int i = _path_simplifier.index(pt);
 		double key = 1.0;
 		switch (_path_colour_scheme->currentIndex())
 		{
@@ -453,18 +527,20 @@ void GoogleMapWindow::definePathColour()
 		}
 		key = std::max(key,0.0);
 		key = std::min(key,1.0);
-		stream << key << ", ";
+		keys[pt] = key;
 
 		if (key < min_key) // keep track of the min key value
 			min_key = key;
 	}
 
-	stream << "];" << endl; 
+	std::string script;
 	if (_path_colour_scheme->currentIndex() == 2) // handle HR zones differently to all other atributes
-		stream << "strokeRidePathHRZones(key);";
+		script = "strokeRidePathHRZones(decodeFractions(\"";
 	else
-		stream << "strokeRidePath(key);";
-	_view->page()->runJavaScript(QString::fromStdString(stream.str()));
+		script = "strokeRidePath(decodeFractions(\"";
+	PolylineEncoder::encodeFractions(keys, script);
+	script += "\"));";
+	_view->page()->runJavaScript(QString::fromStdString(script));
 
 	// Draw the colour bar appropriately
 	if (_path_colour_scheme->currentIndex() == 2) // HR zone colour bar
@@ -488,30 +564,44 @@ void GoogleMapWindow::definePathColour()
 /******************************************************/
 std::string GoogleMapWindow::defineCoords(int idx_start, int idx_end)
 {
-	ostringstream stream;
-	stream.precision(6); // set precision so we plot lat/long correctly
-	stream.setf(ios::fixed,ios::floatfield);
+	// Only the points of the finest level of detail, the rest are not visible on the map
+	std::vector<int> indecies;
+	_path_simplifier.indecies(PATH_SIMPLIFIER_NUM_LEVELS-1, idx_start, idx_end, indecies);
 
-	for (int i = idx_start; i < idx_end; ++i)
+	std::vector<double> ltd(indecies.size()), lgd(indecies.size());
+	for (unsigned int i = 0; i < indecies.size(); ++i)
 	{
-		if (_data_log->ltd(i) != 0.0 && _data_log->lgd(i) != 0.0) // only plot non-zero values
-			stream << "new google.maps.LatLng(" << _data_log->ltd(i) << "," << _data_log->lgd(i) << ")," << endl;
+		ltd[i] = _data_log->ltd(indecies[i]);
+		lgd[i] = _data_log->lgd(indecies[i]);
 	}
 
-	return stream.str();
+	std::string encoded;
+	PolylineEncoder::encodeCoords(ltd, lgd, encoded);
+	return encoded;
 }
 
 /******************************************************/
-std::string GoogleMapWindow::defineStartEndCoords(int idx_start, int idx_end)
+std::string GoogleMapWindow::defineCoordIndecies()
 {
-	ostringstream stream;
-	stream.precision(6); // set precision so we plot lat/long correctly
-	stream.setf(ios::fixed,ios::floatfield);
+	std::vector<int> indecies(_path_simplifier.numPoints());
+	for (int i = 0; i < _path_simplifier.numPoints(); ++i)
+		indecies[i] = _path_simplifier.index(i);
+
+	std::string encoded;
+	PolylineEncoder::encodeInts(indecies, encoded);
+	return encoded;
+}
 
-	stream << "new google.maps.LatLng(" << _data_log->ltd(idx_start) << "," << _data_log->lgd(idx_start) << ")," << endl;
-	stream << "new google.maps.LatLng(" << _data_log->ltd(idx_end-1) << "," << _data_log->lgd(idx_end-1) << ")," << endl;
+/******************************************************/
+std::string GoogleMapWindow::defineCoordLevels()
+{
+	std::vector<int> levels(_path_simplifier.numPoints());
+	for (int i = 0; i < _path_simplifier.numPoints(); ++i)
+		levels[i] = _path_simplifier.level(i);
 
-	return stream.str();
+	std::string encoded;
+	PolylineEncoder::encodeInts(levels, encoded);
+	return encoded;
 }
 
 /******************************************************/
@@ -541,6 +631,16 @@ void GoogleMapWindow::createPage(std::ostringstream& page)
 		<< "var colours = [\"00FF00\", \"19FF00\", \"32FF00\", \"4CFF00\", \"66FF00\", \"7FFF00\", \"99FF00\", \"B2FF00\", \"CCFF00\", \"E5FF00\", \"FFFF00\", \"FFE500\", \"FFCC00\", \"FFB200\", \"FF9900\", \"FF7F00\", \"FF6600\", \"FF4C00\", \"FF3300\", \"FF1900\", \"FF0000\"];" << endl // colour table, from green to red in 20 steps
 		<< "var hr_colours = [\"" << hexFromColour(HR_ZONE0_COLOUR) << "\", \"" << hexFromColour(HR_ZONE1_COLOUR) << "\", \"" << hexFromColour(HR_ZONE2_COLOUR) << "\", \"" << hexFromColour(HR_ZONE3_COLOUR) << "\", \"" << hexFromColour(HR_ZONE4_COLOUR) << "\", \"" << hexFromColour(HR_ZONE5_COLOUR) << "\"];" << endl // colour table for hr, from green to red in 20 steps
 		<< "var ride_path = new Array();" << endl
+		<< "var ride_path_idx = new Array();" << endl // coord index of the start of each segment
+		<< "var ride_idx;" << endl // data log index of each coord
+		<< "var ride_level;" << endl // coarsest level of detail each coord is drawn at
+		<< "var level_zooms = [";
+	for (int l=0; l < PATH_SIMPLIFIER_NUM_LEVELS; ++l)
+		oss << PathSimplifier::zoomFromLevel(l) << ",";
+	oss << "];" << endl
+		<< "var current_level = -1;" << endl
+		<< "var current_key = null;" << endl
+		<< "var current_key_hr_zones = false;" << endl
 		<< "var ride_bounds = new google.maps.LatLngBounds();" << endl
 		<< "var ride_coords;" << endl
 		<< "var grey_style = [ { featureType: \"all\",  elementType: \"all\", stylers: [ { saturation: -100 }]}];" << endl
@@ -597,13 +697,22 @@ void GoogleMapWindow::createPage(std::ostringstream& page)
 		<< "map.setMapTypeId('grey');" << endl
 
 		<< "selected_path = new google.maps.Polyline({strokeColor: \"#000000\",strokeOpacity: 1.0, strokeWeight: 8, zIndex: 1});" << endl
-		<< "ride_coords = [" << defineCoords(0, _data_log->numPoints()) << "];" << endl // create a path from GPS coords
+		<< "ride_coords = decodeCoords(\"" << defineCoords(0, _data_log->numPoints()) << "\");" << endl // create a path from the simplified GPS coords
+		<< "ride_idx = decodeInts(\"" << defineCoordIndecies() << "\");" << endl
+		<< "ride_level = decodeInts(\"" << defineCoordLevels() << "\");" << endl
 		
-		<< "for (var i = 0, len = ride_coords.length; i < len-1; i++) {" << endl
-		<< "path = [ride_coords[i], ride_coords[i+1]];" << endl
-		<< "ride_path[i] = new google.maps.Polyline({path: path, strokeColor: \"#FF0000\", strokeOpacity: 1.0, strokeWeight: 3, zIndex: 2, map: map });" << endl
+		<< "for (var i = 0, len = ride_coords.length; i < len; i++) {" << endl
 		<< "ride_bounds.extend(ride_coords[i]);" << endl
 		<< "}" << endl
+
+		// Redraw the path when the zoom needs a different level of detail
+		<< "google.maps.event.addListener(map, 'zoom_changed', function() {" << endl
+		<< "var level = levelFromZoom(map.getZoom());" << endl
+		<< "if (level != current_level) drawRidePath(level);" << endl
+		<< "});" << endl
+		<< "google.maps.event.addListenerOnce(map, 'idle', function() {" << endl
+		<< "if (current_level < 0) drawRidePath(levelFromZoom(map.getZoom()));" << endl
+		<< "});" << endl
 		
 		<< "map.fitBounds(ride_bounds);" << endl
 		<< "start_marker.setMap(map);" << endl
@@ -612,6 +721,39 @@ void GoogleMapWindow::createPage(std::ostringstream& page)
 		<< "finish_marker.setPosition(ride_coords[ride_coords.length-1]);" << endl
 		<< "}" << endl
 
+		// Functions to decode the compact coords, indecies and colour keys
+		<< PolylineEncoder::javascriptDecoders()
+
+		// Function to return the level of detail for a map zoom
+		<< "function levelFromZoom(zoom) {" << endl
+		<< "var level = 0;" << endl
+		<< "for (var l = 0; l < level_zooms.length; l++) {" << endl
+		<< "if (zoom >= level_zooms[l]) level = l;" << endl
+		<< "}" << endl
+		<< "return level;" << endl
+		<< "}" << endl
+
+		// Function to draw the ride path at a level of detail, one polyline per segment so it can be coloured
+		<< "function drawRidePath(level) {" << endl
+		<< "for (var i = 0; i < ride_path.length; i++) {" << endl
+		<< "ride_path[i].setMap(null);" << endl
+		<< "}" << endl
+		<< "ride_path = new Array();" << endl
+		<< "ride_path_idx = new Array();" << endl
+		<< "var prev = 0;" << endl
+		<< "for (var i = 1, len = ride_coords.length; i < len; i++) {" << endl
+		<< "if (ride_level[i] <= level) {" << endl
+		<< "ride_path.push(new google.maps.Polyline({path: [ride_coords[prev], ride_coords[i]], strokeColor: \"#FF0000\", strokeOpacity: 1.0, strokeWeight: 3, zIndex: 2, map: map }));" << endl
+		<< "ride_path_idx.push(prev);" << endl
+		<< "prev = i;" << endl
+		<< "}" << endl
+		<< "}" << endl
+		<< "current_level = level;" << endl
+		<< "if (current_key != null) {" << endl
+		<< "if (current_key_hr_zones) strokeRidePathHRZones(current_key); else strokeRidePath(current_key);" << endl
+		<< "}" << endl
+		<< "}" << endl
+
 		// Function setMarker
 		<< "function setMarker(ltd,lgd) {" << endl
 		<< "var lat_lng = new google.maps.LatLng(ltd ,lgd);" << endl
@@ -632,6 +774,30 @@ void GoogleMapWindow::createPage(std::ostringstream& page)
 		<< "}" << endl
 		<< "}" << endl
 
+		// Function to return the first coord at or after a data log index
+		<< "function coordFromIndex(idx) {" << endl
+		<< "var lo = 0, hi = ride_idx.length;" << endl
+		<< "while (lo < hi) {" << endl
+		<< "var mid = (lo + hi) >> 1;" << endl
+		<< "if (ride_idx[mid] < idx) lo = mid + 1; else hi = mid;" << endl
+		<< "}" << endl
+		<< "return lo;" << endl
+		<< "}" << endl
+
+		// Function setSelectionRange (highlight the path between two data log indecies)
+		<< "function setSelectionRange(idx_start, idx_end, zoom_map) {" << endl
+		<< "var first = Math.min(coordFromIndex(idx_start), ride_coords.length-1);" << endl
+		<< "var last = Math.max(coordFromIndex(idx_end), first+1);" << endl
+		<< "setSelectionPath(ride_coords.slice(first, last), zoom_map);" << endl
+		<< "}" << endl
+
+		// Function setSelectionStartEndRange (place start and end markers at two data log indecies)
+		<< "function setSelectionStartEndRange(idx_start, idx_end) {" << endl
+		<< "var first = Math.min(coordFromIndex(idx_start), ride_coords.length-1);" << endl
+		<< "var last = Math.max(coordFromIndex(idx_end)-1, 0);" << endl
+		<< "setSelectionStartEnd([ride_coords[first], ride_coords[last]]);" << endl
+		<< "}" << endl
+
 		// Function to setSelectionStartEnd (place start and end markers)
 		<< "function setSelectionStartEnd(coords) { " << endl
 		<< "start_marker.setPosition(coords[0]);" << endl
@@ -648,29 +814,24 @@ void GoogleMapWindow::createPage(std::ostringstream& page)
 
 		// Function to stroke ride path (ie colour it) according to key vector (0 <= key[i] <= 1)
 		<< "function strokeRidePath(key) {" << endl
-		<< "if (key.length == ride_path.length) {" << endl
+		<< "current_key = key;" << endl
+		<< "current_key_hr_zones = false;" << endl
+		<< "if (key.length > 0) {" << endl
 		<< "for (i=0; i<ride_path.length; i++) {" << endl
-		<< "ride_path[i].setOptions({strokeColor: colourFromFraction(key[i]),strokeOpacity: 1.0});" << endl
+		<< "ride_path[i].setOptions({strokeColor: colourFromFraction(key[ride_path_idx[i]]),strokeOpacity: 1.0});" << endl
 		<< "}" << endl
 		<< "}" << endl
 		<< "}" << endl
 
 		// Function to stroke ride path (ie colour it) according to key vector (0 <= key[i] <= 1), specific for HR zones
 		<< "function strokeRidePathHRZones(key) {" << endl
-		<< "if (key.length == ride_path.length) {" << endl
+		<< "current_key = key;" << endl
+		<< "current_key_hr_zones = true;" << endl
+		<< "if (key.length > 0) {" << endl
 		<< "for (i=0; i<ride_path.length; i++) {" << endl
-		<< "if (key[i] == 0.0)" << endl
-		<< "{ride_path[i].setOptions({strokeColor: hr_colours[0], strokeOpacity: 0.4});}" << endl
-		<< "else if (key[i] == 0.1)" << endl
-		<< "{ride_path[i].setOptions({strokeColor: hr_colours[1], strokeOpacity: 0.4});}" << endl
-		<< "else if (key[i] == 0.2)" << endl
-		<< "{ride_path[i].setOptions({strokeColor: hr_colours[2], strokeOpacity: 0.4});}" << endl
-		<< "else if (key[i] == 0.3)" << endl
-		<< "{ride_path[i].setOptions({strokeColor: hr_colours[3], strokeOpacity: 0.4});}" << endl
-		<< "else if (key[i] == 0.4)" << endl
-		<< "{ride_path[i].setOptions({strokeColor: hr_colours[4], strokeOpacity: 0.4});}" << endl
-		<< "else if (key[i] == 0.5)" << endl
-		<< "{ride_path[i].setOptions({strokeColor: hr_colours[5], strokeOpacity: 0.4});}" << endl
+		<< "var zone = Math.round(key[ride_path_idx[i]]*10);" << endl // keys are 0.1 per zone
+		<< "if (zone >= 0 && zone < hr_colours.length)" << endl
+		<< "{ride_path[i].setOptions({strokeColor: hr_colours[zone], strokeOpacity: 0.4});}" << endl
 		<< "}" << endl
 		<< "}" << endl
 		<< "}" << endl
@@ -1,6 +1,8 @@
 #ifndef GOOGLEMAP_H
 #define GOOGLEMAP_H
 
+#include "pathsimplifier.h"
+
 #include <qtxml/qdomdocument>
 #include <QWidget.h>
 #include <QPoint.h>
@@ -14,6 +16,8 @@ class User;
 class QComboBox;
 class ColourBar;
 class ColourBarHRZones;
+class QTimer;
+struct MapUpdateDone;
 
 class GoogleMapWindow : public QWidget
 {
@@ -59,6 +63,9 @@ private slots:
 	// Call when a user completes moving the selected region (to highlight path on the map)
 	void moveAndHoldSelection(int delta_idx);
 
+	// Send the pending marker and selection changes to the page in one script
+	void sendMapUpdate();
+
  private:
 	// Create the webpage to display google maps
 	void createPage(std::ostringstream& page);
@@ -69,8 +76,9 @@ private slots:
 	// Create sting decription of lat/long between first and last iterators
 	std::string defineCoords(int idx_start, int idx_end);
 
-	// Create sting decription of lat/long for first and last iterators (ie 2 coords only)
-	std::string defineStartEndCoords(int idx_start, int idx_end);
+	// Create sting decription of the DataLog index and level of detail of each simplified coord
+	std::string defineCoordIndecies();
+	std::string defineCoordLevels();
 
 	// Draw the path between the start and end time on the map. Bool param to define whether to zoom the map
 	void setSelection(int idx_start, int idx_end, bool zoom_map);
@@ -78,6 +86,14 @@ private slots:
 	// Draw the markers at the start and end of path
 	void setStartEndMarkers(int idx_start, int idx_end);
 
+	// Queue a map update, sent when the update timer fires
+	void scheduleMapUpdate();
+	void clearMapUpdate();
+
+	// Called when the page has finished the last update
+	friend struct MapUpdateDone;
+	void mapUpdateDone();
+
 	// The window to display google maps
 	QWebEngineView *_view;
 	// The start index of selection to highlight
@@ -86,8 +102,20 @@ private slots:
 	int _selection_end_idx;
 	// Pointer to the data log
 	boost::shared_ptr<DataLog> _data_log;
+	// Simplified ride path, with a level of detail for each map zoom
+	PathSimplifier _path_simplifier;
 	// Pointer to the urser
 	boost::shared_ptr<User> _user;
+	// Coalesced map updates, only the latest of each is sent (UNDEFINED_IDX if none)
+	QTimer* _update_timer;
+	bool _update_in_flight;
+	int _pending_marker_idx;
+	int _pending_selection_start;
+	int _pending_selection_end;
+	bool _pending_selection_zoom;
+	int _pending_start_end_start;
+	int _pending_start_end_end;
+	bool _pending_delete_selection;
 	// GUI controls
 	QComboBox* _path_colour_scheme;
 	ColourBar* _colour_bar;
@@ -0,0 +1,173 @@
+#include "heatmapbuilder.h"
+#include "datalog.h"
+#include "tcxparser.h"
+#include "fitparser.h"
+
+#include <cassert>
+#include <algorithm>
+
+/****************************************/
+HeatMapWorker::HeatMapWorker(
+	const std::vector<QString>& filenames,
+	int zoom,
+	QAtomicInt& next_index,
+	QAtomicInt& num_processed,
+	QAtomicInt& cancelled):
+_filenames(filenames),
+_grid(zoom),
+_next_index(next_index),
+_num_processed(num_processed),
+_cancelled(cancelled)
+{
+	// Parsers are not shared between threads
+	_tcx_parser = new TcxParser();
+	_fit_parser = new FitParser();
+}
+
+/****************************************/
+HeatMapWorker::~HeatMapWorker()
+{
+	wait();
+	delete _tcx_parser;
+	delete _fit_parser;
+}
+
+/****************************************/
+const HeatMapGrid& HeatMapWorker::grid() const
+{
+	return _grid;
+}
+
+/****************************************/
+const std::vector<std::pair<int, std::vector<HeatMapCell> > >& HeatMapWorker::rideCells() const
+{
+	return _ride_cells;
+}
+
+/****************************************/
+void HeatMapWorker::run()
+{
+	while (_cancelled.loadAcquire() == 0)
+	{
+		const int i = _next_index.fetchAndAddOrdered(1);
+		if (i >= (int)_filenames.size())
+			break;
+
+		boost::shared_ptr<DataLog> data_log(new DataLog);
+		if (parse(_filenames[i], data_log))
+		{
+			// Keep the cells of each ride, so they can be stored without parsing the log again
+			HeatMapGrid ride_grid(_grid.zoom());
+			ride_grid.addRide(i, *data_log);
+			_ride_cells.push_back(std::make_pair(i, std::vector<HeatMapCell>()));
+			ride_grid.cells(_ride_cells.back().second);
+
+			for (unsigned int c=0; c < _ride_cells.back().second.size(); ++c)
+				_grid.addCell(i, _ride_cells.back().second[c]._x, _ride_cells.back().second[c]._y);
+		}
+
+		_num_processed.fetchAndAddOrdered(1);
+	}
+}
+
+/****************************************/
+bool HeatMapWorker::parse(const QString filename, boost::shared_ptr<DataLog> data_log)
+{
+	if (filename.contains(".fit"))
+	{
+		return _fit_parser->parse(filename, data_log);
+	}
+	else if (filename.contains(".tcx"))
+	{
+		return _tcx_parser->parse(filename, data_log);
+	}
+	else
+	{
+		return false; // unknown log type
+	}
+}
+
+/****************************************/
+HeatMapBuilder::HeatMapBuilder(int zoom):
+_zoom(zoom),
+_next_index(0),
+_num_processed(0),
+_cancelled(0)
+{}
+
+/****************************************/
+HeatMapBuilder::~HeatMapBuilder()
+{
+	cancel();
+	_workers.clear(); // waits for each thread
+}
+
+/****************************************/
+void HeatMapBuilder::start(const std::vector<QString>& filenames)
+{
+	assert(_workers.empty());
+
+	_filenames = filenames;
+	_ride_cells.clear();
+	_next_index.storeRelease(0);
+	_num_processed.storeRelease(0);
+	_cancelled.storeRelease(0);
+
+	const int num_threads = std::max(1, std::min(QThread::idealThreadCount(), (int)_filenames.size()));
+	for (int i=0; i < num_threads; ++i)
+	{
+		boost::shared_ptr<HeatMapWorker> worker(new HeatMapWorker(_filenames, _zoom, _next_index, _num_processed, _cancelled));
+		_workers.push_back(worker);
+		worker->start();
+	}
+}
+
+/****************************************/
+void HeatMapBuilder::cancel()
+{
+	_cancelled.storeRelease(1);
+}
+
+/****************************************/
+bool HeatMapBuilder::isFinished() const
+{
+	for (unsigned int i=0; i < _workers.size(); ++i)
+	{
+		if (!_workers[i]->isFinished())
+			return false;
+	}
+	return true;
+}
+
+/****************************************/
+int HeatMapBuilder::numProcessed() const
+{
+	return _num_processed.loadAcquire();
+}
+
+/****************************************/
+void HeatMapBuilder::merge(HeatMapGrid& grid)
+{
+	// Merge in a fixed order. Counts are sums over rides so the order does not change the
+	// result, but it keeps the bins identical from run to run
+	for (unsigned int i=0; i < _workers.size(); ++i)
+	{
+		_workers[i]->wait();
+		grid.merge(_workers[i]->grid());
+
+		for (unsigned int r=0; r < _workers[i]->rideCells().size(); ++r)
+			_ride_cells.insert(_workers[i]->rideCells()[r].first, _workers[i]->rideCells()[r].second);
+	}
+	_workers.clear();
+}
+
+/****************************************/
+bool HeatMapBuilder::rideCells(int ride_id, std::vector<HeatMapCell>& cells) const
+{
+	QMap<int, std::vector<HeatMapCell> >::const_iterator it = _ride_cells.find(ride_id);
+	if (it == _ride_cells.end())
+		return false;
+
+	cells = it.value();
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef HEATMAPBUILDER_H
+#define HEATMAPBUILDER_H
+
+#include "heatmapgrid.h"
+
+#include <QString.h>
+#include <QThread.h>
+#include <QAtomicInt.h>
+#include <QMap.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class DataLog;
+class TcxParser;
+class FitParser;
+
+/**********************************/
+// Thread which parses logs and bins them into its own grid. Logs are taken from a shared
+// index, so the workers balance the load between themselves
+class HeatMapWorker : public QThread
+{
+ public:
+	HeatMapWorker(
+		const std::vector<QString>& filenames,
+		int zoom,
+		QAtomicInt& next_index,
+		QAtomicInt& num_processed,
+		QAtomicInt& cancelled);
+	~HeatMapWorker();
+
+	const HeatMapGrid& grid() const;
+	const std::vector<std::pair<int, std::vector<HeatMapCell> > >& rideCells() const;
+
+ protected:
+	void run();
+
+ private:
+	bool parse(const QString filename, boost::shared_ptr<DataLog> data_log);
+
+	TcxParser* _tcx_parser;
+	FitParser* _fit_parser;
+
+	const std::vector<QString>& _filenames;
+	HeatMapGrid _grid;
+	std::vector<std::pair<int, std::vector<HeatMapCell> > > _ride_cells; // first=ride id, second=cells of the ride
+
+	QAtomicInt& _next_index;
+	QAtomicInt& _num_processed;
+	QAtomicInt& _cancelled;
+};
+
+/* Class to build a heat map grid from a list of logs on several threads.
+   Each ride is identified by its index in the list, and the per thread grids are merged
+   once all threads are done, so the result is identical to adding the rides one at a time. */
+
+class HeatMapBuilder
+ {
+ public:
+	HeatMapBuilder(int zoom = HEATMAP_DEFAULT_ZOOM);
+	~HeatMapBuilder();
+
+	// Start parsing the logs in the background
+	void start(const std::vector<QString>& filenames);
+
+	// Stop the threads after the logs currently being parsed (the rides done so far are kept)
+	void cancel();
+
+	bool isFinished() const;
+	int numProcessed() const;
+
+	// Wait for the threads to finish and add their rides to grid
+	void merge(HeatMapGrid& grid);
+
+	// The cells of a ride (each with a count of 1), available after merge. Returns false if the ride was not loaded
+	bool rideCells(int ride_id, std::vector<HeatMapCell>& cells) const;
+
+ private:
+	int _zoom;
+	std::vector<QString> _filenames;
+	std::vector<boost::shared_ptr<HeatMapWorker> > _workers;
+	QMap<int, std::vector<HeatMapCell> > _ride_cells;
+
+	QAtomicInt _next_index;
+	QAtomicInt _num_processed;
+	QAtomicInt _cancelled;
+ };
+
+#endif // HEATMAPBUILDER_H
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "heatmapgrid.h"
+#include "datalog.h"
+#include "webmercator.h"
+
+#include <cassert>
+#include <algorithm>
+
+/****************************************/
+HeatMapGrid::HeatMapGrid(int zoom):
+_zoom(zoom),
+_max_count(0),
+_bins()
+{
+	assert(zoom >= 0 && zoom <= 22);
+}
+
+/****************************************/
+HeatMapGrid::~HeatMapGrid()
+{}
+
+/****************************************/
+int HeatMapGrid::zoom() const
+{
+	return _zoom;
+}
+
+/****************************************/
+int HeatMapGrid::numCells() const
+{
+	return _bins.size();
+}
+
+/****************************************/
+int HeatMapGrid::maxCount() const
+{
+	return _max_count;
+}
+
+/****************************************/
+void HeatMapGrid::clear()
+{
+	_bins.clear();
+	_max_count = 0;
+}
+
+/****************************************/
+qint64 HeatMapGrid::key(int x, int y)
+{
+	return ((qint64)x << 32) | (quint32)y;
+}
+
+/****************************************/
+void HeatMapGrid::addRide(int ride_id, DataLog& data_log)
+{
+	if (!data_log.ltdValid() || !data_log.lgdValid())
+		return;
+
+	for (int pt=0; pt < data_log.numPoints(); ++pt)
+	{
+		if (data_log.sampleValid(LOG_GPS, pt)) // skip missing GPS samples
+			addPoint(ride_id, data_log.ltd(pt), data_log.lgd(pt));
+	}
+}
+
+/****************************************/
+void HeatMapGrid::addPoint(int ride_id, double ltd, double lgd)
+{
+	addCell(ride_id, (int)WebMercator::xFromLgd(lgd, _zoom), (int)WebMercator::yFromLtd(ltd, _zoom));
+}
+
+/****************************************/
+void HeatMapGrid::addCell(int ride_id, int x, int y)
+{
+	QHash<qint64, Bin>::iterator it = _bins.find(key(x,y));
+	if (it == _bins.end())
+	{
+		Bin bin;
+		bin._count = 1;
+		bin._last_ride_id = ride_id;
+		_bins.insert(key(x,y), bin);
+		_max_count = std::max(_max_count, 1);
+	}
+	else if (it.value()._last_ride_id != ride_id) // only count each ride once per cell
+	{
+		it.value()._count++;
+		it.value()._last_ride_id = ride_id;
+		_max_count = std::max(_max_count, it.value()._count);
+	}
+}
+
+/****************************************/
+void HeatMapGrid::addCount(int x, int y, int count)
+{
+	QHash<qint64, Bin>::iterator it = _bins.find(key(x,y));
+	if (it == _bins.end())
+	{
+		Bin bin;
+		bin._count = 0;
+		bin._last_ride_id = -1; // unknown
+		it = _bins.insert(key(x,y), bin);
+	}
+	it.value()._count += count;
+	_max_count = std::max(_max_count, it.value()._count);
+}
+
+/****************************************/
+void HeatMapGrid::merge(const HeatMapGrid& other)
+{
+	assert(other._zoom == _zoom);
+
+	for (QHash<qint64, Bin>::const_iterator it = other._bins.begin(); it != other._bins.end(); ++it)
+	{
+		QHash<qint64, Bin>::iterator bin = _bins.find(it.key());
+		if (bin == _bins.end())
+		{
+			bin = _bins.insert(it.key(), it.value());
+		}
+		else
+		{
+			bin.value()._count += it.value()._count; // rides are disjoint, so counts simply add
+			bin.value()._last_ride_id = std::max(bin.value()._last_ride_id, it.value()._last_ride_id);
+		}
+		_max_count = std::max(_max_count, bin.value()._count);
+	}
+}
+
+/****************************************/
+void HeatMapGrid::cells(std::vector<HeatMapCell>& cells) const
+{
+	std::vector<qint64> keys;
+	keys.reserve(_bins.size());
+	for (QHash<qint64, Bin>::const_iterator it = _bins.begin(); it != _bins.end(); ++it)
+		keys.push_back(it.key());
+	std::sort(keys.begin(), keys.end());
+
+	cells.resize(keys.size());
+	for (unsigned int i=0; i < keys.size(); ++i)
+	{
+		cells[i]._x = (int)(keys[i] >> 32);
+		cells[i]._y = (int)(quint32)(keys[i] & 0xFFFFFFFF);
+		cells[i]._count = _bins.value(keys[i])._count;
+	}
+}
+
+/****************************************/
+double HeatMapGrid::cellLtd(const HeatMapCell& cell) const
+{
+	return WebMercator::ltdFromY(cell._y + 0.5, _zoom);
+}
+
+/****************************************/
+double HeatMapGrid::cellLgd(const HeatMapCell& cell) const
+{
+	return WebMercator::lgdFromX(cell._x + 0.5, _zoom);
+}
\ No newline at end of file
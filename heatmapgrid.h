@@ -0,0 +1,71 @@
+#ifndef HEATMAPGRID_H
+#define HEATMAPGRID_H
+
+#include <QHash.h>
+
+#include <vector>
+
+#define HEATMAP_DEFAULT_ZOOM 10 // web mercator zoom of the grid cells (~150m at the equator, ~100m at 45 deg)
+
+class DataLog;
+
+/**********************************/
+struct HeatMapCell
+{
+	int _x; // web mercator pixel column at the grid zoom
+	int _y; // web mercator pixel row at the grid zoom
+	int _count; // number of rides which passed through this cell
+};
+
+/* Class to count how often rides pass through each cell of a lat/long grid.
+   Cells are web mercator pixels at a fixed zoom level and are stored in a hash
+   keyed by the quantised coordinates, so counting a sample is O(1). */
+
+class HeatMapGrid
+ {
+ public:
+	HeatMapGrid(int zoom = HEATMAP_DEFAULT_ZOOM);
+	~HeatMapGrid();
+
+	int zoom() const;
+	int numCells() const;
+	int maxCount() const;
+	void clear();
+
+	// Accumulate all GPS points of a ride. A cell is counted at most once per ride_id
+	void addRide(int ride_id, DataLog& data_log);
+
+	// Accumulate a single GPS point. A cell is counted at most once per ride_id
+	void addPoint(int ride_id, double ltd, double lgd);
+
+	// Accumulate a single cell. A cell is counted at most once per ride_id
+	void addCell(int ride_id, int x, int y);
+
+	// Add count to a cell, for restoring a grid from stored counts
+	void addCount(int x, int y, int count);
+
+	// Add the counts of another grid (of the same zoom) built from a different set of rides
+	void merge(const HeatMapGrid& other);
+
+	// Return all cells, ordered by key (so the result is independent of the order rides were added)
+	void cells(std::vector<HeatMapCell>& cells) const;
+
+	// Lat/long of the centre of a cell
+	double cellLtd(const HeatMapCell& cell) const;
+	double cellLgd(const HeatMapCell& cell) const;
+
+ private:
+	struct Bin
+	{
+		int _count;
+		int _last_ride_id;
+	};
+
+	static qint64 key(int x, int y);
+
+	int _zoom;
+	int _max_count;
+	QHash<qint64, Bin> _bins;
+ };
+
+#endif // HEATMAPGRID_H
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "heatmappyramid.h"
+#include "datalog.h"
+#include "logdirectorysummary.h"
+
+#include <cassert>
+#include <algorithm>
+
+#include <QFile.h>
+#include <QSaveFile.h>
+#include <QDataStream.h>
+
+#define HEATMAP_PYRAMID_FILENAME "heatmap.dat"
+#define HEATMAP_PYRAMID_MAGIC 0x48454154 // "HEAT"
+#define HEATMAP_PYRAMID_VERSION 1
+
+/****************************************/
+// First and last days of a month
+static QDate firstDay(int month_key)
+{
+	return QDate(month_key/12, month_key%12 + 1, 1);
+}
+
+static QDate lastDay(int month_key)
+{
+	return firstDay(month_key).addMonths(1).addDays(-1);
+}
+
+/****************************************/
+// True if the whole month is between from and to
+static bool isCompleteMonth(int month_key, const QDate& from, const QDate& to)
+{
+	return from <= firstDay(month_key) && to >= lastDay(month_key);
+}
+
+/****************************************/
+HeatMapPyramid::HeatMapPyramid(const QString& log_directory, int base_zoom, int num_levels):
+_log_directory(log_directory),
+_base_zoom(base_zoom),
+_num_levels(num_levels)
+{
+	assert(num_levels > 0 && num_levels <= base_zoom + 1);
+}
+
+/****************************************/
+HeatMapPyramid::~HeatMapPyramid()
+{}
+
+/****************************************/
+int HeatMapPyramid::baseZoom() const
+{
+	return _base_zoom;
+}
+
+/****************************************/
+int HeatMapPyramid::numLevels() const
+{
+	return _num_levels;
+}
+
+/****************************************/
+int HeatMapPyramid::numRides() const
+{
+	return _rides.size();
+}
+
+/****************************************/
+bool HeatMapPyramid::contains(const QString& filename) const
+{
+	return _rides.contains(filename);
+}
+
+/****************************************/
+int HeatMapPyramid::monthKey(const QDate& date)
+{
+	return date.year()*12 + date.month() - 1;
+}
+
+/****************************************/
+void HeatMapPyramid::addRide(DataLog& data_log)
+{
+	HeatMapGrid ride_grid(_base_zoom);
+	ride_grid.addRide(0, data_log);
+
+	std::vector<HeatMapCell> cells;
+	ride_grid.cells(cells);
+	addRide(data_log.filename(), data_log.date().date(), cells); // rides without GPS are kept too, so they are not parsed again
+}
+
+/****************************************/
+void HeatMapPyramid::addRide(const QString& filename, const QDate& date, const std::vector<HeatMapCell>& cells)
+{
+	removeRideByName(filename);
+
+	RideCells ride;
+	ride._date = date;
+	ride._cells = cells;
+	_rides.insert(filename, ride);
+	_dates.insert(date, filename);
+
+	// Add the ride to the tile of its month at each level
+	std::vector<HeatMapGrid>& tile = _tiles[monthKey(date)];
+	if (tile.empty())
+	{
+		for (int level=0; level < _num_levels; ++level)
+			tile.push_back(HeatMapGrid(_base_zoom - level));
+	}
+
+	for (int level=0; level < _num_levels; ++level)
+	{
+		HeatMapGrid ride_grid(_base_zoom - level);
+		addRideToGrid(ride, ride_grid);
+		tile[level].merge(ride_grid);
+	}
+}
+
+/****************************************/
+bool HeatMapPyramid::removeRideByName(const QString& filename)
+{
+	QMap<QString, RideCells>::iterator it = _rides.find(filename);
+	if (it == _rides.end())
+		return false;
+
+	const int month_key = monthKey(it.value()._date);
+	_dates.remove(it.value()._date, filename);
+	_rides.erase(it);
+	rebuildTile(month_key);
+	return true;
+}
+
+/****************************************/
+int HeatMapPyramid::removeMissingRides(const LogDirectorySummary& log_dir_summary)
+{
+	// Each month with a removed ride is rebuilt once
+	QMap<int, bool> months;
+	int num_removed = 0;
+	QMap<QString, RideCells>::iterator it = _rides.begin();
+	while (it != _rides.end())
+	{
+		if (log_dir_summary.indexOf(it.key()) < 0)
+		{
+			months.insert(monthKey(it.value()._date), true);
+			_dates.remove(it.value()._date, it.key());
+			it = _rides.erase(it);
+			++num_removed;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (QMap<int, bool>::const_iterator month = months.begin(); month != months.end(); ++month)
+		rebuildTile(month.key());
+	return num_removed;
+}
+
+/****************************************/
+void HeatMapPyramid::addRideToGrid(const RideCells& ride, HeatMapGrid& grid) const
+{
+	// A ride only visits each base cell once, but several base cells can fall in one coarser cell
+	const int level = _base_zoom - grid.zoom();
+	for (unsigned int i=0; i < ride._cells.size(); ++i)
+		grid.addCell(0, ride._cells[i]._x >> level, ride._cells[i]._y >> level);
+}
+
+/****************************************/
+void HeatMapPyramid::addRidesToGrid(const QDate& from, const QDate& to, HeatMapGrid& grid) const
+{
+	for (QMultiMap<QDate, QString>::const_iterator it = _dates.lowerBound(from); it != _dates.end() && it.key() <= to; ++it)
+	{
+		HeatMapGrid ride_grid(grid.zoom());
+		addRideToGrid(_rides.constFind(it.value()).value(), ride_grid);
+		grid.merge(ride_grid);
+	}
+}
+
+/****************************************/
+void HeatMapPyramid::rebuildTile(int month_key)
+{
+	_tiles.remove(month_key);
+
+	// Only the rides of the month are visited
+	const QDate first_day = firstDay(month_key);
+	const QDate last_day = lastDay(month_key);
+	if (_dates.lowerBound(first_day) == _dates.end() || _dates.lowerBound(first_day).key() > last_day)
+		return; // no rides left in the month
+
+	std::vector<HeatMapGrid>& tile = _tiles[month_key];
+	for (int level=0; level < _num_levels; ++level)
+	{
+		tile.push_back(HeatMapGrid(_base_zoom - level));
+		addRidesToGrid(first_day, last_day, tile[level]);
+	}
+}
+
+/****************************************/
+void HeatMapPyramid::query(const QDate& from, const QDate& to, HeatMapGrid& grid) const
+{
+	const int level = _base_zoom - grid.zoom();
+	assert(level >= 0 && level < _num_levels);
+
+	const int first_month = monthKey(from);
+	const int last_month = monthKey(to);
+
+	// Complete months come from the tiles
+	for (QMap<int, std::vector<HeatMapGrid> >::const_iterator it = _tiles.lowerBound(first_month); it != _tiles.end() && it.key() <= last_month; ++it)
+	{
+		if (isCompleteMonth(it.key(), from, to))
+			grid.merge(it.value()[level]);
+	}
+
+	// Partial months at the ends of the range come from the rides of those months
+	if (!isCompleteMonth(first_month, from, to))
+		addRidesToGrid(from, std::min(to, lastDay(first_month)), grid);
+	if (last_month != first_month && !isCompleteMonth(last_month, from, to))
+		addRidesToGrid(firstDay(last_month), to, grid);
+}
+
+/****************************************/
+bool HeatMapPyramid::readFromFile()
+{
+	_rides.clear();
+	_dates.clear();
+	_tiles.clear();
+
+	QFile file(_log_directory + "/" + HEATMAP_PYRAMID_FILENAME);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	qint32 version, base_zoom, num_levels;
+	in >> magic >> version >> base_zoom >> num_levels;
+	if (magic != HEATMAP_PYRAMID_MAGIC || version != HEATMAP_PYRAMID_VERSION ||
+		base_zoom != _base_zoom || num_levels != _num_levels)
+		return false; // stale file, the rides will be added again
+
+	qint32 num_rides;
+	in >> num_rides;
+	for (int r=0; r < num_rides && in.status() == QDataStream::Ok; ++r)
+	{
+		QString filename;
+		RideCells ride;
+		qint32 num_cells;
+		in >> filename >> ride._date >> num_cells;
+
+		ride._cells.resize(std::max(0, (int)num_cells));
+		for (int i=0; i < num_cells; ++i)
+		{
+			qint32 x, y;
+			in >> x >> y;
+			ride._cells[i]._x = x;
+			ride._cells[i]._y = y;
+			ride._cells[i]._count = 1;
+		}
+		_rides.insert(filename, ride);
+		_dates.insert(ride._date, filename);
+	}
+
+	qint32 num_tiles;
+	in >> num_tiles;
+	for (int t=0; t < num_tiles && in.status() == QDataStream::Ok; ++t)
+	{
+		qint32 month_key;
+		in >> month_key;
+
+		std::vector<HeatMapGrid>& tile = _tiles[month_key];
+		for (int level=0; level < _num_levels; ++level)
+		{
+			tile.push_back(HeatMapGrid(_base_zoom - level));
+
+			qint32 num_cells;
+			in >> num_cells;
+			for (int i=0; i < num_cells; ++i)
+			{
+				qint32 x, y, count;
+				in >> x >> y >> count;
+				tile[level].addCount(x, y, count);
+			}
+		}
+	}
+
+	if (in.status() != QDataStream::Ok)
+	{
+		_rides.clear();
+		_dates.clear();
+		_tiles.clear();
+		return false;
+	}
+	return true;
+}
+
+/****************************************/
+void HeatMapPyramid::writeToFile() const
+{
+	// Replaces the store only once complete, so an interrupted write leaves the old store
+	QSaveFile file(_log_directory + "/" + HEATMAP_PYRAMID_FILENAME);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+
+	out << (quint32)HEATMAP_PYRAMID_MAGIC << (qint32)HEATMAP_PYRAMID_VERSION << (qint32)_base_zoom << (qint32)_num_levels;
+
+	out << (qint32)_rides.size();
+	for (QMap<QString, RideCells>::const_iterator it = _rides.begin(); it != _rides.end(); ++it)
+	{
+		const std::vector<HeatMapCell>& cells = it.value()._cells;
+		out << it.key() << it.value()._date << (qint32)cells.size();
+		for (unsigned int i=0; i < cells.size(); ++i)
+			out << (qint32)cells[i]._x << (qint32)cells[i]._y;
+	}
+
+	out << (qint32)_tiles.size();
+	for (QMap<int, std::vector<HeatMapGrid> >::const_iterator it = _tiles.begin(); it != _tiles.end(); ++it)
+	{
+		out << (qint32)it.key();
+		for (int level=0; level < _num_levels; ++level)
+		{
+			std::vector<HeatMapCell> cells;
+			it.value()[level].cells(cells);
+			out << (qint32)cells.size();
+			for (unsigned int i=0; i < cells.size(); ++i)
+				out << (qint32)cells[i]._x << (qint32)cells[i]._y << (qint32)cells[i]._count;
+		}
+	}
+
+	file.commit();
+}
\ No newline at end of file
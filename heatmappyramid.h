@@ -0,0 +1,76 @@
+#ifndef HEATMAPPYRAMID_H
+#define HEATMAPPYRAMID_H
+
+#include "heatmapgrid.h"
+
+#include <QString.h>
+#include <QDateTime.h>
+#include <QMap.h>
+
+#include <vector>
+
+#define HEATMAP_PYRAMID_LEVELS 4 // base zoom and 3 coarser zooms
+
+class DataLog;
+class LogDirectorySummary;
+
+/* Class to store the heat map of all the rides in a log directory, so the ride collage
+   does not need to parse the logs. For each ride the cells it passes through are kept, and
+   for each month the counts of all its rides are kept at every zoom level (a tile).
+   A date range query adds the tiles of the complete months and the rides of the partial
+   months at its ends. */
+
+class HeatMapPyramid
+ {
+ public:
+	HeatMapPyramid(const QString& log_directory, int base_zoom = HEATMAP_DEFAULT_ZOOM, int num_levels = HEATMAP_PYRAMID_LEVELS);
+	~HeatMapPyramid();
+
+	int baseZoom() const;
+	int numLevels() const;
+	int numRides() const;
+
+	bool contains(const QString& filename) const;
+
+	// Add a ride. The cells are at the base zoom, each ride is counted once per cell
+	void addRide(DataLog& data_log);
+	void addRide(const QString& filename, const QDate& date, const std::vector<HeatMapCell>& cells);
+	bool removeRideByName(const QString& filename);
+
+	// Remove the rides which are no longer in a summary (eg. replaced by a split or trim).
+	// Returns the number of rides removed
+	int removeMissingRides(const LogDirectorySummary& log_dir_summary);
+
+	// Accumulate the rides between from and to (inclusive) into grid. The zoom of grid must
+	// be one of the levels of the pyramid
+	void query(const QDate& from, const QDate& to, HeatMapGrid& grid) const;
+
+	bool readFromFile();
+	void writeToFile() const;
+
+ private:
+	struct RideCells
+	{
+		QDate _date;
+		std::vector<HeatMapCell> _cells; // at base zoom
+	};
+
+	static int monthKey(const QDate& date);
+
+	// Add the cells of a ride to grid, at the zoom of the grid
+	void addRideToGrid(const RideCells& ride, HeatMapGrid& grid) const;
+
+	// Add the rides between from and to (inclusive) to grid
+	void addRidesToGrid(const QDate& from, const QDate& to, HeatMapGrid& grid) const;
+	void rebuildTile(int month_key);
+
+	QString _log_directory;
+	int _base_zoom;
+	int _num_levels;
+
+	QMap<QString, RideCells> _rides; // key=filename
+	QMultiMap<QDate, QString> _dates; // rides by date
+	QMap<int, std::vector<HeatMapGrid> > _tiles; // key=month, one grid per level
+ };
+
+#endif // HEATMAPPYRAMID_H
\ No newline at end of file
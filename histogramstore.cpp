@@ -0,0 +1,208 @@
+#include "histogramstore.h"
+#include "datalog.h"
+#include "logdirectorysummary.h"
+
+#include <QFile.h>
+#include <QSaveFile.h>
+#include <QDataStream.h>
+
+#define HISTOGRAM_STORE_FILENAME "histograms.dat"
+#define HISTOGRAM_STORE_MAGIC 0x48495354 // "HIST"
+#define HISTOGRAM_STORE_VERSION 1
+
+/****************************************/
+HistogramStore::HistogramStore(const QString& log_directory):
+_log_directory(log_directory)
+{}
+
+/****************************************/
+HistogramStore::~HistogramStore()
+{}
+
+/****************************************/
+int HistogramStore::numRides() const
+{
+	return _rides.size();
+}
+
+/****************************************/
+bool HistogramStore::contains(const QString& filename) const
+{
+	return _rides.contains(filename);
+}
+
+/****************************************/
+void HistogramStore::addRide(DataLog& data_log)
+{
+	ChannelHistograms histograms;
+	histograms.addRide(data_log);
+	addRide(data_log.filename(), data_log.date().date(), histograms);
+}
+
+/****************************************/
+void HistogramStore::addRide(const QString& filename, const QDate& date, const ChannelHistograms& histograms)
+{
+	removeRideByName(filename);
+
+	RideHistograms ride;
+	ride._date = date;
+	ride._histograms = histograms;
+	_rides.insert(filename, ride);
+	_dates.insert(date, filename);
+}
+
+/****************************************/
+bool HistogramStore::removeRideByName(const QString& filename)
+{
+	QMap<QString, RideHistograms>::iterator it = _rides.find(filename);
+	if (it == _rides.end())
+		return false;
+
+	_dates.remove(it.value()._date, filename);
+	_rides.erase(it);
+	return true;
+}
+
+/****************************************/
+int HistogramStore::removeMissingRides(const LogDirectorySummary& log_dir_summary)
+{
+	int num_removed = 0;
+	QMap<QString, RideHistograms>::iterator it = _rides.begin();
+	while (it != _rides.end())
+	{
+		if (log_dir_summary.indexOf(it.key()) < 0)
+		{
+			_dates.remove(it.value()._date, it.key());
+			it = _rides.erase(it);
+			++num_removed;
+		}
+		else
+		{
+			++it;
+		}
+	}
+	return num_removed;
+}
+
+/****************************************/
+void HistogramStore::query(const QDate& from, const QDate& to, ChannelHistograms& histograms) const
+{
+	for (QMultiMap<QDate, QString>::const_iterator it = _dates.lowerBound(from); it != _dates.end() && it.key() <= to; ++it)
+	{
+		QMap<QString, RideHistograms>::const_iterator ride = _rides.find(it.value());
+		if (ride != _rides.end())
+			histograms.merge(ride.value()._histograms);
+	}
+}
+
+/****************************************/
+bool HistogramStore::readFromFile()
+{
+	_rides.clear();
+	_dates.clear();
+
+	QFile file(_log_directory + "/" + HISTOGRAM_STORE_FILENAME);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	qint32 version;
+	in >> magic >> version;
+	if (magic != HISTOGRAM_STORE_MAGIC || version != HISTOGRAM_STORE_VERSION)
+		return false; // stale file, the rides will be added again
+
+	// The bin layout is saved so a change of bins also makes the file stale
+	for (int c=0; c < NUM_HISTOGRAM_CHANNELS; ++c)
+	{
+		const HistogramChannel channel = (HistogramChannel)c;
+		qint32 num_bins;
+		double bin_min, bin_width;
+		in >> num_bins >> bin_min >> bin_width;
+		if (num_bins != ChannelHistograms::numBins(channel) ||
+			bin_min != ChannelHistograms::binMin(channel) ||
+			bin_width != ChannelHistograms::binWidth(channel))
+			return false;
+	}
+
+	qint32 num_rides;
+	in >> num_rides;
+	for (int r=0; r < num_rides && in.status() == QDataStream::Ok; ++r)
+	{
+		QString filename;
+		RideHistograms ride;
+		in >> filename >> ride._date;
+
+		// Only the bins with time are saved
+		for (int c=0; c < NUM_HISTOGRAM_CHANNELS; ++c)
+		{
+			std::vector<double>& bins = ride._histograms.bins((HistogramChannel)c);
+			qint32 num_used;
+			in >> num_used;
+			for (int i=0; i < num_used; ++i)
+			{
+				qint32 bin;
+				double time;
+				in >> bin >> time;
+				if (bin >= 0 && bin < (int)bins.size())
+					bins[bin] = time;
+			}
+		}
+
+		_rides.insert(filename, ride);
+		_dates.insert(ride._date, filename);
+	}
+
+	if (in.status() != QDataStream::Ok)
+	{
+		_rides.clear();
+		_dates.clear();
+		return false;
+	}
+	return true;
+}
+
+/****************************************/
+void HistogramStore::writeToFile() const
+{
+	QSaveFile file(_log_directory + "/" + HISTOGRAM_STORE_FILENAME);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+
+	out << (quint32)HISTOGRAM_STORE_MAGIC << (qint32)HISTOGRAM_STORE_VERSION;
+	for (int c=0; c < NUM_HISTOGRAM_CHANNELS; ++c)
+	{
+		const HistogramChannel channel = (HistogramChannel)c;
+		out << (qint32)ChannelHistograms::numBins(channel) << ChannelHistograms::binMin(channel) << ChannelHistograms::binWidth(channel);
+	}
+
+	out << (qint32)_rides.size();
+	for (QMap<QString, RideHistograms>::const_iterator it = _rides.begin(); it != _rides.end(); ++it)
+	{
+		out << it.key() << it.value()._date;
+		for (int c=0; c < NUM_HISTOGRAM_CHANNELS; ++c)
+		{
+			const std::vector<double>& bins = it.value()._histograms.bins((HistogramChannel)c);
+			qint32 num_used = 0;
+			for (unsigned int b=0; b < bins.size(); ++b)
+			{
+				if (bins[b] > 0.0)
+					++num_used;
+			}
+
+			out << num_used;
+			for (unsigned int b=0; b < bins.size(); ++b)
+			{
+				if (bins[b] > 0.0)
+					out << (qint32)b << bins[b];
+			}
+		}
+	}
+
+	file.commit();
+}
\ No newline at end of file
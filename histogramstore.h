@@ -0,0 +1,54 @@
+#ifndef HISTOGRAMSTORE_H
+#define HISTOGRAMSTORE_H
+
+#include "channelhistograms.h"
+
+#include <QString.h>
+#include <QDateTime.h>
+#include <QMap.h>
+
+class DataLog;
+class LogDirectorySummary;
+
+/* Class to store the channel histograms of all the rides in a log directory, so the
+   distribution of a channel over a date range is found without parsing the logs.
+   The histograms of a ride are computed once when it is added, and a date range query
+   adds the histograms of the rides in the range. */
+
+class HistogramStore
+ {
+ public:
+	HistogramStore(const QString& log_directory);
+	~HistogramStore();
+
+	int numRides() const;
+	bool contains(const QString& filename) const;
+
+	// Add a ride, replacing any ride with the same filename
+	void addRide(DataLog& data_log);
+	void addRide(const QString& filename, const QDate& date, const ChannelHistograms& histograms);
+	bool removeRideByName(const QString& filename);
+
+	// Remove the rides which are no longer in a summary. Returns the number of rides removed
+	int removeMissingRides(const LogDirectorySummary& log_dir_summary);
+
+	// Add the histograms of the rides between from and to (inclusive) to histograms
+	void query(const QDate& from, const QDate& to, ChannelHistograms& histograms) const;
+
+	bool readFromFile();
+	void writeToFile() const;
+
+ private:
+	struct RideHistograms
+	{
+		QDate _date;
+		ChannelHistograms _histograms;
+	};
+
+	QString _log_directory;
+
+	QMap<QString, RideHistograms> _rides; // key=filename
+	QMultiMap<QDate, QString> _dates; // rides by date
+ };
+
+#endif // HISTOGRAMSTORE_H
\ No newline at end of file
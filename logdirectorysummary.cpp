@@ -1,17 +1,206 @@
 #include "logdirectorysummary.h"
 #include "datalog.h"
+#include "dataprocessing.h"
+#include "routeindex.h"
+#include "uniformlog.h"
+#include "user.h"
 
 #include <cassert>
 #include <fstream>
+#include <algorithm>
 
 #include <qtxml/qdomdocument>
 #include <QFile.h>
+#include <QSaveFile.h>
+#include <QDataStream.h>
 
 #define LOG_SUMMARY_FILENAME "logsummary.xml"
+#define LOG_INDEX_FILENAME "logsummary.idx"
+#define LOG_INDEX_MAGIC 0x4c53554d // "LSUM"
+#define LOG_INDEX_VERSION 1
+#define LOG_INDEX_HEADER_SIZE 16 // bytes
+#define LOG_INDEX_RECORD_SIZE 1024 // bytes
+#define LOG_INDEX_FILENAME_SIZE 320 // bytes of utf8 filename in a record, including the terminating 0. Longer filenames are in NAME records
+#define LOG_INDEX_NAME_BYTES (LOG_INDEX_RECORD_SIZE - 8) // bytes of utf8 filename in a NAME record
+#define LOG_INDEX_DATE_SIZE 24 // bytes of date string in a record, including the terminating 0
+#define LOG_INDEX_LAPS_PER_RECORD 4
+#define LOG_INDEX_COMPACT_MIN 64 // records which may be wasted before compacting
+
+// Record types
+#define LOG_RECORD_ADD 1 // a log, followed by LAPS records
+#define LOG_RECORD_LAPS 2 // laps of the preceding log
+#define LOG_RECORD_REMOVE 3 // removes the log of a filename
+#define LOG_RECORD_NAME 4 // part of a filename too long for the ADD or REMOVE record which follows
+
+/****************************************/
+// Write a string to a fixed size, 0 padded field. The string must fit, including the terminating 0
+static void writeFixedString(QDataStream& out, const QString& str, int size)
+{
+	const QByteArray bytes = str.toUtf8();
+	assert(bytes.size() < size);
+	out.writeRawData(bytes.constData(), bytes.size());
+	out.writeRawData(QByteArray(size - bytes.size(), '\0').constData(), size - bytes.size());
+}
+
+/****************************************/
+// Read a string from a fixed size, 0 padded field
+static QString readFixedString(QDataStream& in, int size)
+{
+	QByteArray bytes(size, '\0');
+	in.readRawData(bytes.data(), size);
+	return QString::fromUtf8(bytes.constData()); // up to the first 0
+}
+
+/****************************************/
+// Write aggregates to an index record
+static void writeAggregates(QDataStream& out, const RideAggregates& aggregates)
+{
+	out << aggregates._elevation_gain << aggregates._elevation_loss
+		<< aggregates._avg_speed << aggregates._max_speed
+		<< aggregates._avg_heart_rate << aggregates._max_heart_rate
+		<< aggregates._avg_cadence << aggregates._max_cadence
+		<< aggregates._avg_power << aggregates._max_power
+		<< aggregates._avg_gradient << aggregates._max_gradient
+		<< aggregates._avg_temp << aggregates._max_temp;
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		out << aggregates._hr_zone_time[z];
+	out << aggregates._energy
+		<< aggregates._min_ltd << aggregates._max_ltd << aggregates._min_lgd << aggregates._max_lgd
+		<< (quint32)aggregates._valid_channels;
+}
+
+/****************************************/
+// Read aggregates from an index record
+static void readAggregates(QDataStream& in, RideAggregates& aggregates)
+{
+	in >> aggregates._elevation_gain >> aggregates._elevation_loss
+		>> aggregates._avg_speed >> aggregates._max_speed
+		>> aggregates._avg_heart_rate >> aggregates._max_heart_rate
+		>> aggregates._avg_cadence >> aggregates._max_cadence
+		>> aggregates._avg_power >> aggregates._max_power
+		>> aggregates._avg_gradient >> aggregates._max_gradient
+		>> aggregates._avg_temp >> aggregates._max_temp;
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		in >> aggregates._hr_zone_time[z];
+	quint32 valid_channels;
+	in >> aggregates._energy
+		>> aggregates._min_ltd >> aggregates._max_ltd >> aggregates._min_lgd >> aggregates._max_lgd
+		>> valid_channels;
+	aggregates._valid_channels = valid_channels;
+}
+
+/****************************************/
+// Write aggregates as attributes of an xml element
+static void writeAggregates(QDomElement& element, const RideAggregates& aggregates)
+{
+	element.setAttribute("ElevationGain", QString::number(aggregates._elevation_gain,'f',1));
+	element.setAttribute("ElevationLoss", QString::number(aggregates._elevation_loss,'f',1));
+	element.setAttribute("AvgSpeed", QString::number(aggregates._avg_speed,'f',2));
+	element.setAttribute("MaxSpeed", QString::number(aggregates._max_speed,'f',2));
+	element.setAttribute("AvgHeartRate", QString::number(aggregates._avg_heart_rate,'f',1));
+	element.setAttribute("MaxHeartRate", QString::number(aggregates._max_heart_rate,'f',1));
+	element.setAttribute("AvgCadence", QString::number(aggregates._avg_cadence,'f',1));
+	element.setAttribute("MaxCadence", QString::number(aggregates._max_cadence,'f',1));
+	element.setAttribute("AvgPower", QString::number(aggregates._avg_power,'f',1));
+	element.setAttribute("MaxPower", QString::number(aggregates._max_power,'f',1));
+	element.setAttribute("AvgGradient", QString::number(aggregates._avg_gradient,'f',2));
+	element.setAttribute("MaxGradient", QString::number(aggregates._max_gradient,'f',2));
+	element.setAttribute("AvgTemp", QString::number(aggregates._avg_temp,'f',1));
+	element.setAttribute("MaxTemp", QString::number(aggregates._max_temp,'f',1));
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		element.setAttribute("HRZone" + QString::number(z+1), QString::number(aggregates._hr_zone_time[z],'f',1));
+	element.setAttribute("Energy", QString::number(aggregates._energy,'f',1));
+	element.setAttribute("MinLatitude", QString::number(aggregates._min_ltd,'f',6));
+	element.setAttribute("MaxLatitude", QString::number(aggregates._max_ltd,'f',6));
+	element.setAttribute("MinLongitude", QString::number(aggregates._min_lgd,'f',6));
+	element.setAttribute("MaxLongitude", QString::number(aggregates._max_lgd,'f',6));
+	element.setAttribute("ValidChannels", QString::number(aggregates._valid_channels));
+}
+
+/****************************************/
+// Read aggregates from the attributes of an xml element
+static void readAggregates(const QDomElement& element, RideAggregates& aggregates)
+{
+	if (element.isNull())
+		return;
+
+	aggregates._elevation_gain = element.attribute("ElevationGain").toDouble();
+	aggregates._elevation_loss = element.attribute("ElevationLoss").toDouble();
+	aggregates._avg_speed = element.attribute("AvgSpeed").toDouble();
+	aggregates._max_speed = element.attribute("MaxSpeed").toDouble();
+	aggregates._avg_heart_rate = element.attribute("AvgHeartRate").toDouble();
+	aggregates._max_heart_rate = element.attribute("MaxHeartRate").toDouble();
+	aggregates._avg_cadence = element.attribute("AvgCadence").toDouble();
+	aggregates._max_cadence = element.attribute("MaxCadence").toDouble();
+	aggregates._avg_power = element.attribute("AvgPower").toDouble();
+	aggregates._max_power = element.attribute("MaxPower").toDouble();
+	aggregates._avg_gradient = element.attribute("AvgGradient").toDouble();
+	aggregates._max_gradient = element.attribute("MaxGradient").toDouble();
+	aggregates._avg_temp = element.attribute("AvgTemp").toDouble();
+	aggregates._max_temp = element.attribute("MaxTemp").toDouble();
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		aggregates._hr_zone_time[z] = element.attribute("HRZone" + QString::number(z+1)).toDouble();
+	aggregates._energy = element.attribute("Energy").toDouble();
+	aggregates._min_ltd = element.attribute("MinLatitude").toDouble();
+	aggregates._max_ltd = element.attribute("MaxLatitude").toDouble();
+	aggregates._min_lgd = element.attribute("MinLongitude").toDouble();
+	aggregates._max_lgd = element.attribute("MaxLongitude").toDouble();
+	aggregates._valid_channels = element.attribute("ValidChannels").toUInt();
+}
+
+/****************************************/
+RideAggregates::RideAggregates():
+_elevation_gain(0.0),
+_elevation_loss(0.0),
+_avg_speed(0.0),
+_max_speed(0.0),
+_avg_heart_rate(0.0),
+_max_heart_rate(0.0),
+_avg_cadence(0.0),
+_max_cadence(0.0),
+_avg_power(0.0),
+_max_power(0.0),
+_avg_gradient(0.0),
+_max_gradient(0.0),
+_avg_temp(0.0),
+_max_temp(0.0),
+_energy(0.0),
+_min_ltd(0.0),
+_max_ltd(0.0),
+_min_lgd(0.0),
+_max_lgd(0.0),
+_valid_channels(0)
+{
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		_hr_zone_time[z] = 0.0;
+}
+
+/****************************************/
+// Compare logs by timestamp
+static bool logBefore(const LogSummary& log_summary, qint64 timestamp)
+{
+	return log_summary._timestamp < timestamp;
+}
+
+/****************************************/
+static bool logAfter(qint64 timestamp, const LogSummary& log_summary)
+{
+	return timestamp < log_summary._timestamp;
+}
+
+/****************************************/
+// Timestamp of the start of a day
+static qint64 dayTimestamp(const QDate& date)
+{
+	return date.toJulianDay()*86400;
+}
 
 /****************************************/
 LogDirectorySummary::LogDirectorySummary(const QString& log_directory):
-_log_directory(log_directory)
+_log_directory(log_directory),
+_num_index_records(0),
+_rewrite_index(true),
+_hr_zones_hash(0)
 {}
 
 /****************************************/
@@ -40,32 +229,400 @@ int LogDirectorySummary::numLogs() const
 }
 
 /****************************************/
-void LogDirectorySummary::addLog(const LogSummary& log_summary)
+void LogDirectorySummary::setTimestamp(LogSummary& log_summary)
+{
+	const QDateTime date_time = QDateTime::fromString(log_summary._date, "yyyy-MM-dd hh:mm:ss");
+	log_summary._day = date_time.date();
+	log_summary._timestamp = dayTimestamp(date_time.date()) + date_time.time().msecsSinceStartOfDay()/1000;
+}
+
+/****************************************/
+int LogDirectorySummary::addLog(const LogSummary& log_summary)
+{
+	// A filename has one log
+	const int existing = indexOf(log_summary._filename);
+	if (existing >= 0)
+		_logs.erase(_logs.begin() + existing);
+
+	// Logs mostly arrive in date order, so this is usually an append
+	std::vector<LogSummary>::iterator it = std::upper_bound(_logs.begin(), _logs.end(), log_summary._timestamp, logAfter);
+	it = _logs.insert(it, log_summary);
+	_timestamps.insert(it->_filename, it->_timestamp);
+	return it - _logs.begin();
+}
+
+/****************************************/
+int LogDirectorySummary::indexOf(const QString& filename) const
+{
+	QHash<QString, qint64>::const_iterator ts = _timestamps.find(filename);
+	if (ts == _timestamps.end())
+		return -1;
+
+	// Search the logs with the same timestamp
+	std::vector<LogSummary>::const_iterator it = std::lower_bound(_logs.begin(), _logs.end(), ts.value(), logBefore);
+	for (; it != _logs.end() && it->_timestamp == ts.value(); ++it)
+	{
+		if (it->_filename == filename)
+			return it - _logs.begin();
+	}
+	return -1;
+}
+
+/****************************************/
+QStringList LogDirectorySummary::logsToUpdate(const User& user) const
+{
+	const bool zones_changed = (_hr_zones_hash != hrZonesHash(user));
+
+	QStringList filenames;
+	for (unsigned int i=0; i < _logs.size(); ++i)
+	{
+		const unsigned int valid_channels = _logs[i]._aggregates._valid_channels;
+		if (valid_channels == 0 || ((valid_channels & CHANNEL_GPS) && _logs[i]._route_signature.empty()) ||
+			(zones_changed && (valid_channels & CHANNEL_HEART_RATE)))
+			filenames << _logs[i]._filename;
+	}
+	return filenames;
+}
+
+/****************************************/
+void LogDirectorySummary::setHrZones(const User& user)
+{
+	const quint32 hr_zones_hash = hrZonesHash(user);
+	if (hr_zones_hash != _hr_zones_hash)
+	{
+		_hr_zones_hash = hr_zones_hash;
+		_rewrite_index = true; // the hash is in the header
+	}
+}
+
+/****************************************/
+quint32 LogDirectorySummary::hrZonesHash(const User& user)
 {
-	_logs.push_back(log_summary);
+	const int zones[NUM_HR_ZONES] = {user.zone1(), user.zone2(), user.zone3(), user.zone4(), user.zone5()};
+	quint32 hash = 2166136261u; // FNV-1a
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		hash = (hash ^ (quint32)zones[z])*16777619u;
+	return hash;
+}
+
+/****************************************/
+std::pair<int, int> LogDirectorySummary::logsInRange(const QDate& min_date, const QDate& max_date) const
+{
+	const int first = std::lower_bound(_logs.begin(), _logs.end(), dayTimestamp(min_date), logBefore) - _logs.begin();
+	const int last = std::lower_bound(_logs.begin(), _logs.end(), dayTimestamp(max_date.addDays(1)), logBefore) - _logs.begin();
+	return std::make_pair(first, std::max(first, last));
 }
 
 /****************************************/
 bool LogDirectorySummary::removeLogByName(const QString& filename)
 {
-	bool removed = false;
-	for (std::vector<LogSummary>::iterator it=_logs.begin(); it != _logs.end(); ++it)
+	const int idx = indexOf(filename);
+	if (idx < 0)
+		return false;
+
+	JournalEntry entry;
+	entry._removed = true;
+	entry._log = _logs[idx];
+	_journal.push_back(entry);
+
+	_logs.erase(_logs.begin() + idx);
+	_timestamps.remove(filename);
+	return true;
+}
+
+/****************************************/
+void LogDirectorySummary::readFromFile()
+{
+	_logs.clear();
+	_timestamps.clear();
+	_journal.clear();
+	_num_index_records = 0;
+
+	if (!readIndex())
+	{
+		// No index yet (or one in another format), so import the xml summary. The index is written with the next writeToFile
+		_logs.clear();
+		_timestamps.clear();
+		importFromXml(_log_directory + "/" + LOG_SUMMARY_FILENAME);
+		_rewrite_index = true;
+		_hr_zones_hash = 0;
+	}
+}
+
+/****************************************/
+void LogDirectorySummary::writeToFile()
+{
+	// Compact the index when more of it is removed logs than current logs
+	int num_records = 0;
+	for (unsigned int i=0; i < _logs.size(); ++i)
+		num_records += numRecords(_logs[i], false);
+	int num_journal_records = 0;
+	for (unsigned int i=0; i < _journal.size(); ++i)
+		num_journal_records += numRecords(_journal[i]._log, _journal[i]._removed);
+	const bool compact = _num_index_records + num_journal_records > 2*num_records + LOG_INDEX_COMPACT_MIN;
+
+	if (_rewrite_index || compact)
+		writeIndex();
+	else if (!_journal.empty())
+		appendToIndex();
+	_journal.clear();
+}
+
+/****************************************/
+int LogDirectorySummary::numRecords(const LogSummary& log_summary, bool removed) const
+{
+	bool relative;
+	const int name_size = indexFilename(log_summary._filename, relative).toUtf8().size();
+	const int num_name_records = (name_size < LOG_INDEX_FILENAME_SIZE) ? 0 : (name_size + LOG_INDEX_NAME_BYTES - 1)/LOG_INDEX_NAME_BYTES;
+	if (removed)
+		return num_name_records + 1;
+	return num_name_records + 1 + (log_summary._laps.size() + LOG_INDEX_LAPS_PER_RECORD - 1)/LOG_INDEX_LAPS_PER_RECORD;
+}
+
+/****************************************/
+QString LogDirectorySummary::indexFilename(const QString& filename, bool& relative) const
+{
+	// Filenames are relative to the log directory where possible, so they fit the record
+	const QString prefix = _log_directory + "/";
+	relative = filename.startsWith(prefix);
+	return relative ? filename.mid(prefix.size()) : filename;
+}
+
+/****************************************/
+bool LogDirectorySummary::readIndex()
+{
+	QFile file(_log_directory + "/" + LOG_INDEX_FILENAME);
+	if (!file.open(QIODevice::ReadOnly) || file.size() < LOG_INDEX_HEADER_SIZE)
+		return false;
+
+	// Map the whole file rather than reading it (fall back to reading if the map fails)
+	QByteArray contents;
+	uchar* mapped = file.map(0, file.size());
+	if (mapped)
+		contents = QByteArray::fromRawData((const char*)mapped, file.size());
+	else
+		contents = file.readAll();
+
+	QDataStream header(contents);
+	header.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, hr_zones_hash;
+	qint32 version, record_size;
+	header >> magic >> version >> record_size >> hr_zones_hash;
+	if (magic != LOG_INDEX_MAGIC || version != LOG_INDEX_VERSION || record_size != LOG_INDEX_RECORD_SIZE)
+	{
+		if (mapped)
+			file.unmap(mapped);
+		return false;
+	}
+
+	// Replay the records. A partly written record at the end is ignored
+	const int num_records = (contents.size() - LOG_INDEX_HEADER_SIZE)/LOG_INDEX_RECORD_SIZE;
+	LogSummary* log_summary = 0;
+	int num_laps_to_read = 0;
+	QByteArray long_filename; // from the NAME records before an ADD or REMOVE record
+	for (int r=0; r < num_records; ++r)
+	{
+		QDataStream in(QByteArray::fromRawData(contents.constData() + LOG_INDEX_HEADER_SIZE + r*LOG_INDEX_RECORD_SIZE, LOG_INDEX_RECORD_SIZE));
+		in.setVersion(QDataStream::Qt_5_0);
+
+		qint32 type, count;
+		in >> type >> count;
+		if (type == LOG_RECORD_ADD)
+		{
+			qint32 relative;
+			LogSummary new_log;
+			in >> relative;
+			new_log._filename = readFixedString(in, LOG_INDEX_FILENAME_SIZE);
+			if (!long_filename.isEmpty())
+				new_log._filename = QString::fromUtf8(long_filename);
+			long_filename.clear();
+			if (relative)
+				new_log._filename = _log_directory + "/" + new_log._filename;
+			new_log._date = readFixedString(in, LOG_INDEX_DATE_SIZE);
+			in >> new_log._time >> new_log._dist;
+
+			qint32 signature_size;
+			in >> signature_size;
+			for (int i=0; i < signature_size && i < ROUTE_SIGNATURE_SIZE; ++i)
+			{
+				quint32 value;
+				in >> value;
+				new_log._route_signature.push_back(value);
+			}
+			for (int i=signature_size; i < ROUTE_SIGNATURE_SIZE; ++i)
+			{
+				quint32 value;
+				in >> value; // unused signature space
+			}
+			readAggregates(in, new_log._aggregates);
+
+			setTimestamp(new_log);
+			log_summary = &_logs[addLog(new_log)];
+			num_laps_to_read = count;
+		}
+		else if (type == LOG_RECORD_LAPS && log_summary)
+		{
+			for (int i=0; i < count && num_laps_to_read > 0; ++i, --num_laps_to_read)
+			{
+				LapSummary lap_summary;
+				in >> lap_summary._time >> lap_summary._dist;
+				readAggregates(in, lap_summary._aggregates);
+				log_summary->_laps.push_back(lap_summary);
+			}
+		}
+		else if (type == LOG_RECORD_REMOVE)
+		{
+			qint32 relative;
+			in >> relative;
+			QString filename = readFixedString(in, LOG_INDEX_FILENAME_SIZE);
+			if (!long_filename.isEmpty())
+				filename = QString::fromUtf8(long_filename);
+			long_filename.clear();
+			if (relative)
+				filename = _log_directory + "/" + filename;
+			log_summary = 0;
+			removeLogByName(filename);
+		}
+		else if (type == LOG_RECORD_NAME)
+		{
+			QByteArray part(std::min(std::max((int)count, 0), LOG_INDEX_NAME_BYTES), '\0');
+			in.readRawData(part.data(), part.size());
+			long_filename.append(part);
+		}
+	}
+	_num_index_records = num_records;
+	_journal.clear(); // replaying removes adds to the journal
+	_hr_zones_hash = hr_zones_hash;
+	_rewrite_index = false;
+
+	if (mapped)
+		file.unmap(mapped);
+	return true;
+}
+
+/****************************************/
+void LogDirectorySummary::writeRecords(QDataStream& out, const JournalEntry& entry) const
+{
+	bool relative;
+	const QString filename = indexFilename(entry._log._filename, relative);
+
+	// A filename too long for the record goes in NAME records before it, and the record has an empty filename
+	const QByteArray filename_utf8 = filename.toUtf8();
+	const bool long_filename = (filename_utf8.size() >= LOG_INDEX_FILENAME_SIZE);
+	for (int first=0; long_filename && first < filename_utf8.size(); first += LOG_INDEX_NAME_BYTES)
 	{
-		if (it->_filename.compare(filename) == 0) // are equal
+		const int count = std::min(filename_utf8.size() - first, LOG_INDEX_NAME_BYTES);
+		QByteArray name_record;
+		QDataStream name_out(&name_record, QIODevice::WriteOnly);
+		name_out.setVersion(QDataStream::Qt_5_0);
+		name_out << (qint32)LOG_RECORD_NAME << (qint32)count;
+		name_out.writeRawData(filename_utf8.constData() + first, count);
+		name_record.append(QByteArray(LOG_INDEX_RECORD_SIZE - name_record.size(), '\0'));
+		out.writeRawData(name_record.constData(), LOG_INDEX_RECORD_SIZE);
+	}
+	const QString record_filename = long_filename ? QString() : filename;
+
+	QByteArray record;
+	QDataStream record_out(&record, QIODevice::WriteOnly);
+	record_out.setVersion(QDataStream::Qt_5_0);
+
+	if (entry._removed)
+	{
+		record_out << (qint32)LOG_RECORD_REMOVE << (qint32)0 << (qint32)relative;
+		writeFixedString(record_out, record_filename, LOG_INDEX_FILENAME_SIZE);
+		record.append(QByteArray(LOG_INDEX_RECORD_SIZE - record.size(), '\0'));
+		out.writeRawData(record.constData(), LOG_INDEX_RECORD_SIZE);
+		return;
+	}
+
+	const LogSummary& log_summary = entry._log;
+	record_out << (qint32)LOG_RECORD_ADD << (qint32)log_summary._laps.size() << (qint32)relative;
+	writeFixedString(record_out, record_filename, LOG_INDEX_FILENAME_SIZE);
+	writeFixedString(record_out, log_summary._date, LOG_INDEX_DATE_SIZE);
+	record_out << log_summary._time << log_summary._dist;
+	record_out << (qint32)log_summary._route_signature.size();
+	for (unsigned int i=0; i < ROUTE_SIGNATURE_SIZE; ++i)
+		record_out << (quint32)(i < log_summary._route_signature.size() ? log_summary._route_signature[i] : 0);
+	writeAggregates(record_out, log_summary._aggregates);
+	assert(record.size() <= LOG_INDEX_RECORD_SIZE);
+	record.append(QByteArray(LOG_INDEX_RECORD_SIZE - record.size(), '\0'));
+	out.writeRawData(record.constData(), LOG_INDEX_RECORD_SIZE);
+
+	for (unsigned int first=0; first < log_summary._laps.size(); first += LOG_INDEX_LAPS_PER_RECORD)
+	{
+		const int count = std::min((int)log_summary._laps.size() - (int)first, LOG_INDEX_LAPS_PER_RECORD);
+		QByteArray laps_record;
+		QDataStream laps_out(&laps_record, QIODevice::WriteOnly);
+		laps_out.setVersion(QDataStream::Qt_5_0);
+		laps_out << (qint32)LOG_RECORD_LAPS << (qint32)count;
+		for (int i=0; i < count; ++i)
 		{
-			it = _logs.erase(it);
-			removed = true;
-			break;
+			laps_out << log_summary._laps[first+i]._time << log_summary._laps[first+i]._dist;
+			writeAggregates(laps_out, log_summary._laps[first+i]._aggregates);
 		}
+		assert(laps_record.size() <= LOG_INDEX_RECORD_SIZE);
+		laps_record.append(QByteArray(LOG_INDEX_RECORD_SIZE - laps_record.size(), '\0'));
+		out.writeRawData(laps_record.constData(), LOG_INDEX_RECORD_SIZE);
 	}
-	return removed;
 }
 
 /****************************************/
-void LogDirectorySummary::readFromFile()
+void LogDirectorySummary::writeIndex()
+{
+	// Write to a temporary file which replaces the index once complete
+	QSaveFile file(_log_directory + "/" + LOG_INDEX_FILENAME);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << (quint32)LOG_INDEX_MAGIC << (qint32)LOG_INDEX_VERSION << (qint32)LOG_INDEX_RECORD_SIZE << _hr_zones_hash;
+
+	_num_index_records = 0;
+	for (unsigned int i=0; i < _logs.size(); ++i)
+	{
+		JournalEntry entry;
+		entry._removed = false;
+		entry._log = _logs[i];
+		writeRecords(out, entry);
+		_num_index_records += numRecords(_logs[i], false);
+	}
+
+	if (file.commit())
+		_rewrite_index = false;
+}
+
+/****************************************/
+void LogDirectorySummary::appendToIndex()
 {
-	const QString filename = _log_directory + "/" + LOG_SUMMARY_FILENAME;
+	QFile file(_log_directory + "/" + LOG_INDEX_FILENAME);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+		return;
+
+	if (file.size() < LOG_INDEX_HEADER_SIZE) // the index has gone
+	{
+		file.close();
+		writeIndex();
+		return;
+	}
+
+	// Drop a partly written record at the end (eg. if a previous write was interrupted)
+	const qint64 num_records = (file.size() - LOG_INDEX_HEADER_SIZE)/LOG_INDEX_RECORD_SIZE;
+	file.resize(LOG_INDEX_HEADER_SIZE + num_records*LOG_INDEX_RECORD_SIZE);
+	file.seek(file.size());
 
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	for (unsigned int i=0; i < _journal.size(); ++i)
+	{
+		writeRecords(out, _journal[i]);
+		_num_index_records += numRecords(_journal[i]._log, _journal[i]._removed);
+	}
+}
+
+/****************************************/
+bool LogDirectorySummary::importFromXml(const QString& filename)
+{
 	QDomDocument dom_document;
 	QString error_msg;
 	int error_line, error_column;
@@ -91,22 +648,29 @@ void LogDirectorySummary::readFromFile()
 				LapSummary lap_summary;
 				lap_summary._time = lap.firstChildElement("Time").firstChild().nodeValue().toDouble();
 				lap_summary._dist = lap.firstChildElement("Distance").firstChild().nodeValue().toDouble();
+				readAggregates(lap.firstChildElement("Aggregates"), lap_summary._aggregates);
 				log_summary._laps.push_back(lap_summary);
 				
 				lap = lap.nextSibling();
 			}
+
+			readAggregates(log.firstChildElement("Aggregates"), log_summary._aggregates);
+
+			const QStringList route_signature = log.firstChildElement("RouteSignature").firstChild().nodeValue().split(' ', QString::SkipEmptyParts);
+			for (int i=0; i < route_signature.size(); ++i)
+				log_summary._route_signature.push_back(route_signature[i].toUInt(0, 16));
 			
+			setTimestamp(log_summary);
 			addLog(log_summary);
 			log = log.nextSibling();
 		}
 	}
+	return read_success;
 }
 
 /****************************************/
-void LogDirectorySummary::writeToFile() const
+void LogDirectorySummary::exportToXml(const QString& filename) const
 {
-	const QString filename = _log_directory + "/" LOG_SUMMARY_FILENAME;
-
 	QDomDocument dom_document;
 	QDomElement doc = dom_document.createElement("LogSummary");
 	dom_document.appendChild(doc);
@@ -136,6 +700,10 @@ void LogDirectorySummary::writeToFile() const
 		text = dom_document.createTextNode(QString::number(_logs[i]._dist,'f',2));
 		dist.appendChild(text);
 
+		QDomElement aggregates = dom_document.createElement("Aggregates");
+		log.appendChild(aggregates);
+		writeAggregates(aggregates, _logs[i]._aggregates);
+
 		QDomElement laps = dom_document.createElement("Laps");
 		log.appendChild(laps);
 
@@ -158,6 +726,22 @@ void LogDirectorySummary::writeToFile() const
 			lap.appendChild(dist);
 			text = dom_document.createTextNode(QString::number(_logs[i]._laps[j]._dist,'f',2));
 			dist.appendChild(text);
+
+			QDomElement lap_aggregates = dom_document.createElement("Aggregates");
+			lap.appendChild(lap_aggregates);
+			writeAggregates(lap_aggregates, _logs[i]._laps[j]._aggregates);
+		}
+
+		if (!_logs[i]._route_signature.empty())
+		{
+			QStringList values;
+			for (unsigned int j=0; j < _logs[i]._route_signature.size(); ++j)
+				values << QString::number(_logs[i]._route_signature[j], 16);
+
+			QDomElement route_signature = dom_document.createElement("RouteSignature");
+			log.appendChild(route_signature);
+			text = dom_document.createTextNode(values.join(" "));
+			route_signature.appendChild(text);
 		}
 	}
 
@@ -170,7 +754,7 @@ void LogDirectorySummary::writeToFile() const
 }
 
 /******************************************************/
-void LogDirectorySummary::addLogsToSummary(const std::vector<boost::shared_ptr<DataLog> > data_logs)
+void LogDirectorySummary::addLogsToSummary(const std::vector<boost::shared_ptr<DataLog> > data_logs, const User& user)
 {
 	for (unsigned int lg = 0; lg < data_logs.size(); ++lg)
 	{
@@ -179,55 +763,125 @@ void LogDirectorySummary::addLogsToSummary(const std::vector<boost::shared_ptr<D
 		log_summary._date = data_logs[lg]->dateString();
 		log_summary._time = data_logs[lg]->totalTime();
 		log_summary._dist = data_logs[lg]->totalDist();
+		computeAggregates(*data_logs[lg], 0, data_logs[lg]->numPoints(), user, log_summary._aggregates);
 		for (int i=0; i < data_logs[lg]->numLaps(); ++i)
 		{
 			LapSummary lap_summary;
 			std::pair<int, int> lap_indecies = data_logs[lg]->lap(i);
 			lap_summary._time = data_logs[lg]->time(lap_indecies.second) - data_logs[lg]->time(lap_indecies.first);
 			lap_summary._dist = data_logs[lg]->dist(lap_indecies.second) - data_logs[lg]->dist(lap_indecies.first);
+			computeAggregates(*data_logs[lg], lap_indecies.first, lap_indecies.second+1, user, lap_summary._aggregates);
 			log_summary._laps.push_back(lap_summary);
 		}
+		RouteIndex::signature(*data_logs[lg], log_summary._route_signature);
+		setTimestamp(log_summary);
 		addLog(log_summary);
+
+		JournalEntry entry;
+		entry._removed = false;
+		entry._log = log_summary;
+		_journal.push_back(entry);
 	}
 }
 
 /******************************************************/
-LogSummary LogDirectorySummary::firstLog() const
+void LogDirectorySummary::computeAggregates(DataLog& data_log, int idx_start, int idx_end, const User& user, RideAggregates& aggregates)
 {
-	QDate min_date(2100, 1, 1); // arbitrarily chosen later date after now
-	int min_index = 0;
-
-	for (int i=0; i < numLogs(); ++i)
+	assert(idx_start >= 0 && idx_end <= data_log.numPoints());
+
+	aggregates = RideAggregates();
+	aggregates._valid_channels =
+		(data_log.timeValid() ? CHANNEL_TIME : 0) |
+		(data_log.ltdValid() && data_log.lgdValid() ? CHANNEL_GPS : 0) |
+		(data_log.altValid() ? CHANNEL_ALT : 0) |
+		(data_log.distValid() ? CHANNEL_DIST : 0) |
+		(data_log.heartRateValid() ? CHANNEL_HEART_RATE : 0) |
+		(data_log.cadenceValid() ? CHANNEL_CADENCE : 0) |
+		(data_log.speedValid() ? CHANNEL_SPEED : 0) |
+		(data_log.gradientValid() ? CHANNEL_GRADIENT : 0) |
+		(data_log.powerValid() ? CHANNEL_POWER : 0) |
+		(data_log.tempValid() ? CHANNEL_TEMP : 0);
+
+	const int num_points = idx_end - idx_start;
+	if (num_points <= 0)
+		return;
+
+	// Averages and maximums of the valid samples of each channel
+	aggregates._avg_speed = DataProcessing::computeMaskedAverage(data_log.speed(), data_log.sampleValidBits(LOG_SPEED), idx_start, idx_end);
+	aggregates._avg_heart_rate = DataProcessing::computeMaskedAverage(data_log.heartRate(), data_log.sampleValidBits(LOG_HEART_RATE), idx_start, idx_end);
+	aggregates._avg_cadence = DataProcessing::computeMaskedAverage(data_log.cadence(), data_log.sampleValidBits(LOG_CADENCE), idx_start, idx_end);
+	aggregates._avg_power = DataProcessing::computeMaskedAverage(data_log.power(), data_log.sampleValidBits(LOG_POWER), idx_start, idx_end);
+	aggregates._avg_gradient = DataProcessing::computeMaskedAverage(data_log.gradient(), data_log.sampleValidBits(LOG_GRADIENT), idx_start, idx_end);
+	aggregates._avg_temp = DataProcessing::computeMaskedAverage(data_log.temp(), data_log.sampleValidBits(LOG_TEMP), idx_start, idx_end);
+
+	aggregates._max_speed = DataProcessing::computeMaskedMax(data_log.speed(), data_log.sampleValidBits(LOG_SPEED), idx_start, idx_end);
+	aggregates._max_heart_rate = DataProcessing::computeMaskedMax(data_log.heartRate(), data_log.sampleValidBits(LOG_HEART_RATE), idx_start, idx_end);
+	aggregates._max_cadence = DataProcessing::computeMaskedMax(data_log.cadence(), data_log.sampleValidBits(LOG_CADENCE), idx_start, idx_end);
+	aggregates._max_power = DataProcessing::computeMaskedMax(data_log.power(), data_log.sampleValidBits(LOG_POWER), idx_start, idx_end);
+	aggregates._max_gradient = DataProcessing::computeMaskedMax(data_log.gradient(), data_log.sampleValidBits(LOG_GRADIENT), idx_start, idx_end);
+	aggregates._max_temp = DataProcessing::computeMaskedMax(data_log.temp(), data_log.sampleValidBits(LOG_TEMP), idx_start, idx_end);
+
+	const double zones[NUM_HR_ZONES+1] = {(double)user.zone1(), (double)user.zone2(), (double)user.zone3(), (double)user.zone4(), (double)user.zone5(), 1000.0};
+	const bool alt_fltd_valid = data_log.altFltdValid();
+	bool first_gps = true;
+
+	// The other aggregates in one pass over the points
+	for (int i=idx_start; i < idx_end; ++i)
 	{
-		QString tmp = log(i)._date.split(' ')[0]; // split at the ' ' to get date only (no time)
-		QDate date = QDate::fromString(tmp,Qt::ISODate);
+		if (data_log.sampleValid(LOG_GPS, i))
+		{
+			if (first_gps)
+			{
+				aggregates._min_ltd = aggregates._max_ltd = data_log.ltd(i);
+				aggregates._min_lgd = aggregates._max_lgd = data_log.lgd(i);
+				first_gps = false;
+			}
+			aggregates._min_ltd = std::min(aggregates._min_ltd, data_log.ltd(i));
+			aggregates._max_ltd = std::max(aggregates._max_ltd, data_log.ltd(i));
+			aggregates._min_lgd = std::min(aggregates._min_lgd, data_log.lgd(i));
+			aggregates._max_lgd = std::max(aggregates._max_lgd, data_log.lgd(i));
+		}
 
-		if (date < min_date)
+		if (i > idx_start)
 		{
-			min_date = date;
-			min_index = i;
+			// Elevation from the smoothed altitude, so noise is not counted as climbing
+			if (alt_fltd_valid)
+			{
+				const double climb = data_log.altFltd(i) - data_log.altFltd(i-1);
+				if (climb > 0.0)
+					aggregates._elevation_gain += climb;
+				else
+					aggregates._elevation_loss -= climb;
+			}
+
+			// Time weighted totals, the time since the previous point belongs to this point.
+			// Gaps (auto-pause, lost signal) have no data, as in UniformLog
+			const double dt = data_log.time(i) - data_log.time(i-1);
+			if (dt > 0.0 && dt <= UNIFORM_GAP_THD)
+			{
+				if (data_log.sampleValid(LOG_POWER, i))
+					aggregates._energy += data_log.power(i)*dt/1000.0;
+				if (data_log.sampleValid(LOG_HEART_RATE, i))
+				{
+					for (int z=0; z < NUM_HR_ZONES; ++z)
+					{
+						if (data_log.heartRate(i) >= zones[z] && data_log.heartRate(i) < zones[z+1])
+							aggregates._hr_zone_time[z] += dt;
+					}
+				}
+			}
 		}
 	}
+}
 
-	return log(min_index);
+/******************************************************/
+LogSummary LogDirectorySummary::firstLog() const
+{
+	return log(0);
 }
 
 /******************************************************/
 LogSummary LogDirectorySummary::lastLog() const
 {
-	QDate max_date(1970, 1, 1); // arbitrarily chosen ealier date before now
-	int max_index = 0;
-
-	for (int i=0; i < numLogs(); ++i)
-	{
-		QDate date = log(i).date();
-
-		if (date > max_date)
-		{
-			max_date = date;
-			max_index = i;
-		}
-	}
-
-	return log(max_index);
+	return log(numLogs()-1);
 }
\ No newline at end of file
@@ -4,18 +4,64 @@
 #include <QString.h>
 #include <QDateTime.h>
 #include <QStringList.h>
+#include <QHash.h>
 
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
 
+#define NUM_HR_ZONES 5
+
+// Bits of RideAggregates::_valid_channels, set for the channels the log has data for
+#define CHANNEL_TIME 0x0001
+#define CHANNEL_GPS 0x0002
+#define CHANNEL_ALT 0x0004
+#define CHANNEL_DIST 0x0008
+#define CHANNEL_HEART_RATE 0x0010
+#define CHANNEL_CADENCE 0x0020
+#define CHANNEL_SPEED 0x0040
+#define CHANNEL_GRADIENT 0x0080
+#define CHANNEL_POWER 0x0100
+#define CHANNEL_TEMP 0x0200
+
 class DataLog;
+class User;
+class QDataStream;
+
+/**********************************/
+struct RideAggregates
+{
+	double _elevation_gain; //m
+	double _elevation_loss; //m
+	double _avg_speed; //kmh
+	double _max_speed; //kmh
+	double _avg_heart_rate; //bpm
+	double _max_heart_rate; //bpm
+	double _avg_cadence; //rpm
+	double _max_cadence; //rpm
+	double _avg_power; //W
+	double _max_power; //W
+	double _avg_gradient; //%
+	double _max_gradient; //%
+	double _avg_temp; //C
+	double _max_temp; //C
+	double _hr_zone_time[NUM_HR_ZONES]; //sec
+	double _energy; //kJ
+	double _min_ltd; //deg, bounding box of the GPS points
+	double _max_ltd; //deg
+	double _min_lgd; //deg
+	double _max_lgd; //deg
+	unsigned int _valid_channels; // CHANNEL_ bits, 0 if the aggregates were never computed
+
+	RideAggregates();
+};
 
 /**********************************/
 struct LapSummary
 {
 	double _time;
 	double _dist;
+	RideAggregates _aggregates;
 };
 
 /**********************************/
@@ -26,15 +72,27 @@ struct LogSummary
 	double _time;
 	double _dist;
 	std::vector<LapSummary> _laps;
+	RideAggregates _aggregates;
+	std::vector<unsigned int> _route_signature; // see RouteIndex, empty if the ride has no GPS
+
+	// Set by LogDirectorySummary from _date
+	qint64 _timestamp; // sec, local time since the start of julian day 0
+	QDate _day;
 
 	QDate date() const
 	{
-		QString tmp = _date.split(' ')[0]; // split at the ' ' to get date only (no time)
-		return QDate::fromString(tmp,Qt::ISODate);
+		return _day;
 	};
 };
 
-/**********************************/
+/* Class to hold a summary of every ride in a log directory.
+   The summary is stored in a binary index of fixed size records. Changes are appended
+   to the index as a journal of added and removed rides, so registering a ride doesn't
+   rewrite the whole file, and the index is compacted when it holds many removed records.
+   The index is read through a memory map.
+   Logs are kept sorted by date, so a date range is a contiguous span of log indecies,
+   and logs are looked up by filename through a hash. */
+
 class LogDirectorySummary
  {
  public:
@@ -45,20 +103,76 @@ class LogDirectorySummary
 	const LogSummary& log(int idx) const;
 	int numLogs() const;
 
-	void addLogsToSummary(const std::vector<boost::shared_ptr<DataLog> > data_logs);
+	// Add parsed logs, computing their aggregates (HR zone times use the zones of the user)
+	void addLogsToSummary(const std::vector<boost::shared_ptr<DataLog> > data_logs, const User& user);
+
+	// Aggregates of the points of a log from idx_start to idx_end (exclusive)
+	static void computeAggregates(DataLog& data_log, int idx_start, int idx_end, const User& user, RideAggregates& aggregates);
 	bool removeLogByName(const QString& filename);
 
+	// Index of the log of a filename, or -1 if there is none
+	int indexOf(const QString& filename) const;
+
+	// Filenames of the logs whose aggregates or route signature were never computed (imported
+	// from xml), or whose HR zone times were computed with other zones than those of the user.
+	// They need to be parsed and added again
+	QStringList logsToUpdate(const User& user) const;
+
+	// Record that the HR zone times of all the logs use the zones of the user, once the logs
+	// from logsToUpdate are added again
+	void setHrZones(const User& user);
+
+	// Span of the logs between 2 dates (inclusive), as the first index and one past the last index
+	std::pair<int, int> logsInRange(const QDate& min_date, const QDate& max_date) const;
+
+	// Read the summary from the index, or import logsummary.xml if there is no index yet
 	void readFromFile();
-	void writeToFile() const;
+	// Write the changes since readFromFile to the index
+	void writeToFile();
+
+	// Read/write the summary in the xml format used before the index
+	bool importFromXml(const QString& filename);
+	void exportToXml(const QString& filename) const;
 
 	LogSummary firstLog() const; // chronologically first log
 	LogSummary lastLog() const; // chronologically last log
 
  private:
-	void addLog(const LogSummary& log_summary);
+	struct JournalEntry
+	{
+		bool _removed; // true if the log was removed, otherwise added
+		LogSummary _log;
+	};
+
+	// Insert a log in date order, replacing any log of the same filename. Returns its index
+	int addLog(const LogSummary& log_summary);
+
+	// Set the timestamp and day of a log from its date string
+	static void setTimestamp(LogSummary& log_summary);
+
+	// Read all records of the index. Returns false if there is no valid index
+	bool readIndex();
+	// Rewrite the index with just the current logs
+	void writeIndex();
+	// Append the journal to the index
+	void appendToIndex();
+	// Write the records of an added or removed log
+	void writeRecords(QDataStream& out, const JournalEntry& entry) const;
+	// Number of index records used by an added or removed log
+	int numRecords(const LogSummary& log_summary, bool removed) const;
+	// Filename of a log as stored in the index, relative to the log directory if it is in it
+	QString indexFilename(const QString& filename, bool& relative) const;
+	// Hash of the HR zones of a user
+	static quint32 hrZonesHash(const User& user);
 
 	QString _log_directory;
-	std::vector<LogSummary> _logs;
+	std::vector<LogSummary> _logs; // sorted by timestamp
+	QHash<QString, qint64> _timestamps; // timestamp of each filename
+
+	std::vector<JournalEntry> _journal; // changes not yet written to the index
+	int _num_index_records; // records in the index file, including removed logs
+	bool _rewrite_index; // true if the index is missing or out of date
+	quint32 _hr_zones_hash; // of the zones the HR zone times were computed with, 0 if not known
  };
 
 #endif // LOGDIRECTORYSUMMARY_H
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "fitencoder.h"
 #include "baseparser.h"
 #include "logdirectorysummary.h"
+#include "derivedstores.h"
 
 #include <QTableWidget.h>
 #include <QBoxLayout.h>
@@ -453,6 +454,7 @@ void LogEditorWindow::split()
 			data_log_pt1->gradient(i) = _data_log->gradient(i);
 			data_log_pt1->power(i) = _data_log->power(i);
 			data_log_pt1->temp(i) = _data_log->temp(i);
+			data_log_pt1->copySampleValid(*_data_log, i, i);
 		}
 
 		const int start_time_pt2 = _data_log->time(split_value); // time offset for all time in pt2
@@ -472,6 +474,7 @@ void LogEditorWindow::split()
 			data_log_pt2->gradient(i) = _data_log->gradient(idx);
 			data_log_pt2->power(i) = _data_log->power(idx);
 			data_log_pt2->temp(i) = _data_log->temp(idx);
+			data_log_pt2->copySampleValid(*_data_log, idx, i);
 		}
 
 		// Dates
@@ -497,10 +500,8 @@ void LogEditorWindow::split()
 		// Additional bits and pieces
 		data_log_pt1->computeMaps();
 		data_log_pt2->computeMaps();
-		BaseParser::setDataValidFlags(*data_log_pt1);
-		BaseParser::setDataValidFlags(*data_log_pt2);
-		BaseParser::computeAdditionalDetailts(*data_log_pt1);
-		BaseParser::computeAdditionalDetailts(*data_log_pt2);
+		BaseParser::postProcess(*data_log_pt1);
+		BaseParser::postProcess(*data_log_pt2);
 
 		// Encode the first file
 		bool encoding_successful = true;
@@ -535,11 +536,14 @@ void LogEditorWindow::split()
 			std::vector<boost::shared_ptr<DataLog> > data_logs(2);
 			data_logs[0] = data_log_pt1;
 			data_logs[1] = data_log_pt2;
-			log_dir_summary.addLogsToSummary(data_logs);
+			log_dir_summary.addLogsToSummary(data_logs, *_user);
 
 			log_dir_summary.removeLogByName(_data_log->filename());
 			log_dir_summary.writeToFile();
 
+			// And the stores derived from the rides
+			DerivedStores::update(log_dir_summary, QStringList(_data_log->filename()), data_logs, *_user);
+
 			// Signal to the rest of the application the log directory has been updated
 			emit logSummaryUpdated(_user);
 			_data_log = data_log_pt1;
@@ -614,6 +618,7 @@ void LogEditorWindow::trim()
 			data_log_trim->gradient(trim_idx) = _data_log->gradient(i);
 			data_log_trim->power(trim_idx) = _data_log->power(i);
 			data_log_trim->temp(trim_idx) = _data_log->temp(i);
+			data_log_trim->copySampleValid(*_data_log, i, trim_idx);
 		}
 
 		// Dates
@@ -631,8 +636,7 @@ void LogEditorWindow::trim()
 
 		// Additional bits and pieces
 		data_log_trim->computeMaps();
-		BaseParser::setDataValidFlags(*data_log_trim);
-		BaseParser::computeAdditionalDetailts(*data_log_trim);
+		BaseParser::postProcess(*data_log_trim);
 
 		// Rename original file
 		bool original_backed_up = false;
@@ -664,9 +668,11 @@ void LogEditorWindow::trim()
 				log_dir_summary.removeLogByName(_data_log->filename()); // remove current log
 				std::vector<boost::shared_ptr<DataLog> > data_logs(1);
 				data_logs[0] = data_log_trim;
-				log_dir_summary.addLogsToSummary(data_logs); // add new log
+				log_dir_summary.addLogsToSummary(data_logs, *_user); // add new log
 				
 				log_dir_summary.writeToFile();	
+
+				DerivedStores::update(log_dir_summary, QStringList(_data_log->filename()), data_logs, *_user);
 				//_data_log->saveToTextFile("saved_log.txt");
 
 				// Signal to the rest of the application the log has been updated
@@ -10,7 +10,9 @@
 #include "specifyuserwindow.h"
 #include "logdirectorysummary.h"
 #include "totalswindow.h"
+#include "trainingloadwindow.h"
 #include "rideintervalfinderwindow.h"
+#include "ridecomparisonwindow.h"
 #include "logeditorwindow.h"
 
 #include <stdio.h>
@@ -180,8 +182,10 @@ void MainWindow::setUser(boost::shared_ptr<User> user)
 	
 	_edit_act->setEnabled(true);
 	_totals_act->setEnabled(true);
+	_training_load_act->setEnabled(true);
 	_map_collage_act->setEnabled(true);
 	_ride_interval_finder_act->setEnabled(true);
+	_ride_comparison_act->setEnabled(true);
 	_log_file_editor_act->setEnabled(true);
 	_retrieve_logs_act->setEnabled(true);
 	user->writeToFile(USER_DIRECTORY + user->name() + QString(".rider"));
@@ -298,6 +302,16 @@ void MainWindow::totals()
 	}
 }
 
+/******************************************************/
+void MainWindow::trainingLoad()
+{
+	if (_current_user)
+	{
+		_training_load_window.reset(new TrainingLoadWindow(_current_user));
+		_training_load_window->show();
+	}
+}
+
 /******************************************************/
 void MainWindow::mapCollage()
 {
@@ -319,6 +333,16 @@ void MainWindow::rideIntervalFinder()
 	}
 }
 
+/******************************************************/
+void MainWindow::rideComparison()
+{
+	if (_current_user && _ride_selector->currentDataLog())
+	{
+		_ride_comparison_window.reset(new RideComparisonWindow(_current_user, _ride_selector->currentDataLog()));
+		_ride_comparison_window->show();
+	}
+}
+
 /******************************************************/
 void MainWindow::logFileEditor()
 {
@@ -358,6 +382,10 @@ void MainWindow::createActions()
 	_totals_act->setEnabled(false);
 	connect(_totals_act, SIGNAL(triggered()), this, SLOT(totals()));
 
+	_training_load_act = new QAction(tr("Training Load..."), this);
+	_training_load_act->setEnabled(false);
+	connect(_training_load_act, SIGNAL(triggered()), this, SLOT(trainingLoad()));
+
 	_map_collage_act = new QAction(tr("Ride Collage..."), this);
 	_map_collage_act->setEnabled(false);
 	connect(_map_collage_act, SIGNAL(triggered()), this, SLOT(mapCollage()));
@@ -366,6 +394,10 @@ void MainWindow::createActions()
 	_ride_interval_finder_act->setEnabled(false);
 	connect(_ride_interval_finder_act, SIGNAL(triggered()), this, SLOT(rideIntervalFinder()));
 
+	_ride_comparison_act = new QAction(tr("Ride Comparison..."), this);
+	_ride_comparison_act->setEnabled(false);
+	connect(_ride_comparison_act, SIGNAL(triggered()), this, SLOT(rideComparison()));
+
 	_log_file_editor_act = new QAction(tr("Log File Editor..."), this);
 	_log_file_editor_act ->setEnabled(false);
 	connect(_log_file_editor_act , SIGNAL(triggered()), this, SLOT(logFileEditor()));
@@ -395,8 +427,10 @@ void MainWindow::createMenus()
 
 	_tools_menu = new QMenu(tr("&Tools"), this);
 	_tools_menu->addAction(_totals_act);
+	_tools_menu->addAction(_training_load_act);
 	_tools_menu->addAction(_map_collage_act); 
 	_tools_menu->addAction(_ride_interval_finder_act);
+	_tools_menu->addAction(_ride_comparison_act);
 	_tools_menu->addAction(_log_file_editor_act);
 
 	_help_menu = new QMenu(tr("&Help"), this);
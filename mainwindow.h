@@ -17,7 +17,9 @@
  class RideSelectionWindow;
  class User;
  class TotalsWindow;
+ class TrainingLoadWindow;
  class RideIntervalFinderWindow;
+ class RideComparisonWindow;
  class LogEditorWindow;
 
  class MainWindow : public QMainWindow
@@ -39,8 +41,10 @@
     void editUser();
 	void retrieveLogs();
     void totals();
+    void trainingLoad();
 	void mapCollage();
 	void rideIntervalFinder();
+	void rideComparison();
 	void logFileEditor();
     void about();
     void help();
@@ -59,8 +63,10 @@
     QAction* _edit_act;
     QAction* _retrieve_logs_act;
     QAction* _totals_act;
+    QAction* _training_load_act;
     QAction* _map_collage_act;
     QAction* _ride_interval_finder_act;
+    QAction* _ride_comparison_act;
     QAction* _log_file_editor_act;
     QAction* _exit_act;
     QAction* _about_act;
@@ -77,8 +83,10 @@
 	boost::shared_ptr<RideSelectionWindow> _ride_selector;
 
 	boost::scoped_ptr<TotalsWindow> _totals_window;
+	boost::scoped_ptr<TrainingLoadWindow> _training_load_window;
 	boost::scoped_ptr<GoogleMapCollageWindow> _ride_collage;
 	boost::scoped_ptr<RideIntervalFinderWindow> _rider_interval_finder;
+	boost::scoped_ptr<RideComparisonWindow> _ride_comparison_window;
 	boost::scoped_ptr<LogEditorWindow> _log_file_editor;
 
 	boost::shared_ptr<User> _current_user;
@@ -0,0 +1,148 @@
+#include "maprenderer.h"
+#include "heatmapgrid.h"
+#include "webmercator.h"
+
+#include <QPainter.h>
+
+#include <algorithm>
+
+/****************************************/
+// Sort cells so the most frequent are drawn last (on top)
+static bool cellCountLessThan(const HeatMapCell& a, const HeatMapCell& b)
+{
+	return a._count < b._count;
+}
+
+/****************************************/
+MapRenderer::MapRenderer(int width, int height):
+_width(width),
+_height(height),
+_zoom(0),
+_centre_x(WEB_MERCATOR_TILE_SIZE/2.0),
+_centre_y(WEB_MERCATOR_TILE_SIZE/2.0),
+_background_colour(235,235,235)
+{}
+
+/****************************************/
+MapRenderer::~MapRenderer()
+{}
+
+/****************************************/
+int MapRenderer::width() const
+{
+	return _width;
+}
+
+/****************************************/
+int MapRenderer::height() const
+{
+	return _height;
+}
+
+/****************************************/
+int MapRenderer::zoom() const
+{
+	return _zoom;
+}
+
+/****************************************/
+void MapRenderer::fitBounds(double min_ltd, double min_lgd, double max_ltd, double max_lgd)
+{
+	// Size of the box at zoom 0, each zoom level doubles it
+	const double box_width = WebMercator::xFromLgd(max_lgd, 0) - WebMercator::xFromLgd(min_lgd, 0);
+	const double box_height = WebMercator::yFromLtd(min_ltd, 0) - WebMercator::yFromLtd(max_ltd, 0);
+	const double available_width = std::max(1, _width - 2*MAP_RENDERER_MARGIN);
+	const double available_height = std::max(1, _height - 2*MAP_RENDERER_MARGIN);
+
+	int zoom = 0;
+	while (zoom < MAP_RENDERER_MAX_ZOOM &&
+		box_width*(double)(1 << (zoom+1)) <= available_width &&
+		box_height*(double)(1 << (zoom+1)) <= available_height)
+		++zoom;
+
+	_zoom = zoom;
+	_centre_x = 0.5*(WebMercator::xFromLgd(min_lgd, _zoom) + WebMercator::xFromLgd(max_lgd, _zoom));
+	_centre_y = 0.5*(WebMercator::yFromLtd(min_ltd, _zoom) + WebMercator::yFromLtd(max_ltd, _zoom));
+}
+
+/****************************************/
+void MapRenderer::fitHeatMap(const HeatMapGrid& grid)
+{
+	std::vector<HeatMapCell> cells;
+	grid.cells(cells);
+	if (cells.empty())
+		return;
+
+	int min_x = cells[0]._x, max_x = cells[0]._x, min_y = cells[0]._y, max_y = cells[0]._y;
+	for (unsigned int i=1; i < cells.size(); ++i)
+	{
+		min_x = std::min(min_x, cells[i]._x);
+		max_x = std::max(max_x, cells[i]._x);
+		min_y = std::min(min_y, cells[i]._y);
+		max_y = std::max(max_y, cells[i]._y);
+	}
+
+	fitBounds(
+		WebMercator::ltdFromY(max_y + 1, grid.zoom()), WebMercator::lgdFromX(min_x, grid.zoom()),
+		WebMercator::ltdFromY(min_y, grid.zoom()), WebMercator::lgdFromX(max_x + 1, grid.zoom()));
+}
+
+/****************************************/
+QImage MapRenderer::createImage() const
+{
+	QImage image(_width, _height, QImage::Format_ARGB32_Premultiplied);
+	image.fill(_background_colour);
+	return image;
+}
+
+/****************************************/
+QImage MapRenderer::renderHeatMap(const HeatMapGrid& grid) const
+{
+	QImage image = createImage();
+
+	std::vector<HeatMapCell> cells;
+	grid.cells(cells);
+	if (cells.empty() || grid.maxCount() == 0)
+		return image;
+	std::stable_sort(cells.begin(), cells.end(), cellCountLessThan);
+
+	QPainter painter(&image);
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setPen(Qt::NoPen);
+
+	// Size of a grid cell in image pixels, but always visible
+	const double scale = (_zoom >= grid.zoom()) ? (double)(1 << (_zoom - grid.zoom())) : 1.0/(double)(1 << (grid.zoom() - _zoom));
+	const double cell_size = std::max(scale, 2.0);
+	const double offset_x = 0.5*_width - _centre_x;
+	const double offset_y = 0.5*_height - _centre_y;
+
+	for (unsigned int i=0; i < cells.size(); ++i)
+	{
+		const double x = (cells[i]._x + 0.5)*scale + offset_x;
+		const double y = (cells[i]._y + 0.5)*scale + offset_y;
+		if (x < -cell_size || y < -cell_size || x > _width + cell_size || y > _height + cell_size)
+			continue; // outside the image
+
+		painter.setBrush(colourFromFraction((double)cells[i]._count/grid.maxCount()));
+		painter.drawEllipse(QPointF(x, y), 0.5*cell_size, 0.5*cell_size);
+	}
+
+	painter.end();
+	return image;
+}
+
+/****************************************/
+QColor MapRenderer::colourFromFraction(double frac)
+{
+	frac = std::min(std::max(frac, 0.0), 1.0);
+	if (frac < 0.5)
+		return QColor((int)(510.0*frac), 255, 0); // green to yellow
+	else
+		return QColor(255, (int)(510.0*(1.0 - frac)), 0); // yellow to red
+}
+
+/****************************************/
+bool MapRenderer::saveImage(const QImage& image, const QString& filename)
+{
+	return image.save(filename);
+}
\ No newline at end of file
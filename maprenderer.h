@@ -0,0 +1,54 @@
+#ifndef MAPRENDERER_H
+#define MAPRENDERER_H
+
+#include <QImage.h>
+#include <QColor.h>
+#include <QString.h>
+
+#include <vector>
+
+#define MAP_RENDERER_MAX_ZOOM 18
+#define MAP_RENDERER_MARGIN 20 // pixels
+
+class HeatMapGrid;
+
+/* Class to draw heat maps into an image without google maps.
+   The image is a web mercator view defined by its centre and zoom, so it lines up with
+   map tiles, but no map is drawn underneath. Does not need a window, so can be used to
+   export images in batch. */
+
+class MapRenderer
+ {
+ public:
+	MapRenderer(int width = 800, int height = 600);
+	~MapRenderer();
+
+	int width() const;
+	int height() const;
+	int zoom() const;
+
+	// Centre the view on the box and pick the largest zoom at which it fits in the image
+	void fitBounds(double min_ltd, double min_lgd, double max_ltd, double max_lgd);
+	void fitHeatMap(const HeatMapGrid& grid);
+
+	// Draw the cells of the grid, coloured by count relative to the max count
+	QImage renderHeatMap(const HeatMapGrid& grid) const;
+
+	// Colour ramp from green (0.0) through yellow to red (1.0), as used by the map windows
+	static QColor colourFromFraction(double frac);
+
+	// Write the image, format is taken from the file extension (eg .png). Returns true on success
+	static bool saveImage(const QImage& image, const QString& filename);
+
+ private:
+	QImage createImage() const;
+
+	int _width;
+	int _height;
+	int _zoom;
+	double _centre_x; // world pixels at _zoom
+	double _centre_y; // world pixels at _zoom
+	QColor _background_colour;
+ };
+
+#endif // MAPRENDERER_H
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "pathsimplifier.h"
+#include "datalog.h"
+#include "webmercator.h"
+
+#include <cassert>
+#include <algorithm>
+#include <limits>
+
+#define EARTH_RADIUS 6371000.0 // metres
+
+/**********************************/
+// Part of the path still to be simplified
+struct Segment
+{
+	int _first;
+	int _last;
+	double _tolerance; // tolerance of the point which split off this segment
+};
+
+/****************************************/
+// Distance from point p to the segment a-b (all in metres on a local plane)
+static double distanceToSegment(double px, double py, double ax, double ay, double bx, double by)
+{
+	const double dx = bx - ax;
+	const double dy = by - ay;
+	const double len_sq = dx*dx + dy*dy;
+
+	double t = 0.0;
+	if (len_sq > 0.0)
+		t = std::min(std::max(((px - ax)*dx + (py - ay)*dy)/len_sq, 0.0), 1.0);
+
+	const double ex = ax + t*dx - px;
+	const double ey = ay + t*dy - py;
+	return sqrt(ex*ex + ey*ey);
+}
+
+/****************************************/
+PathSimplifier::PathSimplifier()
+{}
+
+/****************************************/
+PathSimplifier::~PathSimplifier()
+{}
+
+/****************************************/
+void PathSimplifier::clear()
+{
+	_indecies.clear();
+	_levels.clear();
+}
+
+/****************************************/
+int PathSimplifier::numPoints() const
+{
+	return _indecies.size();
+}
+
+/****************************************/
+int PathSimplifier::index(int pt) const
+{
+	return _indecies[pt];
+}
+
+/****************************************/
+int PathSimplifier::level(int pt) const
+{
+	return _levels[pt];
+}
+
+/****************************************/
+int PathSimplifier::zoomFromLevel(int level)
+{
+	return PATH_SIMPLIFIER_FIRST_ZOOM + 2*level;
+}
+
+/****************************************/
+void PathSimplifier::simplify(DataLog& data_log)
+{
+	clear();
+
+	// Project the valid GPS points onto a plane (equirectangular, fine over the size of a ride)
+	std::vector<int> indecies;
+	std::vector<double> x, y;
+	for (int i=0; i < data_log.numPoints(); ++i)
+	{
+		if (data_log.sampleValid(LOG_GPS, i))
+			indecies.push_back(i);
+	}
+	if (indecies.empty())
+		return;
+
+	const double ref_ltd = data_log.ltd(indecies[0]);
+	const double cos_ref_ltd = cos(ref_ltd*M_PI/180.0);
+	x.resize(indecies.size());
+	y.resize(indecies.size());
+	for (unsigned int i=0; i < indecies.size(); ++i)
+	{
+		x[i] = data_log.lgd(indecies[i])*M_PI/180.0*EARTH_RADIUS*cos_ref_ltd;
+		y[i] = data_log.ltd(indecies[i])*M_PI/180.0*EARTH_RADIUS;
+	}
+
+	// Douglas-Peucker, recording the tolerance at which each point is split off. A point is never
+	// given a larger tolerance than the point which split its parent segment, so the levels are nested
+	const int num_points = indecies.size();
+	std::vector<double> tolerance(num_points, 0.0);
+	tolerance[0] = std::numeric_limits<double>::max();
+	tolerance[num_points-1] = std::numeric_limits<double>::max();
+
+	std::vector<Segment> stack;
+	Segment whole = {0, num_points-1, std::numeric_limits<double>::max()};
+	stack.push_back(whole);
+	while (!stack.empty())
+	{
+		const Segment seg = stack.back();
+		stack.pop_back();
+		if (seg._last - seg._first < 2)
+			continue;
+
+		int max_pt = seg._first + 1;
+		double max_dist = -1.0;
+		for (int i=seg._first+1; i < seg._last; ++i)
+		{
+			const double d = distanceToSegment(x[i], y[i], x[seg._first], y[seg._first], x[seg._last], y[seg._last]);
+			if (d > max_dist)
+			{
+				max_dist = d;
+				max_pt = i;
+			}
+		}
+
+		tolerance[max_pt] = std::min(max_dist, seg._tolerance);
+		Segment left = {seg._first, max_pt, tolerance[max_pt]};
+		Segment right = {max_pt, seg._last, tolerance[max_pt]};
+		stack.push_back(left);
+		stack.push_back(right);
+	}
+
+	// Level of detail is the coarsest level whose tolerance (one pixel) the point exceeds
+	double level_tolerance[PATH_SIMPLIFIER_NUM_LEVELS];
+	for (int l=0; l < PATH_SIMPLIFIER_NUM_LEVELS; ++l)
+		level_tolerance[l] = WebMercator::metresPerPixel(ref_ltd, zoomFromLevel(l));
+
+	for (int i=0; i < num_points; ++i)
+	{
+		for (int l=0; l < PATH_SIMPLIFIER_NUM_LEVELS; ++l)
+		{
+			if (tolerance[i] >= level_tolerance[l])
+			{
+				_indecies.push_back(indecies[i]);
+				_levels.push_back(l);
+				break;
+			}
+		}
+	}
+}
+
+/****************************************/
+void PathSimplifier::indecies(int level, int idx_start, int idx_end, std::vector<int>& indecies) const
+{
+	indecies.clear();
+	for (std::vector<int>::const_iterator it = std::lower_bound(_indecies.begin(), _indecies.end(), idx_start); it != _indecies.end() && *it < idx_end; ++it)
+	{
+		if (_levels[it - _indecies.begin()] <= level)
+			indecies.push_back(*it);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef PATHSIMPLIFIER_H
+#define PATHSIMPLIFIER_H
+
+#include <vector>
+
+#define PATH_SIMPLIFIER_NUM_LEVELS 5
+#define PATH_SIMPLIFIER_FIRST_ZOOM 9 // map zoom of the coarsest level, each level is 2 zooms finer
+
+class DataLog;
+
+/* Class to simplify a ride path for drawing on a map, using Douglas-Peucker.
+   Each GPS point gets the tolerance (metres) below which it is needed, so the path for
+   any tolerance is just the points above it. Tolerances are chosen as one map pixel at
+   a few zoom levels, giving a level of detail for each point. Points are kept as indecies
+   into the DataLog, so markers and selections still map onto the log. */
+
+class PathSimplifier
+ {
+ public:
+	PathSimplifier();
+	~PathSimplifier();
+
+	// Simplify the GPS path of the log. Points with no GPS fix are skipped
+	void simplify(DataLog& data_log);
+	void clear();
+
+	// Number of points kept at the finest level
+	int numPoints() const;
+
+	// DataLog index of a kept point
+	int index(int pt) const;
+
+	// Coarsest level a kept point is drawn at (0=coarsest)
+	int level(int pt) const;
+
+	// Map zoom at which a level is first used
+	static int zoomFromLevel(int level);
+
+	// DataLog indecies of the points drawn at a level, between idx_start and idx_end (exclusive)
+	void indecies(int level, int idx_start, int idx_end, std::vector<int>& indecies) const;
+
+ private:
+	std::vector<int> _indecies;
+	std::vector<int> _levels;
+ };
+
+#endif // PATHSIMPLIFIER_H
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "hrzoneitem.h"
 #include "qwtcustomplotpicker.h"
 #include "qwtcustomplotzoomer.h"
+#include "decimatedseriesdata.h"
+#include "curvefilterworker.h"
 #include "colours.h"
 
 #include <qwt_plot_picker.h>
@@ -462,6 +464,10 @@ PlotWindow::PlotWindow(
 	_smoothing_selection->setValue(5); // default value
 	connect(_smoothing_selection, SIGNAL(valueChanged(int)),this,SLOT(signalSmoothingChanged()));
 
+	// Smoothing changes are filtered in the background
+	_curve_filter_worker.reset(new CurveFilterWorker());
+	connect(_curve_filter_worker.get(), SIGNAL(resultReady()), this, SLOT(curvesFiltered()));
+
 	// Layout the GUI
 	QWidget* plot_options_widget = new QWidget;
 	QVBoxLayout* vlayout1 = new QVBoxLayout(plot_options_widget);
@@ -524,6 +530,9 @@ void PlotWindow::displayRide(
 		_plot_picker1->setDataLog(_data_log);
 
 		// Show the data
+		// Filter here rather than in the background, the other windows use the filtered data straight after
+		_curve_filter_worker->cancel();
+		filterCurveData();
 		drawGraphs();
 
 		// Display lap markers
@@ -565,7 +574,6 @@ void PlotWindow::displayRide(
 /******************************************************/
 void PlotWindow::drawGraphs()
 {
-	filterCurveData();
 	setCurveData();
 	if (_x_axis_measurement->currentIndex() == 0) // time
 	{
@@ -582,24 +590,15 @@ void PlotWindow::drawGraphs()
 /******************************************************/
 void PlotWindow::setCurveData()
 {
-	if (_x_axis_measurement->currentIndex() == 0) // time
-	{
-		_curve_hr->setRawSamples(&_data_log->time(0), &_data_log->heartRateFltd(0), _data_log->numPoints());
-		_curve_speed->setRawSamples(&_data_log->time(0), &_data_log->speedFltd(0), _data_log->numPoints());
-		_curve_cadence->setRawSamples(&_data_log->time(0), &_data_log->cadenceFltd(0), _data_log->numPoints());
-		_curve_alt->setRawSamples(&_data_log->time(0), &_data_log->altFltd(0), _data_log->numPoints());
-		_curve_power->setRawSamples(&_data_log->time(0), &_data_log->powerFltd(0), _data_log->numPoints());
-		_curve_temp->setRawSamples(&_data_log->time(0), &_data_log->temp(0), _data_log->numPoints());
-	}
-	else // distance
-	{
-		_curve_hr->setRawSamples(&_data_log->dist(0), &_data_log->heartRateFltd(0), _data_log->numPoints());
-		_curve_speed->setRawSamples(&_data_log->dist(0), &_data_log->speedFltd(0), _data_log->numPoints());
-		_curve_cadence->setRawSamples(&_data_log->dist(0), &_data_log->cadenceFltd(0), _data_log->numPoints());
-		_curve_alt->setRawSamples(&_data_log->dist(0), &_data_log->altFltd(0), _data_log->numPoints());
-		_curve_power->setRawSamples(&_data_log->dist(0), &_data_log->powerFltd(0), _data_log->numPoints());
-		_curve_temp->setRawSamples(&_data_log->dist(0), &_data_log->temp(0), _data_log->numPoints());
-	}
+	// The curves only get the points needed at the current zoom, see DecimatedSeriesData
+	const double* x = (_x_axis_measurement->currentIndex() == 0) ? &_data_log->time(0) : &_data_log->dist(0); // time or distance
+	const int num_points = _data_log->numPoints();
+	_curve_hr->setData(new DecimatedSeriesData(x, &_data_log->heartRateFltd(0), num_points, _plot->canvas()));
+	_curve_speed->setData(new DecimatedSeriesData(x, &_data_log->speedFltd(0), num_points, _plot->canvas()));
+	_curve_cadence->setData(new DecimatedSeriesData(x, &_data_log->cadenceFltd(0), num_points, _plot->canvas()));
+	_curve_alt->setData(new DecimatedSeriesData(x, &_data_log->altFltd(0), num_points, _plot->canvas()));
+	_curve_power->setData(new DecimatedSeriesData(x, &_data_log->powerFltd(0), num_points, _plot->canvas()));
+	_curve_temp->setData(new DecimatedSeriesData(x, &_data_log->temp(0), num_points, _plot->canvas()));
 }
 
 /******************************************************/
@@ -844,8 +843,50 @@ void PlotWindow::hrZoneSelectionChanged()
 /******************************************************/
 void PlotWindow::signalSmoothingChanged()
 {
-	// Filter the data
-	filterCurveData();
+	if (!_data_log)
+		return;
+
+	// Smoothing values seen before are in the derived data cache of the log
+	const int window_size = _smoothing_selection->value();
+	const LogChannel channels[] = {LOG_HEART_RATE, LOG_SPEED, LOG_CADENCE, LOG_ALT, LOG_GRADIENT, LOG_POWER};
+	bool cached = true;
+	for (int c=0; c < 6 && cached; ++c)
+		cached = (_data_log->findDerived(DerivedKey(channels[c], DERIVED_LOW_PASS, window_size)) != 0);
+
+	if (cached)
+	{
+		_curve_filter_worker->cancel();
+		filterCurveData();
+
+		// Update the plots
+		setCurveData();
+		_plot->replot();
+
+		// Update other windows viewing this data
+		emit updateDataView();
+	}
+	else
+	{
+		// Filter the data in the background, replacing any filtering still going on
+		_curve_filter_worker->request(_data_log, window_size);
+	}
+}
+
+/******************************************************/
+void PlotWindow::curvesFiltered()
+{
+	// Results for an old smoothing value or another log are dropped
+	if (!_data_log || !_curve_filter_worker->takeResult(_data_log))
+		return;
+
+	// Keep the result for when this smoothing is selected again
+	const int window_size = _data_log->filterWindowSize();
+	_data_log->storeDerived(DerivedKey(LOG_HEART_RATE, DERIVED_LOW_PASS, window_size), _data_log->heartRateFltd());
+	_data_log->storeDerived(DerivedKey(LOG_SPEED, DERIVED_LOW_PASS, window_size), _data_log->speedFltd());
+	_data_log->storeDerived(DerivedKey(LOG_CADENCE, DERIVED_LOW_PASS, window_size), _data_log->cadenceFltd());
+	_data_log->storeDerived(DerivedKey(LOG_ALT, DERIVED_LOW_PASS, window_size), _data_log->altFltd());
+	_data_log->storeDerived(DerivedKey(LOG_GRADIENT, DERIVED_LOW_PASS, window_size), _data_log->gradientFltd());
+	_data_log->storeDerived(DerivedKey(LOG_POWER, DERIVED_LOW_PASS, window_size), _data_log->powerFltd());
 
 	// Update the plots
 	setCurveData();
@@ -858,12 +899,15 @@ void PlotWindow::signalSmoothingChanged()
 /******************************************************/
 void PlotWindow::filterCurveData()
 {
-	DataProcessing::lowPassFilterSignal(_data_log->heartRate(),_data_log->heartRateFltd(),_smoothing_selection->value());
-	DataProcessing::lowPassFilterSignal(_data_log->speed(),_data_log->speedFltd(),_smoothing_selection->value());
-	DataProcessing::lowPassFilterSignal(_data_log->cadence(),_data_log->cadenceFltd(),_smoothing_selection->value());
-	DataProcessing::lowPassFilterSignal(_data_log->alt(),_data_log->altFltd(),_smoothing_selection->value());
-	DataProcessing::lowPassFilterSignal(_data_log->gradient(),_data_log->gradientFltd(),_smoothing_selection->value());
-	DataProcessing::lowPassFilterSignal(_data_log->power(),_data_log->powerFltd(),_smoothing_selection->value());
+	// Filtered channels already computed for this window come from the derived data cache
+	const int window_size = _smoothing_selection->value();
+	DataProcessing::lowPassFilterChannel(*_data_log, LOG_HEART_RATE, window_size);
+	DataProcessing::lowPassFilterChannel(*_data_log, LOG_SPEED, window_size);
+	DataProcessing::lowPassFilterChannel(*_data_log, LOG_CADENCE, window_size);
+	DataProcessing::lowPassFilterChannel(*_data_log, LOG_ALT, window_size);
+	DataProcessing::lowPassFilterChannel(*_data_log, LOG_GRADIENT, window_size);
+	DataProcessing::lowPassFilterChannel(*_data_log, LOG_POWER, window_size);
+	_data_log->filterWindowSize() = window_size;
 
 	_data_log->heartRateFltdValid() = true;
 	_data_log->speedFltdValid() = true;
@@ -7,6 +7,7 @@
 #include <qwt_plot_curve.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 
 class DataLog;
 class User;
@@ -22,6 +23,7 @@ class QComboBox;
 class QCheckBox;
 class QSpinBox;
 class QLabel;
+class CurveFilterWorker;
 
 class PlotWindow : public QWidget
 {
@@ -67,6 +69,7 @@ class PlotWindow : public QWidget
 	void lapSelectionChanged();
 	void hrZoneSelectionChanged();
 	void signalSmoothingChanged();
+	void curvesFiltered();
 
  private:
 	void drawGraphs();
@@ -106,6 +109,8 @@ class PlotWindow : public QWidget
 	QwtCustomPlotZoomer* _plot_zoomer;
 	QwtPlotPanner* _plot_panner;
 
+	boost::scoped_ptr<CurveFilterWorker> _curve_filter_worker;
+
 	boost::shared_ptr<DataLog> _data_log;
 	boost::shared_ptr<User> _user;
 };
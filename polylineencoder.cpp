@@ -0,0 +1,119 @@
+#include "polylineencoder.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#define POLYLINE_PRECISION 1e5
+#define FRACTION_ALPHABET "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+
+/****************************************/
+// Append one signed value using the encoded polyline algorithm
+static void encodeSigned(int value, std::string& encoded)
+{
+	unsigned int v = (value < 0) ? ~((unsigned int)value << 1) : ((unsigned int)value << 1);
+	while (v >= 0x20)
+	{
+		const char c = (char)((0x20 | (v & 0x1f)) + 63);
+		if (c == '\\')
+			encoded += '\\'; // escape for a javascript string
+		encoded += c;
+		v >>= 5;
+	}
+
+	const char c = (char)(v + 63);
+	if (c == '\\')
+		encoded += '\\';
+	encoded += c;
+}
+
+/****************************************/
+void PolylineEncoder::encodeCoords(const std::vector<double>& ltd, const std::vector<double>& lgd, std::string& encoded)
+{
+	assert(ltd.size() == lgd.size());
+
+	encoded.reserve(encoded.size() + 8*ltd.size());
+	int prev_ltd = 0;
+	int prev_lgd = 0;
+	for (unsigned int i=0; i < ltd.size(); ++i)
+	{
+		const int e5_ltd = (int)floor(ltd[i]*POLYLINE_PRECISION + 0.5);
+		const int e5_lgd = (int)floor(lgd[i]*POLYLINE_PRECISION + 0.5);
+		encodeSigned(e5_ltd - prev_ltd, encoded);
+		encodeSigned(e5_lgd - prev_lgd, encoded);
+		prev_ltd = e5_ltd;
+		prev_lgd = e5_lgd;
+	}
+}
+
+/****************************************/
+void PolylineEncoder::encodeInts(const std::vector<int>& values, std::string& encoded)
+{
+	encoded.reserve(encoded.size() + 2*values.size());
+	int prev = 0;
+	for (unsigned int i=0; i < values.size(); ++i)
+	{
+		encodeSigned(values[i] - prev, encoded);
+		prev = values[i];
+	}
+}
+
+/****************************************/
+void PolylineEncoder::encodeFractions(const std::vector<double>& fractions, std::string& encoded)
+{
+	static const char alphabet[] = FRACTION_ALPHABET;
+
+	encoded.reserve(encoded.size() + fractions.size());
+	for (unsigned int i=0; i < fractions.size(); ++i)
+	{
+		const double frac = std::min(std::max(fractions[i], 0.0), 1.0);
+		encoded += alphabet[(int)floor(frac*63.0 + 0.5)];
+	}
+}
+
+/****************************************/
+std::string PolylineEncoder::javascriptDecoders()
+{
+	return
+		// Function to decode a list of signed values, each the difference to the previous value of its dimension
+		"function decodeSigned(str, dims) {\n"
+		"var values = new Array();\n"
+		"var prev = [0, 0];\n"
+		"var index = 0;\n"
+		"var dim = 0;\n"
+		"while (index < str.length) {\n"
+		"var shift = 0, result = 0, b;\n"
+		"do {\n"
+		"b = str.charCodeAt(index++) - 63;\n"
+		"result |= (b & 0x1f) << shift;\n"
+		"shift += 5;\n"
+		"} while (b >= 0x20);\n"
+		"prev[dim] += (result & 1) ? ~(result >> 1) : (result >> 1);\n"
+		"values.push(prev[dim]);\n"
+		"dim = (dim + 1) % dims;\n"
+		"}\n"
+		"return values;\n"
+		"}\n"
+
+		"function decodeCoords(str) {\n"
+		"var values = decodeSigned(str, 2);\n"
+		"var coords = new Array(values.length/2);\n"
+		"for (var i = 0; i < coords.length; i++) {\n"
+		"coords[i] = new google.maps.LatLng(values[2*i]*1e-5, values[2*i+1]*1e-5);\n"
+		"}\n"
+		"return coords;\n"
+		"}\n"
+
+		"function decodeInts(str) {\n"
+		"return decodeSigned(str, 1);\n"
+		"}\n"
+
+		"function decodeFractions(str) {\n"
+		"var alphabet = \"" FRACTION_ALPHABET "\";\n"
+		"var fractions = new Float32Array(str.length);\n"
+		"for (var i = 0; i < str.length; i++) {\n"
+		"fractions[i] = alphabet.indexOf(str.charAt(i))/63.0;\n"
+		"}\n"
+		"return fractions;\n"
+		"}\n";
+}
\ No newline at end of file
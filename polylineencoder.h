@@ -0,0 +1,29 @@
+#ifndef POLYLINEENCODER_H
+#define POLYLINEENCODER_H
+
+#include <string>
+#include <vector>
+
+// Compact text encodings for sending ride data to the map web page, instead of writing
+// decimal numbers. Coordinates and indecies use the google maps encoded polyline
+// algorithm (deltas between consecutive values as base 32 chunks offset into printable
+// ascii), see https://developers.google.com/maps/documentation/utilities/polylinealgorithm
+// The output can be placed inside a double quoted javascript string.
+
+namespace PolylineEncoder
+{
+	// Append a path of lat/long (deg) at 1e-5 deg precision (~1m)
+	void encodeCoords(const std::vector<double>& ltd, const std::vector<double>& lgd, std::string& encoded);
+
+	// Append a list of integers, each encoded as the difference to the previous one
+	void encodeInts(const std::vector<int>& values, std::string& encoded);
+
+	// Append a list of fractions [0.0-1.0] as one character each, at 1/63 precision
+	void encodeFractions(const std::vector<double>& fractions, std::string& encoded);
+
+	// Javascript functions to decode the above: decodeCoords(str) returns an array of
+	// google.maps.LatLng, decodeInts(str) and decodeFractions(str) return arrays of numbers
+	std::string javascriptDecoders();
+};
+
+#endif // POLYLINEENCODER_H
\ No newline at end of file
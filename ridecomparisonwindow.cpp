@@ -0,0 +1,349 @@
+#include "ridecomparisonwindow.h"
+#include "datalog.h"
+#include "dataprocessing.h"
+#include "decimatedseriesdata.h"
+#include "logdirectorysummary.h"
+#include "rideoverlay.h"
+#include "routeindex.h"
+#include "tcxparser.h"
+#include "fitparser.h"
+#include "user.h"
+#include "colours.h"
+
+#include <qwt_plot.h>
+#include <qwt_plot_curve.h>
+
+#include <QIcon.h>
+#include <QBoxLayout.h>
+#include <QComboBox.h>
+#include <QLabel.h>
+#include <QListWidget.h>
+#include <QPushButton.h>
+#include <QInputDialog.h>
+#include <QMessageBox.h>
+
+#include <algorithm>
+
+#define NUM_RIDE_COLOURS 6
+
+// Curve colours, the reference ride first
+static const QColor RIDE_COLOURS[NUM_RIDE_COLOURS] =
+{
+	QColor(Qt::black),
+	QColor(Qt::darkRed),
+	QColor(Qt::darkBlue),
+	QColor(Qt::darkGreen),
+	POWER_COLOUR,
+	QColor(Qt::darkMagenta)
+};
+
+/******************************************************/
+// Channel of a resampled ride, in the order of the channel selection
+static const std::vector<double>& resampledChannel(const ResampledRide& ride, int channel)
+{
+	switch (channel)
+	{
+	case 0: return ride._heart_rate;
+	case 1: return ride._speed;
+	case 2: return ride._alt;
+	case 3: return ride._cadence;
+	default: return ride._power;
+	}
+}
+
+/******************************************************/
+RideComparisonWindow::RideComparisonWindow(boost::shared_ptr<User> user, boost::shared_ptr<DataLog> data_log):
+QWidget(),
+_user(user)
+{
+	setWindowTitle(tr("Ride Comparison"));
+	setWindowIcon(QIcon("./resources/rideviewer_head128x128.ico"));
+
+	_tcx_parser = new TcxParser();
+	_fit_parser = new FitParser();
+
+	_log_dir_summary.reset(new LogDirectorySummary(_user->logDirectory()));
+	_log_dir_summary->readFromFile();
+
+	// The displayed ride is the reference
+	_overlay.reset(new RideOverlay());
+	_overlay->addRide(data_log);
+
+	// Create the plots
+	_plot = new QwtPlot();
+	_delta_plot = new QwtPlot();
+
+	QwtText axis_text;
+	QFont font =  _plot->axisFont(QwtPlot::xBottom);
+	font.setPointSize(8);
+	axis_text.setFont(font);
+	axis_text.setText("Delta time (s)");
+	_delta_plot->setAxisTitle(QwtPlot::yLeft,axis_text);
+
+	// Create GUI widgets
+	_channel_selection = new QComboBox();
+	_channel_selection->insertItem(0, "Heart Rate (bpm)");
+	_channel_selection->insertItem(1, "Speed (km/h)");
+	_channel_selection->insertItem(2, "Elevation (m)");
+	_channel_selection->insertItem(3, "Cadence (rpm)");
+	_channel_selection->insertItem(4, "Power (W)");
+	_channel_selection->setCurrentIndex(1);
+
+	_axis_selection = new QComboBox();
+	_axis_selection->insertItem(OVERLAY_BY_DIST, "Align by distance");
+	_axis_selection->insertItem(OVERLAY_BY_TIME, "Align by time");
+
+	_ride_list = new QListWidget();
+
+	QPushButton* add_button = new QPushButton("Add Ride...");
+	QPushButton* add_route_button = new QPushButton("Add Rides On This Route");
+	QPushButton* remove_button = new QPushButton("Remove Ride");
+
+	connect(_channel_selection, SIGNAL(currentIndexChanged(int)),this,SLOT(updatePlots()));
+	connect(_axis_selection, SIGNAL(currentIndexChanged(int)),this,SLOT(updatePlots()));
+	connect(add_button, SIGNAL(clicked()),this,SLOT(addRide()));
+	connect(add_route_button, SIGNAL(clicked()),this,SLOT(addRouteRides()));
+	connect(remove_button, SIGNAL(clicked()),this,SLOT(removeRide()));
+
+	// Layout the GUI
+	QWidget* plots = new QWidget;
+	QVBoxLayout* plot_layout = new QVBoxLayout(plots);
+	plot_layout->addWidget(_plot, 3);
+	plot_layout->addWidget(_delta_plot, 1);
+
+	QWidget* controls = new QWidget;
+	QVBoxLayout* vlayout = new QVBoxLayout(controls);
+	vlayout->addWidget(_channel_selection);
+	vlayout->addWidget(_axis_selection);
+	vlayout->addWidget(new QLabel("Rides (the first is the reference):"));
+	vlayout->addWidget(_ride_list);
+	vlayout->addWidget(add_button);
+	vlayout->addWidget(add_route_button);
+	vlayout->addWidget(remove_button);
+
+	QHBoxLayout* layout = new QHBoxLayout(this);
+	layout->addWidget(plots, 1);
+	layout->addWidget(controls);
+
+	setMinimumSize(900,500);
+	show();
+
+	populateRideList();
+	updatePlots();
+}
+
+/******************************************************/
+RideComparisonWindow::~RideComparisonWindow()
+{
+	clearCurves();
+	delete _tcx_parser;
+	delete _fit_parser;
+}
+
+/******************************************************/
+bool RideComparisonWindow::parse(const QString filename, boost::shared_ptr<DataLog> data_log)
+{
+	if (filename.contains(".fit"))
+	{
+		return _fit_parser->parse(filename, data_log);
+	}
+	else if (filename.contains(".tcx"))
+	{
+		return _tcx_parser->parse(filename, data_log);
+	}
+	else
+	{
+		return false; // unknown log type
+	}
+}
+
+/******************************************************/
+bool RideComparisonWindow::addLog(int log_index)
+{
+	const QString filename = _log_dir_summary->log(log_index)._filename;
+	if (_overlay->contains(filename))
+		return false;
+
+	boost::shared_ptr<DataLog> data_log(new DataLog);
+	if (!parse(filename, data_log))
+		return false;
+
+	// Only the new ride is resampled, the others are cached. Rides parsed here are only used
+	// through the overlay, so they are held compact
+	data_log->compact();
+	_overlay->addRide(data_log);
+	return true;
+}
+
+/******************************************************/
+void RideComparisonWindow::addRide()
+{
+	// Latest rides first
+	QStringList ride_names;
+	for (int i = _log_dir_summary->numLogs()-1; i >= 0; --i)
+	{
+		QString date = _log_dir_summary->log(i)._date;
+		date.chop(3); // remove seconds
+		ride_names.append(date + "   " + DataProcessing::kmFromMeters(_log_dir_summary->log(i)._dist) + " km");
+	}
+
+	bool ok;
+	const QString ride_name = QInputDialog::getItem(this, tr("Ride Comparison"), tr("Select Ride:"), ride_names, 0, false, &ok, 0);
+	if (!ok)
+		return;
+
+	if (!addLog(_log_dir_summary->numLogs()-1 - ride_names.indexOf(ride_name)))
+		return;
+
+	populateRideList();
+	updatePlots();
+}
+
+/******************************************************/
+void RideComparisonWindow::addRouteRides()
+{
+	if (_overlay->numRides() == 0)
+		return;
+
+	// The reference ride is parsed, so its signature does not depend on its summary. It may be a
+	// ride added here and held compact, if the first reference was removed
+	DataLog& reference = *_overlay->ride(0);
+	const bool compact = reference.isCompact();
+	if (compact)
+		reference.expand();
+	std::vector<unsigned int> reference_signature;
+	RouteIndex::signature(reference, reference_signature);
+	if (compact)
+		reference.compact();
+	if (reference_signature.empty())
+	{
+		QMessageBox::information(this, "RideViewer", "The reference ride has no GPS route.");
+		return;
+	}
+
+	RouteIndex route_index;
+	for (int i = 0; i < _log_dir_summary->numLogs(); ++i)
+		route_index.addRide(i, _log_dir_summary->log(i)._route_signature);
+
+	std::vector<int> similar;
+	route_index.similarRides(reference_signature, similar);
+
+	// Most similar rides first
+	int num_added = 0;
+	for (unsigned int i = 0; i < similar.size() && num_added < MAX_ROUTE_RIDES; ++i)
+	{
+		if (addLog(similar[i]))
+			++num_added;
+	}
+
+	populateRideList();
+	updatePlots();
+}
+
+/******************************************************/
+void RideComparisonWindow::removeRide()
+{
+	const int idx = _ride_list->currentRow();
+	if (idx < 0 || idx >= _overlay->numRides())
+		return;
+
+	// The curves point at the data of the ride
+	clearCurves();
+	_overlay->removeRide(idx);
+
+	populateRideList();
+	updatePlots();
+}
+
+/******************************************************/
+void RideComparisonWindow::populateRideList()
+{
+	_ride_list->clear();
+	for (int i = 0; i < _overlay->numRides(); ++i)
+	{
+		boost::shared_ptr<DataLog> data_log = _overlay->ride(i);
+		QListWidgetItem* item = new QListWidgetItem(
+			data_log->date().toString("yyyy/MM/dd hh:mm") + "   " + DataProcessing::kmFromMeters(data_log->totalDist()) + " km");
+		item->setForeground(RIDE_COLOURS[i % NUM_RIDE_COLOURS]);
+		_ride_list->addItem(item);
+	}
+}
+
+/******************************************************/
+void RideComparisonWindow::clearCurves()
+{
+	for (unsigned int i = 0; i < _curves.size(); ++i)
+	{
+		_curves[i]->detach();
+		delete _curves[i];
+	}
+	for (unsigned int i = 0; i < _delta_curves.size(); ++i)
+	{
+		_delta_curves[i]->detach();
+		delete _delta_curves[i];
+	}
+	_curves.clear();
+	_delta_curves.clear();
+}
+
+/******************************************************/
+void RideComparisonWindow::updatePlots()
+{
+	clearCurves();
+
+	_overlay->setAxis((OverlayAxis)_axis_selection->currentIndex());
+	const int channel = _channel_selection->currentIndex();
+
+	// Grid positions in km or min, long enough for the longest ride
+	unsigned int num_grid = 0;
+	for (int i = 0; i < _overlay->numRides(); ++i)
+		num_grid = std::max(num_grid, (unsigned int)_overlay->resampled(i)._time.size());
+
+	const double x_scale = (_overlay->axis() == OVERLAY_BY_DIST) ? _overlay->gridStep()/1000.0 : _overlay->gridStep()/60.0;
+	_x.resize(num_grid);
+	for (unsigned int j = 0; j < num_grid; ++j)
+		_x[j] = j*x_scale;
+
+	for (int i = 0; i < _overlay->numRides(); ++i)
+	{
+		const QPen pen(RIDE_COLOURS[i % NUM_RIDE_COLOURS]);
+
+		const std::vector<double>& values = resampledChannel(_overlay->resampled(i), channel);
+		QwtPlotCurve* curve = new QwtPlotCurve();
+		curve->setPen(pen);
+		curve->setRenderHint(QwtPlotItem::RenderAntialiased);
+		if (values.size() > 1)
+			curve->setData(new DecimatedSeriesData(&_x[0], &values[0], values.size(), _plot->canvas()));
+		curve->attach(_plot);
+		_curves.push_back(curve);
+
+		// The reference would be a flat line
+		const std::vector<double>& delta = _overlay->deltaTime(i);
+		if (i > 0 && delta.size() > 1)
+		{
+			QwtPlotCurve* delta_curve = new QwtPlotCurve();
+			delta_curve->setPen(pen);
+			delta_curve->setRenderHint(QwtPlotItem::RenderAntialiased);
+			delta_curve->setData(new DecimatedSeriesData(&_x[0], &delta[0], delta.size(), _delta_plot->canvas()));
+			delta_curve->attach(_delta_plot);
+			_delta_curves.push_back(delta_curve);
+		}
+	}
+
+	QwtText axis_text;
+	QFont font =  _plot->axisFont(QwtPlot::xBottom);
+	font.setPointSize(8);
+	axis_text.setFont(font);
+	axis_text.setText((_overlay->axis() == OVERLAY_BY_DIST) ? "Distance (km)" : "Time (min)");
+	_plot->setAxisTitle(QwtPlot::xBottom,axis_text);
+	_delta_plot->setAxisTitle(QwtPlot::xBottom,axis_text);
+	axis_text.setText(_channel_selection->currentText());
+	_plot->setAxisTitle(QwtPlot::yLeft,axis_text);
+
+	_plot->setAxisAutoScale(QwtPlot::xBottom);
+	_plot->setAxisAutoScale(QwtPlot::yLeft);
+	_delta_plot->setAxisAutoScale(QwtPlot::xBottom);
+	_delta_plot->setAxisAutoScale(QwtPlot::yLeft);
+	_plot->replot();
+	_delta_plot->replot();
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef RIDECOMPARISONWINDOW_H
+#define RIDECOMPARISONWINDOW_H
+
+#include <QWidget.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <vector>
+
+#define MAX_ROUTE_RIDES 4 // rides added by "Add Rides On This Route"
+
+class DataLog;
+class User;
+class TcxParser;
+class FitParser;
+class LogDirectorySummary;
+class RideOverlay;
+class QwtPlot;
+class QwtPlotCurve;
+class QComboBox;
+class QListWidget;
+
+/* Window to compare rides on the same plot. The rides are aligned by distance or time, and
+   a second plot shows the time each ride is ahead or behind the first (reference) ride. */
+
+class RideComparisonWindow : public QWidget
+{
+	Q_OBJECT
+public:
+	RideComparisonWindow(boost::shared_ptr<User> user, boost::shared_ptr<DataLog> data_log);
+	~RideComparisonWindow();
+
+private slots:
+	void addRide();
+	void addRouteRides();
+	void removeRide();
+	void updatePlots();
+
+private:
+	// Parse the given logfile, resulting data is in data_log
+	bool parse(const QString filename, boost::shared_ptr<DataLog> data_log);
+
+	// Parse and add the ride of a log index of the summary
+	bool addLog(int log_index);
+
+	// Fill the list of rides, in the colours of their curves
+	void populateRideList();
+
+	// Detach and delete the curves, they point at data of the overlay
+	void clearCurves();
+
+	boost::shared_ptr<User> _user;
+	boost::scoped_ptr<LogDirectorySummary> _log_dir_summary;
+	boost::scoped_ptr<RideOverlay> _overlay;
+
+	TcxParser* _tcx_parser;
+	FitParser* _fit_parser;
+
+	QwtPlot* _plot;
+	QwtPlot* _delta_plot;
+	std::vector<QwtPlotCurve*> _curves;
+	std::vector<QwtPlotCurve*> _delta_curves;
+	std::vector<double> _x; // grid positions in km or min, shared by the curves
+
+	QComboBox* _channel_selection;
+	QComboBox* _axis_selection;
+	QListWidget* _ride_list;
+};
+
+#endif // RIDECOMPARISONWINDOW_H
\ No newline at end of file
@@ -6,10 +6,12 @@
 #include "fitparser.h"
 #include "user.h"
 #include "logdirectorysummary.h"
-#include "latlng.h"
+#include "geokernels.h"
 #include "googlemapwindow.h"
 
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 
 #include <QDir.h>
 #include <QComboBox.h>
@@ -22,6 +24,7 @@
 #include <QStandardItemModel.h>
 
 #define PROXIMITY_THD 15.0 // meters
+#define BEARING_THD 20.0 // deg
 
 using namespace std;
 
@@ -130,22 +133,34 @@ void RideIntervalFinderWindow::findIntervals()
 	int start_index, end_index;
 	_google_map_window->getSelectedIndecies(start_index, end_index);
 
-	// Define the start and end lat/long (and the following points)
-	const LatLng start_lat_lng(_current_data_log->ltd(start_index), _current_data_log->lgd(start_index), PROXIMITY_THD);
-	const LatLng end_lat_lng(_current_data_log->ltd(end_index-1), _current_data_log->lgd(end_index-1), PROXIMITY_THD); // take -1 since we need an extra point to determine direction
+	// Define the start and end points, and the path bearing at each (from the following point)
+	std::vector<double> bearings;
+	computeBearings(*_current_data_log, bearings);
 
-	const LatLng start_lat_lng_nxt(_current_data_log->ltd(start_index+1), _current_data_log->lgd(start_index+1), PROXIMITY_THD);
-	const LatLng end_lat_lng_nxt(_current_data_log->ltd(end_index), _current_data_log->lgd(end_index), PROXIMITY_THD);
+	const int end_pt = end_index-1; // take -1 since we need an extra point to determine direction
+	const double start_ltd_rad = _current_data_log->ltdRad()[start_index];
+	const double start_lgd_rad = _current_data_log->lgdRad()[start_index];
+	const double start_bearing = bearings[start_index];
+	const double end_ltd_rad = _current_data_log->ltdRad()[end_pt];
+	const double end_lgd_rad = _current_data_log->lgdRad()[end_pt];
+	const double end_bearing = bearings[end_pt];
+
+	std::vector<double> log_bearings;
+	std::vector<double> dist_sq_to_start;
+	std::vector<double> dist_sq_to_end;
+
+	// Logs within the user selected range
+	const std::pair<int, int> range = _log_dir_summary->logsInRange(_date_selector_widget->minDate(), _date_selector_widget->maxDate());
 
 	// Create a small progress bar
-	QProgressDialog load_progress("Loading log:", "Cancel load", 0, _log_dir_summary->numLogs()-1, this);
+	QProgressDialog load_progress("Loading log:", "Cancel load", range.first, range.second-1, this);
 	load_progress.setWindowModality(Qt::WindowModal);
 	load_progress.setMinimumDuration(0); //msec
 	load_progress.setWindowTitle("RideIntervalFinder");
 
 	// Load new log files in the directory
 	QStandardItem *parent_item = _model->invisibleRootItem();
-	for (int i=0; i < _log_dir_summary->numLogs(); ++i)
+	for (int i=range.first; i < range.second; ++i)
 	{
 		const QString filename = _log_dir_summary->log(i)._filename;
 
@@ -154,56 +169,62 @@ void RideIntervalFinderWindow::findIntervals()
 		if (load_progress.wasCanceled())
 			break;
 
-		// Check that the date is within the user selected range
-		const QDate date = _log_dir_summary->log(i).date();
-		if (date >= _date_selector_widget->minDate() && date <= _date_selector_widget->maxDate())
-		{
-			boost::shared_ptr<DataLog> data_log(new DataLog);	
-			if (parse(filename, data_log)) // if the log files is successfully parsed
-			{	
-				if (data_log->lgdValid() && data_log->ltdValid()) // if we have gps data in this log
+		boost::shared_ptr<DataLog> data_log(new DataLog);	
+		if (parse(filename, data_log)) // if the log files is successfully parsed
+		{	
+			if (data_log->lgdValid() && data_log->ltdValid()) // if we have gps data in this log
+			{
+				// Squared distances from every point to the start and end points, in one pass each,
+				// in the east/north frame of this log
+				const int num_points = data_log->numPoints();
+				computeBearings(*data_log, log_bearings);
+				double start_east, start_north, end_east, end_north;
+				data_log->toLocal(start_ltd_rad, start_lgd_rad, start_east, start_north);
+				data_log->toLocal(end_ltd_rad, end_lgd_rad, end_east, end_north);
+				dist_sq_to_start.resize(num_points);
+				dist_sq_to_end.resize(num_points);
+				GeoKernels::localDistancesSq(start_east, start_north,
+					&data_log->east()[0], &data_log->north()[0], num_points, &dist_sq_to_start[0]);
+				GeoKernels::localDistancesSq(end_east, end_north,
+					&data_log->east()[0], &data_log->north()[0], num_points, &dist_sq_to_end[0]);
+
+				bool start_found = false;
+				bool end_found = false;
+				bool route_verified = false;
+
+				int found_start_index, found_end_index;
+
+				const int increment = 1;
+				for (int pt=0; pt < num_points-increment; pt+=increment)
 				{
-					bool start_found = false;
-					bool end_found = false;
-					bool route_verified = false;
-
-					int found_start_index, found_end_index;
-
-					const int increment = 1;
-					for (int pt=0; pt < data_log->numPoints()-increment; pt+=increment)
+					// First check if the start point matches
+					if (!start_found)
 					{
-						const LatLng lat_lng(data_log->ltd(pt), data_log->lgd(pt), PROXIMITY_THD);
-						const LatLng lat_lng_nxt(data_log->ltd(pt+1), data_log->lgd(pt+1), PROXIMITY_THD);
-					
-						// First check if the start point matches
-						if (!start_found)
-						{
-							start_found = arePointsEqual(lat_lng, lat_lng_nxt, start_lat_lng, start_lat_lng_nxt);
-							if (start_found)
-								found_start_index = pt;
-						}
+						start_found = arePointsEqual(dist_sq_to_start[pt], log_bearings[pt], start_bearing);
 						if (start_found)
-						{
-							end_found = arePointsEqual(lat_lng, lat_lng_nxt, end_lat_lng, end_lat_lng_nxt);
-							if (end_found)
-								found_end_index = pt;
-						}
+							found_start_index = pt;
+					}
+					if (start_found)
+					{
+						end_found = arePointsEqual(dist_sq_to_end[pt], log_bearings[pt], end_bearing);
+						if (end_found)
+							found_end_index = pt;
+					}
 
-						if (start_found && end_found)
+					if (start_found && end_found)
+					{
+						if (verifyRoute(*_current_data_log, bearings, start_index, end_index,
+										*data_log, log_bearings, found_start_index, found_end_index))
 						{
-							if (verifyRoute(*_current_data_log, start_index, end_index,
-											*data_log, found_start_index, found_end_index))
-							{
-								// Populate the model view
-								QList<QStandardItem*> interval_list;
-								populateIntervalData(interval_list, *data_log, found_start_index, found_end_index);
-								parent_item->appendRow(interval_list);
-
-								_tree->setModel(_model);
-
-								start_found = false;
-								end_found = false;
-							}
+							// Populate the model view
+							QList<QStandardItem*> interval_list;
+							populateIntervalData(interval_list, *data_log, found_start_index, found_end_index);
+							parent_item->appendRow(interval_list);
+
+							_tree->setModel(_model);
+
+							start_found = false;
+							end_found = false;
 						}
 					}
 				}
@@ -258,46 +279,47 @@ void RideIntervalFinderWindow::populateIntervalData(
 }
 
 /******************************************************/
-bool RideIntervalFinderWindow::arePointsEqual(
-	const LatLng& pt_a, const LatLng& pt_a_nxt,
-	const LatLng& pt_b, const LatLng& pt_b_nxt) const
+void RideIntervalFinderWindow::computeBearings(DataLog& data_log, std::vector<double>& bearings) const
 {
-	bool equal = false;
-	if (pt_a.approxEqual(pt_b)) // perform quick check if the points are remotely close
-	{
-		if (pt_a == pt_b) // accurately check that points are the same
-		{
-			const double bearing_threshold = 20.0; // deg
-			if ( abs(pt_a.angle(pt_a_nxt) - pt_b.angle(pt_b_nxt)) < bearing_threshold ) // angle is less than a threshold
-			{
-				equal = true;
-			}
-		}
-	}
-	return equal;
+	data_log.computeGeoColumns();
+	bearings.resize(data_log.numPoints());
+	if (data_log.numPoints() > 0)
+		GeoKernels::bearings(&data_log.ltdRad()[0], &data_log.lgdRad()[0], &data_log.cosLtd()[0], data_log.numPoints(), &bearings[0]);
+}
+
+/******************************************************/
+bool RideIntervalFinderWindow::arePointsEqual(double dist_sq, double bearing_a, double bearing_b) const
+{
+	return dist_sq < PROXIMITY_THD*PROXIMITY_THD && fabs(bearing_a - bearing_b) < BEARING_THD;
 }
 
 /******************************************************/
 bool RideIntervalFinderWindow::verifyRoute(
-	DataLog& log1, int start_index1, int end_index1,
-	DataLog& log2, int start_index2, int end_index2) const
+	DataLog& log1, const std::vector<double>& bearings1, int start_index1, int end_index1,
+	DataLog& log2, const std::vector<double>& bearings2, int start_index2, int end_index2) const
 {
 	const int num_verification_pts = 10; // we use this many points along route to verify them
 
+	// Squared distances from a verification point to the found route in log2, in the east/north
+	// frame of log2
+	const int num_pts2 = end_index2 - start_index2;
+	if (num_pts2 <= 0)
+		return false;
+	std::vector<double> dist_sq(num_pts2);
+
 	// We select points evenly along route
 	int pts_verified = 0;
-	const int increment = (end_index1 - start_index1)/num_verification_pts;
+	const int increment = std::max((end_index1 - start_index1)/num_verification_pts, 1);
 	for (int pt1 = start_index1; pt1 < end_index1; pt1+=increment)
 	{
-		const LatLng lat_lng1(log1.ltd(pt1), log1.lgd(pt1), PROXIMITY_THD);
-		const LatLng lat_lng_nxt1(log1.ltd(pt1+1), log1.lgd(pt1+1), PROXIMITY_THD);
-		
-		for (int pt2 = start_index2; pt2 < end_index2; ++pt2)
-		{
-			const LatLng lat_lng2(log2.ltd(pt2), log2.lgd(pt2), PROXIMITY_THD);
-			const LatLng lat_lng_nxt2(log2.ltd(pt2+1), log2.lgd(pt2+1), PROXIMITY_THD);
+		double east, north;
+		log2.toLocal(log1.ltdRad()[pt1], log1.lgdRad()[pt1], east, north);
+		GeoKernels::localDistancesSq(east, north,
+			&log2.east()[start_index2], &log2.north()[start_index2], num_pts2, &dist_sq[0]);
 
-			if (arePointsEqual(lat_lng1, lat_lng_nxt1, lat_lng2, lat_lng_nxt2))
+		for (int i = 0; i < num_pts2; ++i)
+		{
+			if (arePointsEqual(dist_sq[i], bearings1[pt1], bearings2[start_index2 + i]))
 			{
 				pts_verified++;
 				break;
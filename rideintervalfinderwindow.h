@@ -6,13 +6,13 @@
 #include <QMap.h>
 
 #include <boost/shared_ptr.hpp>
+#include <vector>
 
 class DataLog;
 class TcxParser;
 class FitParser;
 class DateSelectorWidget;
 class User;
-class LatLng;
 class GoogleMapWindow;
 class LogDirectorySummary;
 class QStandardItemModel;
@@ -48,17 +48,18 @@ class RideIntervalFinderWindow : public QWidget
 		DataLog& data_log, 
 		int found_start_index, int found_end_index) const;
 
-	// Determine if 2 points on a path are equal
-	// pt_a and pt_b are points of interest
-	// pt_a_nxt and pt_b_nxt are the following points (for angle estimation)
-	bool arePointsEqual(
-		const LatLng& pt_a, const LatLng& pt_a_nxt,
-		const LatLng& pt_b, const LatLng& pt_b_nxt) const;
+	// Determine if 2 points on a path are equal, given the squared distance between them
+	// and the bearing of each path at the points
+	bool arePointsEqual(double dist_sq, double bearing_a, double bearing_b) const;
 
 	// Verify the route defined between 2 points. Return true if verifed, false otherwise
+	// bearings1 and bearings2 are the path bearings of each log (see GeoKernels::bearings)
 	bool verifyRoute(
-		DataLog& log1, int start_index1, int end_index1,
-		DataLog& log2, int start_index2, int end_index2) const;
+		DataLog& log1, const std::vector<double>& bearings1, int start_index1, int end_index1,
+		DataLog& log2, const std::vector<double>& bearings2, int start_index2, int end_index2) const;
+
+	// Compute the geo columns and the path bearings of a log
+	void computeBearings(DataLog& data_log, std::vector<double>& bearings) const;
 
 	TcxParser* _tcx_parser;
 	FitParser* _fit_parser;
@@ -0,0 +1,260 @@
+#include "rideoverlay.h"
+#include "datalog.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+/****************************************/
+// Step of the grid of an axis
+static double axisStep(OverlayAxis axis)
+{
+	return (axis == OVERLAY_BY_DIST) ? OVERLAY_DIST_STEP : OVERLAY_TIME_STEP;
+}
+
+/****************************************/
+RideOverlay::RideOverlay():
+_rides(),
+_axis(OVERLAY_BY_DIST)
+{}
+
+/****************************************/
+RideOverlay::~RideOverlay()
+{}
+
+/****************************************/
+void RideOverlay::setAxis(OverlayAxis axis)
+{
+	_axis = axis;
+}
+
+/****************************************/
+OverlayAxis RideOverlay::axis() const
+{
+	return _axis;
+}
+
+/****************************************/
+double RideOverlay::gridStep() const
+{
+	return axisStep(_axis);
+}
+
+/****************************************/
+void RideOverlay::addRide(boost::shared_ptr<DataLog> data_log)
+{
+	if (data_log && !contains(data_log->filename()))
+		_rides.push_back(data_log);
+}
+
+/****************************************/
+void RideOverlay::removeRide(int idx)
+{
+	assert(idx >= 0 && idx < numRides());
+
+	DataLog* data_log = _rides[idx].get();
+	for (int a=0; a < NUM_OVERLAY_AXES; ++a)
+	{
+		_resampled[a].remove(data_log);
+		_delta_time[a].remove(data_log);
+
+		// The deltas of all the rides are relative to the reference
+		if (idx == 0)
+			_delta_time[a].clear();
+	}
+	_rides.erase(_rides.begin() + idx);
+}
+
+/****************************************/
+void RideOverlay::clear()
+{
+	_rides.clear();
+	for (int a=0; a < NUM_OVERLAY_AXES; ++a)
+	{
+		_resampled[a].clear();
+		_delta_time[a].clear();
+	}
+}
+
+/****************************************/
+int RideOverlay::numRides() const
+{
+	return (int)_rides.size();
+}
+
+/****************************************/
+boost::shared_ptr<DataLog> RideOverlay::ride(int idx) const
+{
+	assert(idx >= 0 && idx < numRides());
+	return _rides[idx];
+}
+
+/****************************************/
+bool RideOverlay::contains(const QString& filename) const
+{
+	for (unsigned int i=0; i < _rides.size(); ++i)
+	{
+		if (_rides[i]->filename() == filename)
+			return true;
+	}
+	return false;
+}
+
+/****************************************/
+const ResampledRide& RideOverlay::resampled(int idx)
+{
+	return resampled(idx, _axis);
+}
+
+/****************************************/
+const ResampledRide& RideOverlay::resampled(int idx, OverlayAxis axis)
+{
+	assert(idx >= 0 && idx < numRides());
+
+	DataLog* data_log = _rides[idx].get();
+	QMap<DataLog*, ResampledRide>::iterator it = _resampled[axis].find(data_log);
+	if (it == _resampled[axis].end())
+	{
+		it = _resampled[axis].insert(data_log, ResampledRide());
+
+		// Rides held compact are only expanded while they are resampled
+		const bool compact = data_log->isCompact();
+		if (compact)
+			data_log->expand();
+		resample(*data_log, axis, it.value());
+		if (compact)
+			data_log->compact();
+	}
+	return it.value();
+}
+
+/****************************************/
+const std::vector<double>& RideOverlay::deltaTime(int idx)
+{
+	assert(idx >= 0 && idx < numRides());
+
+	DataLog* data_log = _rides[idx].get();
+	QMap<DataLog*, std::vector<double> >::iterator it = _delta_time[_axis].find(data_log);
+	if (it != _delta_time[_axis].end())
+		return it.value();
+
+	std::vector<double>& delta = _delta_time[_axis][data_log];
+	const ResampledRide& reference = resampled(0, OVERLAY_BY_DIST);
+	const ResampledRide& ride = resampled(idx, _axis);
+	if (_axis == OVERLAY_BY_DIST)
+	{
+		// Both rides are on the same distance grid
+		const int n = (int)std::min(reference._time.size(), ride._time.size());
+		delta.resize(n);
+		for (int i=0; i < n; ++i)
+			delta[i] = ride._time[i] - reference._time[i];
+	}
+	else
+	{
+		// Look up the time of the reference at the distance of the ride
+		const double reference_dist = reference._time.empty() ? 0.0 : (reference._time.size()-1)*OVERLAY_DIST_STEP;
+		delta.reserve(ride._dist.size());
+		for (unsigned int i=0; i < ride._dist.size() && ride._dist[i] <= reference_dist; ++i)
+			delta.push_back(ride._time[i] - gridValue(reference._time, OVERLAY_DIST_STEP, ride._dist[i]));
+	}
+	return delta;
+}
+
+/****************************************/
+int RideOverlay::numGridPoints(const double* x, int n, double step)
+{
+	if (n < 2)
+		return 0;
+	return (int)floor((x[n-1] - x[0])/step) + 1;
+}
+
+/****************************************/
+void RideOverlay::gridPositions(const double* x, int n, double step, int num_grid, int* seg, double* frac)
+{
+	assert(n >= 2);
+
+	// The grid and x are both sorted, so each segment of x is visited once
+	int j = 0;
+	for (int i=0; i < num_grid; ++i)
+	{
+		const double g = x[0] + i*step;
+		while (j < n-2 && x[j+1] <= g)
+			++j;
+
+		const double dx = x[j+1] - x[j];
+		seg[i] = j;
+		frac[i] = (dx > 0.0) ? std::min(std::max((g - x[j])/dx, 0.0), 1.0) : 0.0;
+	}
+}
+
+/****************************************/
+void RideOverlay::interpolate(const double* y, const int* seg, const double* frac, int num_grid, double* out)
+{
+	for (int i=0; i < num_grid; ++i)
+	{
+		const double y0 = y[seg[i]];
+		const double y1 = y[seg[i]+1];
+		out[i] = y0 + frac[i]*(y1 - y0);
+	}
+}
+
+/****************************************/
+void RideOverlay::resample(DataLog& data_log, OverlayAxis axis, ResampledRide& resampled)
+{
+	const int n = data_log.numPoints();
+	if (n < 2 || (axis == OVERLAY_BY_DIST && !data_log.distValid()))
+		return;
+
+	const double* x = (axis == OVERLAY_BY_DIST) ? &data_log.dist()[0] : &data_log.time()[0];
+	const int num_grid = numGridPoints(x, n, axisStep(axis));
+
+	// Grid positions are shared by all the channels
+	std::vector<int> seg(num_grid);
+	std::vector<double> frac(num_grid);
+	gridPositions(x, n, axisStep(axis), num_grid, &seg[0], &frac[0]);
+
+	resampled._time.resize(num_grid);
+	interpolate(&data_log.time()[0], &seg[0], &frac[0], num_grid, &resampled._time[0]);
+	resampled._dist.resize(num_grid);
+	interpolate(&data_log.dist()[0], &seg[0], &frac[0], num_grid, &resampled._dist[0]);
+
+	const double start_time = data_log.time(0);
+	const double start_dist = data_log.dist(0);
+	for (int i=0; i < num_grid; ++i)
+	{
+		resampled._time[i] -= start_time;
+		resampled._dist[i] -= start_dist;
+	}
+
+	// Channels with no data are left at 0
+	resampled._heart_rate.assign(num_grid, 0.0);
+	if (data_log.heartRateValid())
+		interpolate(&data_log.heartRate()[0], &seg[0], &frac[0], num_grid, &resampled._heart_rate[0]);
+	resampled._speed.assign(num_grid, 0.0);
+	if (data_log.speedValid())
+		interpolate(&data_log.speed()[0], &seg[0], &frac[0], num_grid, &resampled._speed[0]);
+	resampled._alt.assign(num_grid, 0.0);
+	if (data_log.altValid())
+		interpolate(&data_log.alt()[0], &seg[0], &frac[0], num_grid, &resampled._alt[0]);
+	resampled._cadence.assign(num_grid, 0.0);
+	if (data_log.cadenceValid())
+		interpolate(&data_log.cadence()[0], &seg[0], &frac[0], num_grid, &resampled._cadence[0]);
+	resampled._power.assign(num_grid, 0.0);
+	if (data_log.powerValid())
+		interpolate(&data_log.power()[0], &seg[0], &frac[0], num_grid, &resampled._power[0]);
+}
+
+/****************************************/
+double RideOverlay::gridValue(const std::vector<double>& values, double step, double x)
+{
+	if (values.empty())
+		return 0.0;
+
+	const double p = x/step;
+	const int i = (int)floor(p);
+	if (i < 0)
+		return values.front();
+	if (i >= (int)values.size()-1)
+		return values.back();
+	return values[i] + (p - i)*(values[i+1] - values[i]);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef RIDEOVERLAY_H
+#define RIDEOVERLAY_H
+
+#include <QMap.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#define OVERLAY_DIST_STEP 10.0 // m, grid spacing when rides are aligned by distance
+#define OVERLAY_TIME_STEP 1.0 // sec, grid spacing when rides are aligned by time
+
+class DataLog;
+
+// Axis the rides of an overlay are aligned on
+enum OverlayAxis
+{
+	OVERLAY_BY_DIST = 0,
+	OVERLAY_BY_TIME,
+	NUM_OVERLAY_AXES
+};
+
+/**********************************/
+// Channels of a ride resampled onto a uniform grid starting at the start of the ride
+struct ResampledRide
+{
+	std::vector<double> _time; // sec since the start
+	std::vector<double> _dist; // m since the start
+	std::vector<double> _heart_rate;
+	std::vector<double> _speed;
+	std::vector<double> _alt;
+	std::vector<double> _cadence;
+	std::vector<double> _power;
+};
+
+/* Class to compare several rides by resampling them onto a common distance or time grid,
+   so point i of every ride is at the same distance (or time) from its start. The first
+   ride is the reference, and the delta time of the other rides shows how far ahead or
+   behind the reference they are (the "ghost").
+   Resampled rides are kept for both axes, so adding a ride or switching the axis only
+   resamples what has not been resampled before. */
+
+class RideOverlay
+ {
+ public:
+	RideOverlay();
+	~RideOverlay();
+
+	void setAxis(OverlayAxis axis);
+	OverlayAxis axis() const;
+	double gridStep() const; // m or sec, of the current axis
+
+	// Add a ride, the first ride is the reference
+	void addRide(boost::shared_ptr<DataLog> data_log);
+	void removeRide(int idx);
+	void clear();
+
+	int numRides() const;
+	boost::shared_ptr<DataLog> ride(int idx) const;
+	bool contains(const QString& filename) const;
+
+	// Channels of a ride on the grid of the current axis (point i at i*gridStep())
+	const ResampledRide& resampled(int idx);
+
+	// Time of a ride minus the time of the reference at the same distance, on the grid of the
+	// current axis. Positive when the ride is behind the reference. Ends where either ride ends
+	const std::vector<double>& deltaTime(int idx);
+
+	// Resample y(x) onto the grid x[0] + i*step (i < num_grid) by linear interpolation. x must be
+	// non-decreasing. The grid positions are found by merging the grid with x, then every channel
+	// is interpolated from those positions in a branch free loop
+	static int numGridPoints(const double* x, int n, double step);
+	static void gridPositions(const double* x, int n, double step, int num_grid, int* seg, double* frac);
+	static void interpolate(const double* y, const int* seg, const double* frac, int num_grid, double* out);
+
+ private:
+	// Resample a ride onto the grid of an axis
+	static void resample(DataLog& data_log, OverlayAxis axis, ResampledRide& resampled);
+
+	// Value of a uniform grid at a position, clamped to the ends of the grid
+	static double gridValue(const std::vector<double>& values, double step, double x);
+
+	const ResampledRide& resampled(int idx, OverlayAxis axis);
+
+	std::vector<boost::shared_ptr<DataLog> > _rides;
+	OverlayAxis _axis;
+
+	// Cached results of the rides in the overlay
+	QMap<DataLog*, ResampledRide> _resampled[NUM_OVERLAY_AXES];
+	QMap<DataLog*, std::vector<double> > _delta_time[NUM_OVERLAY_AXES]; // relative to the current reference
+ };
+
+#endif // RIDEOVERLAY_H
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "fitparser.h"
 #include "dataprocessing.h"
 #include "logdirectorysummary.h"
+#include "derivedstores.h"
+#include "routeindex.h"
 #include "user.h"
 
 #include <QTreeView.h>
@@ -12,14 +14,18 @@
 #include <QProgressDialog.h>
 #include <QBoxLayout.h>
 #include <QLabel.h>
+#include <QCheckBox.h>
 #include <QMessageBox.h>
 
 #include <iostream>
+#include <algorithm>
 
 /******************************************************/
 RideSelectionWindow::RideSelectionWindow():
 _current_data_log(),
-_log_dir_summary()
+_log_dir_summary(),
+_parse_time(0.0),
+_post_process_time(0.0)
 {
 	// Create dummy model with just the headers
 	QStandardItemModel* model = new QStandardItemModel;
@@ -40,11 +46,16 @@ _log_dir_summary()
 	_head_label->setTextFormat(Qt::RichText);
 	_head_label->setText("<b>Ride Selector</b>");
 
+	// Option to show rides grouped by the route ridden
+	_group_by_route_box = new QCheckBox("Group by route");
+	connect(_group_by_route_box, SIGNAL(stateChanged(int)),this,SLOT(groupByRouteChanged()));
+
 	QVBoxLayout* layout = new QVBoxLayout();
 	layout->addWidget(_head_label);
 	layout->addWidget(_tree);
+	layout->addWidget(_group_by_route_box);
 	setLayout(layout);
-	setFixedSize(270,290);
+	setFixedSize(270,315);
 
 	// Create parser and setup log directory summary
 	_tcx_parser = new TcxParser();
@@ -65,7 +76,8 @@ void RideSelectionWindow::formatTreeView()
 	_tree->setColumnWidth(0,123);
 	_tree->setColumnWidth(1,60);
 	_tree->setColumnWidth(2,60);
-	_tree->sortByColumn(0,Qt::DescendingOrder);
+	if (!_group_by_route_box->isChecked()) // routes are already ordered by number of rides
+		_tree->sortByColumn(0,Qt::DescendingOrder);
 	_tree->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 }
 
@@ -92,6 +104,18 @@ void RideSelectionWindow::setUser(boost::shared_ptr<User> user)
 		QFileInfo file(_log_dir_summary->log(j)._filename);
 		filenames.removeAll(file.fileName());
 	}
+	for (int i=0; i < filenames.size(); ++i)
+		filenames[i] = log_directory.path() + "/" + filenames[i];
+
+	// Logs summarised by an earlier version have no aggregates or route signature, and logs with HR
+	// zone times of other zones, so parse them again too
+	const int num_new_logs = filenames.size();
+	filenames << _log_dir_summary->logsToUpdate(*user);
+	const int num_summary_logs = filenames.size();
+
+	// And logs missing from the stores which need the parsed ride
+	filenames << DerivedStores::logsToUpdate(*_log_dir_summary);
+	filenames.removeDuplicates();
 
 	// Create a small progress bar
 	QProgressDialog load_progress("Registering new log:", "Cancel", 0, filenames.size()-1, this);
@@ -99,28 +123,50 @@ void RideSelectionWindow::setUser(boost::shared_ptr<User> user)
 	load_progress.setMinimumDuration(0); //msec
 	load_progress.setWindowTitle("RideViewer");
 
-	// Load new log files in the directory
-	std::vector<boost::shared_ptr<DataLog> > data_logs;
+	// Load the new and outdated log files one at a time, adding each to the summary and to the
+	// stores derived from the rides (so the other windows do not need to parse them) as soon as
+	// it is parsed, so only one parsed ride is held at once. The parse and post-process stages
+	// are timed
+	boost::scoped_ptr<DerivedStores> derived_stores;
+	if (filenames.size() > 0)
+		derived_stores.reset(new DerivedStores(*_log_dir_summary, *user));
+	_parse_time = 0.0;
+	_post_process_time = 0.0;
+	int num_parsed_logs = 0;
+	bool canceled = false;
 	for (int i=0; i < filenames.size(); ++i)
 	{
 		boost::shared_ptr<DataLog> data_log(new DataLog);
-		const QString filename_with_path = log_directory.path() + "/" + filenames[i];
+		const QString& filename_with_path = filenames[i];
 		
 		if (parse(filename_with_path, data_log))
 		{	
-			data_logs.push_back(data_log);
-			_current_data_log = data_log;
+			if (i < num_summary_logs)
+				_log_dir_summary->addLogsToSummary(std::vector<boost::shared_ptr<DataLog> >(1, data_log), *user);
+			derived_stores->addRide(*data_log);
+			if (i < num_new_logs)
+				_current_data_log = data_log;
+			++num_parsed_logs;
 		}
 
 		load_progress.setValue(i);
-		load_progress.setLabelText("Registering new log: " + filename_with_path);
+		load_progress.setLabelText((i < num_new_logs ? "Registering new log: " : "Updating log: ") + filename_with_path);
 		if (load_progress.wasCanceled())
+		{
+			canceled = true;
 			break;
+		}
 	}
+	if (num_parsed_logs > 0)
+		std::cout << "Parsed " << num_parsed_logs << " logs: " << _parse_time << " ms parsing, " << _post_process_time << " ms post-processing" << std::endl;
 
-	// Add the newly read rides to the summary
-	_log_dir_summary->addLogsToSummary(data_logs);
+	// Write the summary, then the stores which purge the rides no longer in it. The HR zone
+	// times are only up to date once every log to update has been parsed
+	if (!canceled)
+		_log_dir_summary->setHrZones(*user);
 	_log_dir_summary->writeToFile();
+	if (num_parsed_logs > 0)
+		derived_stores->writeToFile();
 
 	// Display information about the user 
 	_head_label->setText("<b>Ride Selector For: </b>" + user->name() + " (" + QString::number(_log_dir_summary->numLogs()) + " rides)");
@@ -128,34 +174,47 @@ void RideSelectionWindow::setUser(boost::shared_ptr<User> user)
 	populateTableWithRides();
 }
 
+/******************************************************/
+void RideSelectionWindow::createRideRow(int log_index, QList<QStandardItem*>& ride_list) const
+{
+	// Data and time
+	QString date = _log_dir_summary->log(log_index)._date;
+	date.chop(3); // remove seconds
+	QStandardItem *ride_name = new QStandardItem(date);
+	ride_name->setFlags(ride_name->flags() & ~Qt::ItemIsEditable);
+
+	// Ride time length
+	QStandardItem *ride_time = new QStandardItem(DataProcessing::minsFromSecs(_log_dir_summary->log(log_index)._time));
+	ride_time->setFlags(ride_time->flags() & ~Qt::ItemIsEditable);
+
+	// Ride distance
+	QStandardItem *ride_dist = new QStandardItem(DataProcessing::kmFromMeters(_log_dir_summary->log(log_index)._dist));
+	ride_dist->setFlags(ride_dist->flags() & ~Qt::ItemIsEditable);
+
+	// Index of ride in vector of all rides
+	QStandardItem *ride_index = new QStandardItem(QString::number(log_index));
+
+	ride_list << ride_name << ride_time << ride_dist << ride_index;
+}
+
 /******************************************************/
 void RideSelectionWindow::populateTableWithRides()
 {
+	if (_group_by_route_box->isChecked())
+	{
+		populateTableWithRoutes();
+		return;
+	}
+
 	_model = new QStandardItemModel;
 	
 	QStandardItem *parent_item = _model->invisibleRootItem();
 	for (int i = 0; i < _log_dir_summary->numLogs(); ++i) 
 	{
-		// Data and time
-		QString date = _log_dir_summary->log(i)._date;
-		date.chop(3); // remove seconds
-		QStandardItem *ride_name = new QStandardItem(date);
-		ride_name->setFlags(ride_name->flags() & ~Qt::ItemIsEditable);
-
-		// Ride time length
-		QStandardItem *ride_time = new QStandardItem(DataProcessing::minsFromSecs(_log_dir_summary->log(i)._time));
-		ride_time->setFlags(ride_time->flags() & ~Qt::ItemIsEditable);
-
-		// Ride distance
-		QStandardItem *ride_dist = new QStandardItem(DataProcessing::kmFromMeters(_log_dir_summary->log(i)._dist));
-		ride_dist->setFlags(ride_dist->flags() & ~Qt::ItemIsEditable);
-
-		// Index of ride in vector of all rides
-		QStandardItem *ride_index = new QStandardItem(QString::number(i));
-
 		QList<QStandardItem*> ride_list;
-		ride_list << ride_name << ride_time << ride_dist << ride_index;
+		createRideRow(i, ride_list);
 		parent_item->appendRow(ride_list);
+		QStandardItem *ride_name = ride_list.front();
 
 		if (_log_dir_summary->log(i)._laps.size() > 1) // all rides are 1 lap, so only show laps for rides with > 1 lap
 		{
@@ -199,11 +258,102 @@ void RideSelectionWindow::populateTableWithRides()
 	_tree->setModel(_model);
 	formatTreeView();
 	
-	connect(_tree, SIGNAL(clicked(const QModelIndex&)),this,SLOT(rideSelected(const QModelIndex&)));
+	connect(_tree, SIGNAL(clicked(const QModelIndex&)),this,SLOT(rideSelected(const QModelIndex&)), Qt::UniqueConnection);
 	_tree->setCurrentIndex(_model->index(0,0));
 	rideSelected(_model->index(0,0)); // display first ride
 }
 
+/******************************************************/
+// Order log indecies by date, latest first
+static bool laterLog(const std::pair<QString, int>& log1, const std::pair<QString, int>& log2)
+{
+	return log1.first > log2.first;
+}
+
+/******************************************************/
+void RideSelectionWindow::populateTableWithRoutes()
+{
+	_model = new QStandardItemModel;
+
+	// Group the rides by route with the signatures stored in the summary
+	RouteIndex route_index;
+	for (int i = 0; i < _log_dir_summary->numLogs(); ++i)
+		route_index.addRide(i, _log_dir_summary->log(i)._route_signature);
+
+	std::vector<std::vector<int> > routes;
+	route_index.routes(routes);
+
+	// Rides on no route are listed last
+	std::vector<bool> on_route(_log_dir_summary->numLogs(), false);
+	for (unsigned int r = 0; r < routes.size(); ++r)
+		for (unsigned int j = 0; j < routes[r].size(); ++j)
+			on_route[routes[r][j]] = true;
+	std::vector<int> other_rides;
+	for (int i = 0; i < _log_dir_summary->numLogs(); ++i)
+		if (!on_route[i])
+			other_rides.push_back(i);
+	routes.push_back(other_rides);
+
+	QStandardItem *parent_item = _model->invisibleRootItem();
+	for (unsigned int r = 0; r < routes.size(); ++r)
+	{
+		if (routes[r].empty())
+			continue;
+
+		// Latest ride first within a route
+		std::vector<std::pair<QString, int> > dated_rides;
+		double total_dist = 0.0;
+		for (unsigned int j = 0; j < routes[r].size(); ++j)
+		{
+			dated_rides.push_back(std::make_pair(_log_dir_summary->log(routes[r][j])._date, routes[r][j]));
+			total_dist += _log_dir_summary->log(routes[r][j])._dist;
+		}
+		std::sort(dated_rides.begin(), dated_rides.end(), laterLog);
+
+		// Route row, showing the number of rides and mean distance
+		const bool other = (r == routes.size()-1);
+		QStandardItem *route_name = new QStandardItem(
+			(other ? QString("Other rides") : "Route " + QString::number(r+1)) + " (" + QString::number(routes[r].size()) + ")");
+		route_name->setFlags(route_name->flags() & ~Qt::ItemIsEditable);
+		QStandardItem *route_time = new QStandardItem("");
+		route_time->setFlags(route_time->flags() & ~Qt::ItemIsEditable);
+		QStandardItem *route_dist = new QStandardItem(other ? QString("") : DataProcessing::kmFromMeters(total_dist/routes[r].size()));
+		route_dist->setFlags(route_dist->flags() & ~Qt::ItemIsEditable);
+		QStandardItem *route_index = new QStandardItem("");
+
+		QList<QStandardItem*> route_list;
+		route_list << route_name << route_time << route_dist << route_index;
+		parent_item->appendRow(route_list);
+
+		for (unsigned int j = 0; j < dated_rides.size(); ++j)
+		{
+			QList<QStandardItem*> ride_list;
+			createRideRow(dated_rides[j].second, ride_list);
+			route_name->appendRow(ride_list);
+		}
+	}
+
+	QStandardItem* header0 = new QStandardItem(QString("Route / Date"));
+	QStandardItem* header1 = new QStandardItem(QString("Time (min)"));
+	QStandardItem* header2 = new QStandardItem(QString("Dist (km)"));
+	_model->setHorizontalHeaderItem(0,header0);
+	_model->setHorizontalHeaderItem(1,header1);
+	_model->setHorizontalHeaderItem(2,header2);
+
+	_tree->setModel(_model);
+	formatTreeView();
+
+	connect(_tree, SIGNAL(clicked(const QModelIndex&)),this,SLOT(rideSelected(const QModelIndex&)), Qt::UniqueConnection);
+	_tree->expand(_model->index(0,0));
+}
+
+/******************************************************/
+void RideSelectionWindow::groupByRouteChanged()
+{
+	if (_log_dir_summary)
+		populateTableWithRides();
+}
+
 /******************************************************/
 void RideSelectionWindow::refresh()
 {
@@ -223,7 +373,16 @@ boost::shared_ptr<DataLog> RideSelectionWindow::currentDataLog()
 /******************************************************/
 void RideSelectionWindow::rideSelected(const QModelIndex& index)
 {
-	if (index.parent() == QModelIndex()) // user selected the entire ride
+	if (_group_by_route_box->isChecked()) // rides are the children of the route rows
+	{
+		if (index.parent() != QModelIndex())
+		{
+			QStandardItem* item = _model->itemFromIndex(index.sibling(index.row(),3)); // 4th element is data log index (not displayed)
+			if (item)
+				selectRide(item->text().toInt());
+		}
+	}
+	else if (index.parent() == QModelIndex()) // user selected the entire ride
 	{
 		// Get the item which represents the index
 		QStandardItem* item = _model->item(index.row(),3); // 4th element is data log index (not displayed)
@@ -231,17 +390,7 @@ void RideSelectionWindow::rideSelected(const QModelIndex& index)
 		if (!item)
 			return;
 
-		// Parse complete ride details
-		if (_current_data_log == 0 ||
-			_current_data_log->filename() != _log_dir_summary->log(item->text().toInt())._filename)
-		{
-			_current_data_log.reset(new DataLog);
-			if (!parse(_log_dir_summary->log(item->text().toInt())._filename, _current_data_log))
-				QMessageBox::warning(this, tr("RideViewer"), tr("Log file doesn't exist! Suggest you manually delete it from the logsummary.xml"));
-		}
-
-		// Notify to display the selected ride
-		emit displayRide(_current_data_log);
+		selectRide(item->text().toInt());
 	}
 	else // user seletected a lap
 	{
@@ -267,19 +416,41 @@ void RideSelectionWindow::rideSelected(const QModelIndex& index)
 	}
 }
 
+/******************************************************/
+void RideSelectionWindow::selectRide(int log_index)
+{
+	// Parse complete ride details
+	if (_current_data_log == 0 ||
+		_current_data_log->filename() != _log_dir_summary->log(log_index)._filename)
+	{
+		_current_data_log.reset(new DataLog);
+		if (!parse(_log_dir_summary->log(log_index)._filename, _current_data_log))
+			QMessageBox::warning(this, tr("RideViewer"), tr("Log file doesn't exist! Suggest you manually delete it from the logsummary.xml"));
+	}
+
+	// Notify to display the selected ride
+	emit displayRide(_current_data_log);
+}
+
 /******************************************************/
 bool RideSelectionWindow::parse(const QString filename, boost::shared_ptr<DataLog> data_log)
 {
+	BaseParser* parser;
 	if (filename.contains(".fit", Qt::CaseInsensitive))
 	{
-		return _fit_parser->parse(filename, data_log);
+		parser = _fit_parser;
 	}
 	else if (filename.contains(".tcx", Qt::CaseInsensitive))
 	{
-		return _tcx_parser->parse(filename, data_log);
+		parser = _tcx_parser;
 	}
 	else
 	{
 		return false; // unknown log type
 	}
+
+	const bool parsed = parser->parse(filename, data_log);
+	_parse_time += parser->parseTime();
+	_post_process_time += parser->postProcessTime();
+	return parsed;
 }
\ No newline at end of file
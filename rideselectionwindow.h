@@ -10,6 +10,8 @@ class QTreeView;
 class QStandardItemModel;
 class QModelIndex;
 class QLabel;
+class QCheckBox;
+class QStandardItem;
 class TcxParser;
 class FitParser;
 class DataLog;
@@ -33,21 +35,34 @@ class RideSelectionWindow : public QWidget
 
 private slots:
 	void rideSelected(const QModelIndex& index);
+	void groupByRouteChanged();
 
  private:
 	void populateTableWithRides();
+	void populateTableWithRoutes();
 	void formatTreeView();
+
+	// Create the items of a row for a ride (with the log index in the 4th hidden column)
+	void createRideRow(int log_index, QList<QStandardItem*>& ride_list) const;
+
+	// Select the ride of a log index, parsing it if not the current ride
+	void selectRide(int log_index);
 	bool parse(const QString filename, boost::shared_ptr<DataLog> data_log);
 
 	QTreeView* _tree;
 	QStandardItemModel* _model;
 	QLabel* _head_label;
+	QCheckBox* _group_by_route_box;
 	
 	TcxParser* _tcx_parser;
 	FitParser* _fit_parser;
 
 	boost::shared_ptr<DataLog> _current_data_log;
 	boost::scoped_ptr<LogDirectorySummary> _log_dir_summary;
+
+	// Time (ms) of the parse and post-process stages of the logs parsed since last reset
+	double _parse_time;
+	double _post_process_time;
  };
 
 #endif // RIDESELECTIONWINDOW_H
\ No newline at end of file
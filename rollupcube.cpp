@@ -0,0 +1,271 @@
+#include "rollupcube.h"
+
+#include <cassert>
+#include <algorithm>
+
+#include <QFile.h>
+#include <QSaveFile.h>
+#include <QDataStream.h>
+
+#define ROLLUP_CUBE_FILENAME "rollup.dat"
+#define ROLLUP_CUBE_MAGIC 0x524f4c4c // "ROLL"
+#define ROLLUP_CUBE_VERSION 1
+
+/****************************************/
+// Totals of a ride from its summary
+static void rideTotals(const LogSummary& log_summary, RollupTotals& totals)
+{
+	totals = RollupTotals();
+	totals._num_rides = 1;
+	totals._time = log_summary._time;
+	totals._dist = log_summary._dist;
+	totals._elevation_gain = log_summary._aggregates._elevation_gain;
+	totals._energy = log_summary._aggregates._energy;
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		totals._hr_zone_time[z] = log_summary._aggregates._hr_zone_time[z];
+}
+
+/****************************************/
+RollupTotals::RollupTotals():
+_num_rides(0),
+_time(0.0),
+_dist(0.0),
+_elevation_gain(0.0),
+_energy(0.0)
+{
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		_hr_zone_time[z] = 0.0;
+}
+
+/****************************************/
+void RollupTotals::add(const RollupTotals& other)
+{
+	_num_rides += other._num_rides;
+	_time += other._time;
+	_dist += other._dist;
+	_elevation_gain += other._elevation_gain;
+	_energy += other._energy;
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		_hr_zone_time[z] += other._hr_zone_time[z];
+}
+
+/****************************************/
+void RollupTotals::subtract(const RollupTotals& other)
+{
+	_num_rides -= other._num_rides;
+	_time -= other._time;
+	_dist -= other._dist;
+	_elevation_gain -= other._elevation_gain;
+	_energy -= other._energy;
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		_hr_zone_time[z] -= other._hr_zone_time[z];
+}
+
+/****************************************/
+RollupCube::RollupCube(const QString& log_directory):
+_log_directory(log_directory)
+{}
+
+/****************************************/
+RollupCube::~RollupCube()
+{}
+
+/****************************************/
+int RollupCube::numRides() const
+{
+	return _rides.size();
+}
+
+/****************************************/
+bool RollupCube::contains(const QString& filename) const
+{
+	return _rides.contains(filename);
+}
+
+/****************************************/
+QDate RollupCube::periodStart(RollupPeriod period, const QDate& date)
+{
+	switch (period)
+	{
+	case ROLLUP_DAY:
+		return date;
+	case ROLLUP_WEEK:
+		return date.addDays(1 - date.dayOfWeek());
+	case ROLLUP_MONTH:
+		return QDate(date.year(), date.month(), 1);
+	case ROLLUP_YEAR:
+		return QDate(date.year(), 1, 1);
+	default:
+		assert(false);
+		return date;
+	}
+}
+
+/****************************************/
+QDate RollupCube::nextPeriodStart(RollupPeriod period, const QDate& period_start)
+{
+	switch (period)
+	{
+	case ROLLUP_DAY:
+		return period_start.addDays(1);
+	case ROLLUP_WEEK:
+		return period_start.addDays(7);
+	case ROLLUP_MONTH:
+		return period_start.addMonths(1);
+	case ROLLUP_YEAR:
+		return period_start.addYears(1);
+	default:
+		assert(false);
+		return period_start;
+	}
+}
+
+/****************************************/
+void RollupCube::addRide(const LogSummary& log_summary)
+{
+	removeRideByName(log_summary._filename);
+
+	RideTotals ride;
+	ride._date = log_summary.date();
+	rideTotals(log_summary, ride._totals);
+	_rides.insert(log_summary._filename, ride);
+
+	for (int p=0; p < NUM_ROLLUP_PERIODS; ++p)
+		_periods[p][periodStart((RollupPeriod)p, ride._date).toJulianDay()].add(ride._totals);
+}
+
+/****************************************/
+bool RollupCube::removeRideByName(const QString& filename)
+{
+	QMap<QString, RideTotals>::iterator it = _rides.find(filename);
+	if (it == _rides.end())
+		return false;
+
+	for (int p=0; p < NUM_ROLLUP_PERIODS; ++p)
+	{
+		QMap<qint64, RollupTotals>::iterator period_it = _periods[p].find(periodStart((RollupPeriod)p, it.value()._date).toJulianDay());
+		assert(period_it != _periods[p].end());
+		period_it.value().subtract(it.value()._totals);
+		if (period_it.value()._num_rides <= 0) // drop empty periods, which also drops rounding left by the subtraction
+			_periods[p].erase(period_it);
+	}
+
+	_rides.erase(it);
+	return true;
+}
+
+/****************************************/
+void RollupCube::rebuild(const LogDirectorySummary& log_dir_summary)
+{
+	_rides.clear();
+	for (int p=0; p < NUM_ROLLUP_PERIODS; ++p)
+		_periods[p].clear();
+
+	for (int i=0; i < log_dir_summary.numLogs(); ++i)
+		addRide(log_dir_summary.log(i));
+}
+
+/****************************************/
+void RollupCube::query(RollupPeriod period, const QDate& from, const QDate& to, std::vector<std::pair<QDate, RollupTotals> >& totals) const
+{
+	totals.clear();
+	if (!from.isValid() || !to.isValid() || from > to)
+		return;
+
+	const QMap<qint64, RollupTotals>& periods = _periods[period];
+	const QMap<qint64, RollupTotals>& days = _periods[ROLLUP_DAY];
+	for (QMap<qint64, RollupTotals>::const_iterator it = periods.lowerBound(periodStart(period, from).toJulianDay()); it != periods.end() && it.key() <= to.toJulianDay(); ++it)
+	{
+		const QDate start = QDate::fromJulianDay(it.key());
+		const QDate end = nextPeriodStart(period, start).addDays(-1);
+		if (start >= from && end <= to)
+		{
+			totals.push_back(std::make_pair(start, it.value()));
+		}
+		else
+		{
+			// The period is cut by the range, so add up its days in the range
+			RollupTotals partial;
+			const qint64 first_day = std::max(start, from).toJulianDay();
+			const qint64 last_day = std::min(end, to).toJulianDay();
+			for (QMap<qint64, RollupTotals>::const_iterator day_it = days.lowerBound(first_day); day_it != days.end() && day_it.key() <= last_day; ++day_it)
+				partial.add(day_it.value());
+
+			if (partial._num_rides > 0)
+				totals.push_back(std::make_pair(start, partial));
+		}
+	}
+}
+
+/****************************************/
+bool RollupCube::readFromFile()
+{
+	_rides.clear();
+	for (int p=0; p < NUM_ROLLUP_PERIODS; ++p)
+		_periods[p].clear();
+
+	QFile file(_log_directory + "/" + ROLLUP_CUBE_FILENAME);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	qint32 version;
+	in >> magic >> version;
+	if (magic != ROLLUP_CUBE_MAGIC || version != ROLLUP_CUBE_VERSION)
+		return false; // stale file, rebuild from the log directory summary
+
+	// Only the rides are saved, the periods are summed again as they are read
+	qint32 num_rides;
+	in >> num_rides;
+	for (int r=0; r < num_rides && in.status() == QDataStream::Ok; ++r)
+	{
+		QString filename;
+		RideTotals ride;
+		in >> filename >> ride._date;
+		in >> ride._totals._time >> ride._totals._dist >> ride._totals._elevation_gain >> ride._totals._energy;
+		for (int z=0; z < NUM_HR_ZONES; ++z)
+			in >> ride._totals._hr_zone_time[z];
+		ride._totals._num_rides = 1;
+
+		_rides.insert(filename, ride);
+		for (int p=0; p < NUM_ROLLUP_PERIODS; ++p)
+			_periods[p][periodStart((RollupPeriod)p, ride._date).toJulianDay()].add(ride._totals);
+	}
+
+	if (in.status() != QDataStream::Ok)
+	{
+		_rides.clear();
+		for (int p=0; p < NUM_ROLLUP_PERIODS; ++p)
+			_periods[p].clear();
+		return false;
+	}
+	return true;
+}
+
+/****************************************/
+void RollupCube::writeToFile() const
+{
+	QSaveFile file(_log_directory + "/" + ROLLUP_CUBE_FILENAME);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+
+	out << (quint32)ROLLUP_CUBE_MAGIC << (qint32)ROLLUP_CUBE_VERSION;
+
+	out << (qint32)_rides.size();
+	for (QMap<QString, RideTotals>::const_iterator it = _rides.begin(); it != _rides.end(); ++it)
+	{
+		const RollupTotals& totals = it.value()._totals;
+		out << it.key() << it.value()._date;
+		out << totals._time << totals._dist << totals._elevation_gain << totals._energy;
+		for (int z=0; z < NUM_HR_ZONES; ++z)
+			out << totals._hr_zone_time[z];
+	}
+
+	file.commit();
+}
\ No newline at end of file
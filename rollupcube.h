@@ -0,0 +1,84 @@
+#ifndef ROLLUPCUBE_H
+#define ROLLUPCUBE_H
+
+#include "logdirectorysummary.h"
+
+#include <QString.h>
+#include <QDateTime.h>
+#include <QMap.h>
+
+#include <vector>
+
+// Periods of the rollup
+enum RollupPeriod
+{
+	ROLLUP_DAY = 0,
+	ROLLUP_WEEK, // monday to sunday
+	ROLLUP_MONTH,
+	ROLLUP_YEAR,
+	NUM_ROLLUP_PERIODS
+};
+
+/**********************************/
+struct RollupTotals
+{
+	int _num_rides;
+	double _time; //sec
+	double _dist; //m
+	double _elevation_gain; //m
+	double _energy; //kJ
+	double _hr_zone_time[NUM_HR_ZONES]; //sec
+
+	RollupTotals();
+	void add(const RollupTotals& other);
+	void subtract(const RollupTotals& other);
+};
+
+/* Class to store the totals of the rides in a log directory for every day, week, month
+   and year, so the totals window does not need to go through the rides. The totals of a
+   ride are added to the 4 periods containing it when the ride is added, and subtracted when
+   it is removed. A date range query takes the totals of the periods inside the range, and
+   adds up the days of the periods cut by the ends of the range. */
+
+class RollupCube
+ {
+ public:
+	RollupCube(const QString& log_directory);
+	~RollupCube();
+
+	int numRides() const;
+	bool contains(const QString& filename) const;
+
+	// First day of the period containing date
+	static QDate periodStart(RollupPeriod period, const QDate& date);
+	// First day of the next period
+	static QDate nextPeriodStart(RollupPeriod period, const QDate& period_start);
+
+	// Add a ride, replacing any ride with the same filename
+	void addRide(const LogSummary& log_summary);
+	bool removeRideByName(const QString& filename);
+
+	// Replace all the rides with those of a summary
+	void rebuild(const LogDirectorySummary& log_dir_summary);
+
+	// Totals of each period overlapping from-to (inclusive), counting only the rides in the
+	// range. Periods without rides are skipped. Each entry is the first day of the period and its totals
+	void query(RollupPeriod period, const QDate& from, const QDate& to, std::vector<std::pair<QDate, RollupTotals> >& totals) const;
+
+	bool readFromFile();
+	void writeToFile() const;
+
+ private:
+	struct RideTotals
+	{
+		QDate _date;
+		RollupTotals _totals;
+	};
+
+	QString _log_directory;
+
+	QMap<QString, RideTotals> _rides; // key=filename
+	QMap<qint64, RollupTotals> _periods[NUM_ROLLUP_PERIODS]; // key=julian day of the first day of the period
+ };
+
+#endif // ROLLUPCUBE_H
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "routeindex.h"
+#include "datalog.h"
+
+#include <cassert>
+#include <algorithm>
+
+/****************************************/
+// Mix the bits of a 64 bit value (splitmix64 finaliser)
+static inline quint64 mix(quint64 x)
+{
+	x ^= x >> 30;
+	x *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+	x ^= x >> 27;
+	x *= Q_UINT64_C(0x94d049bb133111eb);
+	x ^= x >> 31;
+	return x;
+}
+
+/****************************************/
+// Root of a ride in a union-find forest
+static int findRoot(QHash<int, int>& parents, int ride_id)
+{
+	int root = ride_id;
+	while (parents.value(root, root) != root)
+		root = parents.value(root);
+
+	// Path compression
+	while (ride_id != root)
+	{
+		const int next = parents.value(ride_id, ride_id);
+		parents[ride_id] = root;
+		ride_id = next;
+	}
+	return root;
+}
+
+/****************************************/
+// Order routes by number of rides (largest first), then by first ride
+static bool routeOrder(const std::vector<int>& route1, const std::vector<int>& route2)
+{
+	if (route1.size() != route2.size())
+		return route1.size() > route2.size();
+	return route1.front() < route2.front();
+}
+
+/****************************************/
+RouteIndex::RouteIndex():
+_signatures(),
+_buckets()
+{}
+
+/****************************************/
+RouteIndex::~RouteIndex()
+{}
+
+/****************************************/
+quint64 RouteIndex::geohash(double ltd, double lgd, int precision)
+{
+	assert(precision > 0 && precision <= 12);
+
+	double min_ltd = -90.0, max_ltd = 90.0;
+	double min_lgd = -180.0, max_lgd = 180.0;
+	quint64 hash = 0;
+	for (int bit=0; bit < 5*precision; ++bit)
+	{
+		hash <<= 1;
+		if (bit % 2 == 0) // even bits split the longitude
+		{
+			const double mid = 0.5*(min_lgd + max_lgd);
+			if (lgd >= mid)
+			{
+				hash |= 1;
+				min_lgd = mid;
+			}
+			else
+			{
+				max_lgd = mid;
+			}
+		}
+		else // odd bits split the latitude
+		{
+			const double mid = 0.5*(min_ltd + max_ltd);
+			if (ltd >= mid)
+			{
+				hash |= 1;
+				min_ltd = mid;
+			}
+			else
+			{
+				max_ltd = mid;
+			}
+		}
+	}
+	return hash;
+}
+
+/****************************************/
+void RouteIndex::cellSet(DataLog& data_log, std::vector<quint64>& cells)
+{
+	cells.clear();
+	if (!data_log.ltdValid() || !data_log.lgdValid())
+		return;
+
+	for (int i=0; i < data_log.numPoints(); ++i)
+	{
+		if (!data_log.sampleValid(LOG_GPS, i)) // no GPS fix
+			continue;
+
+		const quint64 cell = geohash(data_log.ltd(i), data_log.lgd(i));
+		if (cells.empty() || cells.back() != cell) // consecutive points are mostly in the same cell
+			cells.push_back(cell);
+	}
+
+	std::sort(cells.begin(), cells.end());
+	cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+}
+
+/****************************************/
+void RouteIndex::signature(const std::vector<quint64>& cells, std::vector<unsigned int>& signature)
+{
+	signature.clear();
+	if (cells.empty())
+		return;
+
+	// Each value is the minimum of a different hash function over the cells
+	signature.resize(ROUTE_SIGNATURE_SIZE, 0xffffffff);
+	for (unsigned int c=0; c < cells.size(); ++c)
+	{
+		const quint64 cell_hash = mix(cells[c]);
+		for (int h=0; h < ROUTE_SIGNATURE_SIZE; ++h)
+		{
+			const unsigned int value = (unsigned int)(mix(cell_hash + (quint64)(h+1)*Q_UINT64_C(0x9e3779b97f4a7c15)) >> 32);
+			signature[h] = std::min(signature[h], value);
+		}
+	}
+}
+
+/****************************************/
+void RouteIndex::signature(DataLog& data_log, std::vector<unsigned int>& signature)
+{
+	std::vector<quint64> cells;
+	cellSet(data_log, cells);
+	RouteIndex::signature(cells, signature);
+}
+
+/****************************************/
+double RouteIndex::similarity(const std::vector<unsigned int>& signature1, const std::vector<unsigned int>& signature2)
+{
+	if (signature1.size() != ROUTE_SIGNATURE_SIZE || signature2.size() != ROUTE_SIGNATURE_SIZE)
+		return 0.0;
+
+	int num_equal = 0;
+	for (int h=0; h < ROUTE_SIGNATURE_SIZE; ++h)
+	{
+		if (signature1[h] == signature2[h])
+			++num_equal;
+	}
+	return num_equal/(double)ROUTE_SIGNATURE_SIZE;
+}
+
+/****************************************/
+quint64 RouteIndex::bandKey(const std::vector<unsigned int>& signature, int band)
+{
+	const int rows = ROUTE_SIGNATURE_SIZE/ROUTE_LSH_BANDS;
+	quint64 key = (quint64)band;
+	for (int r=0; r < rows; ++r)
+		key = mix(key ^ signature[band*rows + r]);
+	return key;
+}
+
+/****************************************/
+void RouteIndex::addRide(int ride_id, const std::vector<unsigned int>& signature)
+{
+	if (signature.size() != ROUTE_SIGNATURE_SIZE)
+		return;
+
+	_signatures.insert(ride_id, signature);
+	for (int band=0; band < ROUTE_LSH_BANDS; ++band)
+		_buckets[bandKey(signature, band)].push_back(ride_id);
+}
+
+/****************************************/
+void RouteIndex::clear()
+{
+	_signatures.clear();
+	_buckets.clear();
+}
+
+/****************************************/
+void RouteIndex::candidates(const std::vector<unsigned int>& signature, std::vector<int>& ride_ids) const
+{
+	ride_ids.clear();
+	if (signature.size() != ROUTE_SIGNATURE_SIZE)
+		return;
+
+	for (int band=0; band < ROUTE_LSH_BANDS; ++band)
+	{
+		QHash<quint64, std::vector<int> >::const_iterator it = _buckets.find(bandKey(signature, band));
+		if (it != _buckets.end())
+			ride_ids.insert(ride_ids.end(), it.value().begin(), it.value().end());
+	}
+
+	std::sort(ride_ids.begin(), ride_ids.end());
+	ride_ids.erase(std::unique(ride_ids.begin(), ride_ids.end()), ride_ids.end());
+}
+
+/****************************************/
+void RouteIndex::similarRides(const std::vector<unsigned int>& signature, std::vector<int>& ride_ids) const
+{
+	std::vector<int> candidate_ids;
+	candidates(signature, candidate_ids);
+
+	// Keep the candidates which are similar enough, ordered by similarity
+	std::vector<std::pair<double, int> > similar;
+	for (unsigned int i=0; i < candidate_ids.size(); ++i)
+	{
+		const double sim = similarity(signature, _signatures.value(candidate_ids[i]));
+		if (sim >= ROUTE_SIMILARITY_THD)
+			similar.push_back(std::make_pair(-sim, candidate_ids[i]));
+	}
+	std::sort(similar.begin(), similar.end());
+
+	ride_ids.clear();
+	for (unsigned int i=0; i < similar.size(); ++i)
+		ride_ids.push_back(similar[i].second);
+}
+
+/****************************************/
+void RouteIndex::routes(std::vector<std::vector<int> >& routes) const
+{
+	// Join each ride with the similar rides it shares a bucket with
+	QHash<int, int> parents;
+	std::vector<int> candidate_ids;
+	for (QHash<int, std::vector<unsigned int> >::const_iterator it = _signatures.begin(); it != _signatures.end(); ++it)
+	{
+		candidates(it.value(), candidate_ids);
+		for (unsigned int i=0; i < candidate_ids.size(); ++i)
+		{
+			if (candidate_ids[i] <= it.key()) // each pair once
+				continue;
+
+			if (similarity(it.value(), _signatures.value(candidate_ids[i])) >= ROUTE_SIMILARITY_THD)
+			{
+				const int root1 = findRoot(parents, it.key());
+				const int root2 = findRoot(parents, candidate_ids[i]);
+				if (root1 != root2)
+					parents[std::max(root1, root2)] = std::min(root1, root2);
+			}
+		}
+	}
+
+	// Collect the rides of each root
+	QHash<int, std::vector<int> > groups;
+	const QList<int> joined = parents.keys();
+	for (int i=0; i < joined.size(); ++i)
+		groups[findRoot(parents, joined[i])].push_back(joined[i]);
+
+	routes.clear();
+	for (QHash<int, std::vector<int> >::iterator it = groups.begin(); it != groups.end(); ++it)
+	{
+		std::vector<int>& rides = it.value();
+		if (std::find(rides.begin(), rides.end(), it.key()) == rides.end())
+			rides.push_back(it.key()); // the root itself has no parent entry
+		std::sort(rides.begin(), rides.end());
+		routes.push_back(rides);
+	}
+	std::sort(routes.begin(), routes.end(), routeOrder);
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef ROUTEINDEX_H
+#define ROUTEINDEX_H
+
+#include <QHash.h>
+
+#include <vector>
+
+#define ROUTE_GEOHASH_PRECISION 7 // geohash characters of a route cell (~150m x 150m)
+#define ROUTE_SIGNATURE_SIZE 32 // number of MinHash values in a route signature
+#define ROUTE_LSH_BANDS 8 // signature bands hashed into buckets (4 values per band)
+#define ROUTE_SIMILARITY_THD 0.5 // estimated jaccard similarity above which 2 rides share a route
+
+class DataLog;
+
+/* Class to find rides on the same route using locality-sensitive hashing.
+   Each ride is reduced to the set of geohash cells it passes through, and the set to
+   a MinHash signature, where the fraction of equal values estimates the jaccard
+   similarity of two sets. Signatures are split into bands and each band is hashed into
+   a bucket, so rides with similar routes share a bucket and only those rides need to be
+   compared to find similar rides. */
+
+class RouteIndex
+ {
+ public:
+	RouteIndex();
+	~RouteIndex();
+
+	// Geohash (as an integer of 5*precision interleaved bits) of a lat/long
+	static quint64 geohash(double ltd, double lgd, int precision = ROUTE_GEOHASH_PRECISION);
+
+	// Sorted geohash cells of the GPS points of a ride
+	static void cellSet(DataLog& data_log, std::vector<quint64>& cells);
+
+	// MinHash signature of a set of cells, empty if there are no cells
+	static void signature(const std::vector<quint64>& cells, std::vector<unsigned int>& signature);
+
+	// Signature of the GPS points of a ride, empty if the ride has no GPS
+	static void signature(DataLog& data_log, std::vector<unsigned int>& signature);
+
+	// Estimated jaccard similarity [0.0-1.0] of the rides of 2 signatures
+	static double similarity(const std::vector<unsigned int>& signature1, const std::vector<unsigned int>& signature2);
+
+	// Add a ride to the index. Rides with an empty signature are not indexed
+	void addRide(int ride_id, const std::vector<unsigned int>& signature);
+	void clear();
+
+	// Rides similar to the given signature, most similar first
+	void similarRides(const std::vector<unsigned int>& signature, std::vector<int>& ride_ids) const;
+
+	// Group the indexed rides into routes, largest first. Rides with no similar ride are not grouped
+	void routes(std::vector<std::vector<int> >& routes) const;
+
+ private:
+	// Bucket key of a band of a signature
+	static quint64 bandKey(const std::vector<unsigned int>& signature, int band);
+
+	// Indexed rides that share a bucket with the signature (may include the ride itself)
+	void candidates(const std::vector<unsigned int>& signature, std::vector<int>& ride_ids) const;
+
+	QHash<int, std::vector<unsigned int> > _signatures;
+	QHash<quint64, std::vector<int> > _buckets;
+ };
+
+#endif // ROUTEINDEX_H
\ No newline at end of file
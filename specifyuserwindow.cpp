@@ -24,6 +24,7 @@ QWidget()
 	_hr_zone3_input = new QSpinBox();
 	_hr_zone4_input = new QSpinBox();
 	_hr_zone5_input = new QSpinBox();
+	_ftp_input = new QSpinBox();
 
 	_weight_input->setRange(10.0,200.0);
 	_hr_zone1_input->setRange(50,250);
@@ -31,6 +32,7 @@ QWidget()
 	_hr_zone3_input->setRange(50,250);
 	_hr_zone4_input->setRange(50,250);
 	_hr_zone5_input->setRange(50,250);
+	_ftp_input->setRange(0,600);
 
 	_hr_zone1_input->setValue(120);
 	_hr_zone2_input->setValue(140);
@@ -41,6 +43,7 @@ QWidget()
 	QLabel* name_label = new QLabel("Name:");
 	QLabel* log_directory_label = new QLabel("Logfile Directory:");
 	QLabel* weight_label = new QLabel("Weight (kg):");
+	QLabel* ftp_label = new QLabel("FTP (W, 0 if unknown):");
 	QLabel* hr_zone1_label = new QLabel("HR Zone 1 - recovery (bpm):");
 	QLabel* hr_zone2_label = new QLabel("HR Zone 2 - endurance (bpm):");
 	QLabel* hr_zone3_label = new QLabel("HR Zone 3 - tempo (bpm):");
@@ -68,6 +71,9 @@ QWidget()
 	grid_layout->addWidget(weight_label,3,0);
 	grid_layout->addWidget(_weight_input,3,1);
 
+	grid_layout->addWidget(ftp_label,4,0);
+	grid_layout->addWidget(_ftp_input,4,1);
+
 	grid_layout->addWidget(hr_zone1_label,5,0);
 	grid_layout->addWidget(_hr_zone1_input,5,1);
 
@@ -87,6 +93,7 @@ QWidget()
 	grid_layout->addWidget(cancel_button,10,1);
 
 	log_directory_label->setToolTip("This needs to be the directory where you hold all your ride logs. Either .fit or .tcx files. RiderViwer will not modify these files!");
+	ftp_label->setToolTip("Functional threshold power, the power you can hold for an hour. Used for the training stress of rides with power, rides without power use heart rate zones instead.");
 	directory_button->setToolTip("This needs to be the directory where you hold all your ride logs. Either .fit or .tcx files. RiderViwer will not modify these files!");
 	
 	show();
@@ -103,6 +110,7 @@ SpecifyUserWindow::~SpecifyUserWindow()
 	delete _hr_zone3_input;
 	delete _hr_zone4_input;
 	delete _hr_zone5_input;
+	delete _ftp_input;
 }
 
 /******************************************************/
@@ -116,6 +124,7 @@ void SpecifyUserWindow::setUser(boost::shared_ptr<User> user)
 	_hr_zone3_input->setValue(user->zone3());
 	_hr_zone4_input->setValue(user->zone4());
 	_hr_zone5_input->setValue(user->zone5());
+	_ftp_input->setValue(user->ftp());
 }
 
 /******************************************************/
@@ -139,7 +148,8 @@ void SpecifyUserWindow::createRider()
 			_hr_zone2_input->value(),
 			_hr_zone3_input->value(),
 			_hr_zone4_input->value(),
-			_hr_zone5_input->value()));
+			_hr_zone5_input->value(),
+			_ftp_input->value()));
 
 		emit userSelected(new_user);
 	}
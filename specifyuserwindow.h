@@ -38,6 +38,7 @@ private:
 	QSpinBox* _hr_zone3_input;
 	QSpinBox* _hr_zone4_input;
 	QSpinBox* _hr_zone5_input;
+	QSpinBox* _ftp_input;
 };
  
 #endif // SPECIFYUSERWINDOW_H
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include <QStringList.h>
 #include <QFile.h>
+#include <QElapsedTimer.h>
 #include <iostream>
 
 /******************************************************/
@@ -57,35 +58,57 @@ bool TcxParser::parseRideDetails(boost::shared_ptr<DataLog> data_log)
 			track_point = track.firstChild();
 			for (int i=0; i < num_track_pts; ++i)
 			{
+				// Elements which are present are readings, even if they are 0
+				bool has_speed = false, has_gps = false, has_heart_rate = false, has_dist = false, has_cadence = false, has_alt = false;
 				QStringList tmp_sl = track_point.firstChildElement("Time").firstChild().nodeValue().split('T');
 				if (tmp_sl.size() > 1) // check to ensure the time format is as expected
 				{
 					QString tmp_s = tmp_sl.at(1);
 					tmp_s.chop(1);
 					QStringList time_strings = tmp_s.split(':');
+					const QDomElement speed = track_point.firstChildElement("Extensions");
+					const QDomElement position = track_point.firstChildElement("Position");
+					const QDomElement heart_rate = track_point.firstChildElement("HeartRateBpm");
+					const QDomElement dist = track_point.firstChildElement("DistanceMeters");
+					const QDomElement cadence = track_point.firstChildElement("Cadence");
+					const QDomElement alt = track_point.firstChildElement("AltitudeMeters");
 					data_log->time(track_point_idx) = time_strings.at(0).toInt()*3600 + time_strings.at(1).toInt()*60 + time_strings.at(2).toInt();
-					data_log->speed(track_point_idx) = track_point.firstChildElement("Extensions").firstChild().firstChild().nodeValue().toDouble();
-					data_log->lgd(track_point_idx) = track_point.firstChildElement("Position").firstChildElement("LongitudeDegrees").firstChild().nodeValue().toDouble();
-					data_log->ltd(track_point_idx) = track_point.firstChildElement("Position").firstChildElement("LatitudeDegrees").firstChild().nodeValue().toDouble();
-					data_log->heartRate(track_point_idx) = track_point.firstChildElement("HeartRateBpm").firstChild().firstChild().nodeValue().toDouble();
-					data_log->dist(track_point_idx) = track_point.firstChildElement("DistanceMeters").firstChild().nodeValue().toDouble();
-					data_log->cadence(track_point_idx) = track_point.firstChildElement("Cadence").firstChild().nodeValue().toDouble();
-					data_log->alt(track_point_idx) = track_point.firstChildElement("AltitudeMeters").firstChild().nodeValue().toDouble();
+					data_log->speed(track_point_idx) = speed.firstChild().firstChild().nodeValue().toDouble();
+					data_log->lgd(track_point_idx) = position.firstChildElement("LongitudeDegrees").firstChild().nodeValue().toDouble();
+					data_log->ltd(track_point_idx) = position.firstChildElement("LatitudeDegrees").firstChild().nodeValue().toDouble();
+					data_log->heartRate(track_point_idx) = heart_rate.firstChild().firstChild().nodeValue().toDouble();
+					data_log->dist(track_point_idx) = dist.firstChild().nodeValue().toDouble();
+					data_log->cadence(track_point_idx) = cadence.firstChild().nodeValue().toDouble();
+					data_log->alt(track_point_idx) = alt.firstChild().nodeValue().toDouble();
+
+					has_speed = !speed.firstChild().firstChild().isNull();
+					has_gps = !position.firstChildElement("LatitudeDegrees").isNull() && !position.firstChildElement("LongitudeDegrees").isNull();
+					has_heart_rate = !heart_rate.isNull();
+					has_dist = !dist.isNull();
+					has_cadence = !cadence.isNull();
+					has_alt = !alt.isNull();
 				}
 				track_point = track_point.nextSibling();
 
 				// Sometimes the xml contains empty trackpoint nodes, with just a time, but no data.
 				// Here we check this, and don't increment counter if the trackpoint was empty
 				bool valid_track_point = true;
-				if (data_log->lgd(track_point_idx) == 0 && data_log->ltd(track_point_idx) == 0 && 
-					data_log->dist(track_point_idx) == 0)
+				if (!has_gps && !has_dist)
 				{
 					valid_track_point = false;
 					num_empty_track_points++;
 				}
 
 				if (valid_track_point)
+				{
+					data_log->setSampleValid(LOG_SPEED, track_point_idx, has_speed);
+					data_log->setSampleValid(LOG_GPS, track_point_idx, has_gps);
+					data_log->setSampleValid(LOG_HEART_RATE, track_point_idx, has_heart_rate);
+					data_log->setSampleValid(LOG_DIST, track_point_idx, has_dist);
+					data_log->setSampleValid(LOG_CADENCE, track_point_idx, has_cadence);
+					data_log->setSampleValid(LOG_ALT, track_point_idx, has_alt);
 					track_point_idx++;
+				}
 			}
 
 			track = track.nextSibling();
@@ -104,25 +127,6 @@ bool TcxParser::parseRideDetails(boost::shared_ptr<DataLog> data_log)
 	total_track_points -= num_empty_track_points;
 	data_log->resize(total_track_points);
 
-	// Clean up the ride time
-	for (int i=data_log->numPoints()-1; i >= 0; --i)
-	{
-		data_log->time(i) = data_log->time(i) - data_log->time(0);
-	}
-
-	// Clean up sporadic empty GPS points
-	for (int i=1; i < data_log->numPoints(); ++i)
-	{
-		if (data_log->lgd(i) == 0 && data_log->ltd(i) == 0 && data_log->dist(i) != 0)
-		{
-			data_log->lgd(i) = data_log->lgd(i-1);
-			data_log->ltd(i) = data_log->ltd(i-1);
-		}
-	}
-
-	// Set flags to indicate vailidity of data read
-	setDataValidFlags(*data_log);
-
 	if (data_log->numPoints() > 0)
 		return true;
 	else
@@ -145,11 +149,17 @@ bool TcxParser::parse(const QString& filename, boost::shared_ptr<DataLog> data_l
 	if (read_success)
 	{
 		data_log->filename() = filename;
+		QElapsedTimer timer;
+		timer.start();
 		read_success = parseRideDetails(data_log);
+		_parse_time = timer.nsecsElapsed()*1e-6;
+		_post_process_time = 0.0;
 		if (read_success)
 		{
-			computeAdditionalDetailts(*data_log);
+			timer.restart();
+			postProcess(*data_log);
 			data_log->computeMaps();
+			_post_process_time = timer.nsecsElapsed()*1e-6;
 		}
 	}
 	file.close();
@@ -14,6 +14,7 @@
 #include <QBoxLayout.h>
 #include <QCheckBox.h>
 #include <QComboBox.h>
+#include <QLabel.h>
 
 #include <iostream>
 
@@ -136,6 +137,20 @@ QWidget()
 
 	LogDirectorySummary log_dir_summary(_user->logDirectory());
 	log_dir_summary.readFromFile();
+
+	// Load the rollup of the ride totals, rebuilding it from the summary if it is missing or out of date
+	_rollup_cube.reset(new RollupCube(_user->logDirectory()));
+	if (!_rollup_cube->readFromFile() || _rollup_cube->numRides() != log_dir_summary.numLogs())
+	{
+		_rollup_cube->rebuild(log_dir_summary);
+		_rollup_cube->writeToFile();
+	}
+
+	// The stored channel histograms of the rides, for the time in each HR zone over the range
+	_histogram_store.reset(new HistogramStore(_user->logDirectory()));
+	_histogram_store->readFromFile();
+	_zone_times_label = new QLabel();
+
 	_date_selector_widget = new DateSelectorWidget();
 	_date_selector_widget->setRangeDates(log_dir_summary.firstLog().date(),log_dir_summary.lastLog().date());
 	
@@ -158,6 +173,7 @@ QWidget()
 
 	QVBoxLayout* layout = new QVBoxLayout(this);
 	layout->addWidget(_plot);
+	layout->addWidget(_zone_times_label);
 	layout->addWidget(controls);
 
 	setMinimumSize(800,400);
@@ -175,147 +191,80 @@ TotalsWindow::~TotalsWindow()
 /******************************************************/
 void TotalsWindow::recomputePlotData()
 {
-	_yearly_time.clear();
-	_yearly_dist.clear();
-	_monthly_time.clear();
-	_monthly_dist.clear();
-	_weekly_time.clear();
-	_weekly_dist.clear();
-
 	computeHistogramData();
 	computeCurves();
+	computeZoneTimes();
 	updatePlot();
 }
 
 /******************************************************/
 void TotalsWindow::computeHistogramData()
 {
-	// Read summary from file
-	LogDirectorySummary log_dir_summary(_user->logDirectory());
-	log_dir_summary.readFromFile();
-
-	for (int i=0; i < log_dir_summary.numLogs(); ++i)
-	{
-		QDate date = log_dir_summary.log(i).date();
-
-		// Check that the date is within the user selected range
-		if (date >= _date_selector_widget->minDate() && date <= _date_selector_widget->maxDate())
-		{
-			QMap<int, double>::iterator yearly_time_it = _yearly_time.find(date.year());
-			QMap<int, double>::iterator yearly_dist_it = _yearly_dist.find(date.year());
-			QMap<std::pair<int,int>, double>::iterator monthly_time_it = _monthly_time.find(std::make_pair(date.year(), date.month()));
-			QMap<std::pair<int,int>, double>::iterator monthly_dist_it = _monthly_dist.find(std::make_pair(date.year(), date.month()));
-			QMap<std::pair<int,int>, double>::iterator weekly_time_it = _weekly_time.find(std::make_pair(date.year(), date.weekNumber()));
-			QMap<std::pair<int,int>, double>::iterator weekly_dist_it = _weekly_dist.find(std::make_pair(date.year(), date.weekNumber()));
-
-			// Increment the yearly totals
-			if (yearly_time_it != _yearly_time.end())
-			{
-				yearly_time_it.value() += log_dir_summary.log(i)._time/3600.0; //hours
-				yearly_dist_it.value() += log_dir_summary.log(i)._dist/1000.0; //kms
-			}
-			else
-			{
-				_yearly_time.insert(date.year(), log_dir_summary.log(i)._time/3600.0);
-				_yearly_dist.insert(date.year(), log_dir_summary.log(i)._dist/1000.0);
-			}
-
-			// Increment the monthly totals
-			if (monthly_time_it != _monthly_time.end())
-			{
-				monthly_time_it.value() += log_dir_summary.log(i)._time/3600.0; //hours
-				monthly_dist_it.value() += log_dir_summary.log(i)._dist/1000.0; //kms
-			}
-			else
-			{
-				_monthly_time.insert(std::make_pair(date.year(), date.month()), log_dir_summary.log(i)._time/3600.0);
-				_monthly_dist.insert(std::make_pair(date.year(), date.month()), log_dir_summary.log(i)._dist/1000.0);
-			}
-
-			// Increment the weekly totals
-			if (weekly_time_it != _weekly_time.end())
-			{
-				weekly_time_it.value() += log_dir_summary.log(i)._time/3600.0; //hours
-				weekly_dist_it.value() += log_dir_summary.log(i)._dist/1000.0; //kms
-			}
-			else
-			{
-				_weekly_time.insert(std::make_pair(date.year(), date.weekNumber()), log_dir_summary.log(i)._time/3600.0);
-				_weekly_dist.insert(std::make_pair(date.year(), date.weekNumber()), log_dir_summary.log(i)._dist/1000.0);
-			}
-		} // if 
-	} // for
+	// Totals of the rides within the user selected range
+	const QDate min_date = _date_selector_widget->minDate();
+	const QDate max_date = _date_selector_widget->maxDate();
+	_rollup_cube->query(ROLLUP_WEEK, min_date, max_date, _weekly_totals);
+	_rollup_cube->query(ROLLUP_MONTH, min_date, max_date, _monthly_totals);
+	_rollup_cube->query(ROLLUP_YEAR, min_date, max_date, _yearly_totals);
 }
 
 /******************************************************/
 void TotalsWindow::computeCurves()
 {
-	// Weeks
-	QVector<std::pair<int,int> > tmp1 = QVector<std::pair<int,int> >::fromList(_weekly_time.keys());
-	QVector<double> x_data_weeks(tmp1.size());
-	for (int i=0; i < tmp1.size(); ++i)
-	{
-		QDate date(tmp1[i].first,1,1);
-		date = date.addDays(tmp1[i].second * 7);
-		QDateTime date_time(date);
-		x_data_weeks[i] = date_time.toTime_t();
-	}
-
+	// Weeks, placed on the thursday so the label gets the week and year it belongs to
 	QList< QPair<int, int> > dist_bar_heights;
 	QList< QPair<int, int> > time_bar_heights;
-	QVector<double> y_data_time_weeks = QVector<double>::fromList(_weekly_time.values());
-	QVector<double> y_data_dist_weeks = QVector<double>::fromList(_weekly_dist.values());
-	for (int i=0; i < y_data_dist_weeks.size(); ++i)
+	for (unsigned int i=0; i < _weekly_totals.size(); ++i)
 	{
-		dist_bar_heights.append(QPair<int, int>(y_data_dist_weeks.at(i), x_data_weeks.at(i) ));
-		time_bar_heights.append(QPair<int, int>(y_data_time_weeks.at(i), x_data_weeks.at(i) ));
+		QDateTime date_time(_weekly_totals[i].first.addDays(3));
+		dist_bar_heights.append(QPair<int, int>(_weekly_totals[i].second._dist/1000.0, date_time.toTime_t())); //kms
+		time_bar_heights.append(QPair<int, int>(_weekly_totals[i].second._time/3600.0, date_time.toTime_t())); //hours
 	}
 	_hist_weekly_dist->setData(dist_bar_heights);
 	_hist_weekly_time->setData(time_bar_heights);
 
 	// Months
-	QVector<std::pair<int,int> > tmp2 = QVector<std::pair<int,int> >::fromList(_monthly_time.keys());
-	QVector<double> x_data_months(tmp2.size());
-	for (int i=0; i < tmp2.size(); ++i)
-	{
-		QDateTime date_time(QDate(tmp2[i].first, tmp2[i].second, 15));
-		x_data_months[i] = date_time.toTime_t();
-	}
-
 	time_bar_heights.clear();
 	dist_bar_heights.clear();
-	QVector<double> y_data_time_months = QVector<double>::fromList(_monthly_time.values());
-	QVector<double> y_data_dist_months = QVector<double>::fromList(_monthly_dist.values());
-	for (int i=0; i < y_data_dist_months.size(); ++i)
+	for (unsigned int i=0; i < _monthly_totals.size(); ++i)
 	{
-		dist_bar_heights.append(QPair<int, int>(y_data_dist_months.at(i), x_data_months.at(i) ));
-		time_bar_heights.append(QPair<int, int>(y_data_time_months.at(i), x_data_months.at(i) ));
+		QDateTime date_time(_monthly_totals[i].first.addDays(14));
+		dist_bar_heights.append(QPair<int, int>(_monthly_totals[i].second._dist/1000.0, date_time.toTime_t()));
+		time_bar_heights.append(QPair<int, int>(_monthly_totals[i].second._time/3600.0, date_time.toTime_t()));
 	}
 	_hist_monthly_dist->setData(dist_bar_heights);
 	_hist_monthly_time->setData(time_bar_heights);
 	
 	// Years
-	QVector<int> tmp3 = QVector<int>::fromList(_yearly_time.keys());
-	QVector<double> x_data_years(tmp3.size());
-	for (int i=0; i < tmp3.size(); ++i)
-	{
-		QDateTime date_time(QDate(tmp3[i], 6, 15));
-		x_data_years[i] = date_time.toTime_t();
-	}
-
 	time_bar_heights.clear();
 	dist_bar_heights.clear();
-	QVector<double> y_data_time_years = QVector<double>::fromList(_yearly_time.values());
-	QVector<double> y_data_dist_years = QVector<double>::fromList(_yearly_dist.values());
-	for (int i=0; i < y_data_dist_years.size(); ++i)
+	for (unsigned int i=0; i < _yearly_totals.size(); ++i)
 	{
-		dist_bar_heights.append(QPair<int, int>(y_data_dist_years.at(i), x_data_years.at(i) ));
-		time_bar_heights.append(QPair<int, int>(y_data_time_years.at(i), x_data_years.at(i) ));
+		QDateTime date_time(QDate(_yearly_totals[i].first.year(), 6, 15));
+		dist_bar_heights.append(QPair<int, int>(_yearly_totals[i].second._dist/1000.0, date_time.toTime_t()));
+		time_bar_heights.append(QPair<int, int>(_yearly_totals[i].second._time/3600.0, date_time.toTime_t()));
 	}
 	_hist_yearly_dist->setData(dist_bar_heights);
 	_hist_yearly_time->setData(time_bar_heights);
 }
 
+/******************************************************/
+void TotalsWindow::computeZoneTimes()
+{
+	// Add the histograms of the rides within the user selected range
+	ChannelHistograms histograms;
+	_histogram_store->query(_date_selector_widget->minDate(), _date_selector_widget->maxDate(), histograms);
+
+	const double zones[NUM_HR_ZONES+1] = {(double)_user->zone1(), (double)_user->zone2(), (double)_user->zone3(), (double)_user->zone4(), (double)_user->zone5(), 1000.0};
+	QString text = "Time in HR zones (hours):";
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+	{
+		const double time = histograms.timeInRange(HISTOGRAM_HEART_RATE, zones[z], zones[z+1]);
+		text += "   Zone " + QString::number(z+1) + ": " + QString::number(time/3600.0, 'f', 1);
+	}
+	_zone_times_label->setText(text);
+}
+
 /******************************************************/
 void TotalsWindow::updatePlot()
 {
@@ -407,4 +356,4 @@ void TotalsWindow::updatePlot()
 
 	_plot->replot();
 	
-}
+}
\ No newline at end of file
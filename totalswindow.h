@@ -1,16 +1,22 @@
 #ifndef TOTALSWINDOW_H
 #define TOTALSWINDOW_H
  
+#include "rollupcube.h"
+#include "histogramstore.h"
+
 #include <Qwidget.h>
-#include <QMap.h>
+
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 
 class User;
 class QwtPlotCurve;
 class QwtPlot;
 class QCheckBox;
 class QComboBox;
+class QLabel;
 class BarChartItem;
 class DateSelectorWidget;
 
@@ -28,6 +34,7 @@ private slots:
 private:
 	void computeHistogramData();
 	void computeCurves();
+	void computeZoneTimes();
 
 	boost::shared_ptr<User> _user;
 
@@ -40,16 +47,18 @@ private:
 
 	QwtPlot* _plot;
 
-	QMap<int, double> _yearly_time; // year as int
-	QMap<int, double> _yearly_dist; // year as int
-	QMap<std::pair<int,int>, double> _monthly_time; // month as pair<year,month>
-	QMap<std::pair<int,int>, double> _monthly_dist; // month as pair<year,month>
-	QMap<std::pair<int,int>, double> _weekly_time; // week as pair<year, week num>
-	QMap<std::pair<int,int>, double> _weekly_dist; // week as pair<year, week num>
+	boost::scoped_ptr<RollupCube> _rollup_cube;
+	boost::scoped_ptr<HistogramStore> _histogram_store;
+
+	// Totals of the periods in the user selected range
+	std::vector<std::pair<QDate, RollupTotals> > _weekly_totals;
+	std::vector<std::pair<QDate, RollupTotals> > _monthly_totals;
+	std::vector<std::pair<QDate, RollupTotals> > _yearly_totals;
 
 	QCheckBox* _dist_cb;
 	QCheckBox* _time_cb;
 	QComboBox* _time_group_selector;
+	QLabel* _zone_times_label;
 
 	DateSelectorWidget* _date_selector_widget;
 };
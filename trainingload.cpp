@@ -0,0 +1,316 @@
+#include "trainingload.h"
+#include "logdirectorysummary.h"
+#include "user.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#include <QFile.h>
+#include <QSaveFile.h>
+#include <QStringList.h>
+#include <QDataStream.h>
+
+#define TRAINING_LOAD_FILENAME "trainingload.dat"
+#define TRAINING_LOAD_MAGIC 0x4c4f4144 // "LOAD"
+#define TRAINING_LOAD_VERSION 1
+#define MIN_DAILY_LOAD 1e-6 // daily loads below this are left over from removed rides
+
+/****************************************/
+TrainingLoad::TrainingLoad(const QString& log_directory):
+_log_directory(log_directory),
+_ftp(0)
+{}
+
+/****************************************/
+TrainingLoad::~TrainingLoad()
+{}
+
+/****************************************/
+int TrainingLoad::numRides() const
+{
+	return _rides.size();
+}
+
+/****************************************/
+bool TrainingLoad::contains(const QString& filename) const
+{
+	return _rides.contains(filename);
+}
+
+/****************************************/
+double TrainingLoad::rideLoad(const LogSummary& log_summary, const User& user)
+{
+	const RideAggregates& aggregates = log_summary._aggregates;
+
+	// Training stress score, with the intensity factor from the average power
+	if ((aggregates._valid_channels & CHANNEL_POWER) && aggregates._avg_power > 0.0 && user.ftp() > 0)
+	{
+		const double intensity_factor = aggregates._avg_power/user.ftp();
+		return (log_summary._time/3600.0)*intensity_factor*intensity_factor*100.0;
+	}
+
+	// Edwards TRIMP, the minutes in each zone weighted by the zone number
+	double trimp = 0.0;
+	for (int z=0; z < NUM_HR_ZONES; ++z)
+		trimp += (aggregates._hr_zone_time[z]/60.0)*(z+1);
+	return trimp;
+}
+
+/****************************************/
+void TrainingLoad::addRide(const LogSummary& log_summary, const User& user)
+{
+	removeRideByName(log_summary._filename);
+	_ftp = user.ftp();
+
+	RideLoad ride;
+	ride._date = log_summary.date();
+	ride._load = rideLoad(log_summary, user);
+	_rides.insert(log_summary._filename, ride);
+
+	updateSeries(addDailyLoad(ride._date, ride._load));
+}
+
+/****************************************/
+bool TrainingLoad::removeRideByName(const QString& filename)
+{
+	QMap<QString, RideLoad>::iterator it = _rides.find(filename);
+	if (it == _rides.end())
+		return false;
+
+	const int idx = addDailyLoad(it.value()._date, -it.value()._load);
+	if (_daily_load[idx] < MIN_DAILY_LOAD)
+		_daily_load[idx] = 0.0;
+	_rides.erase(it);
+
+	updateSeries(idx);
+	return true;
+}
+
+/****************************************/
+int TrainingLoad::removeMissingRides(const LogDirectorySummary& log_dir_summary)
+{
+	QStringList missing;
+	for (QMap<QString, RideLoad>::const_iterator it = _rides.begin(); it != _rides.end(); ++it)
+	{
+		if (log_dir_summary.indexOf(it.key()) < 0)
+			missing << it.key();
+	}
+
+	for (int i=0; i < missing.size(); ++i)
+		removeRideByName(missing[i]);
+	return missing.size();
+}
+
+/****************************************/
+int TrainingLoad::addMissingRides(const LogDirectorySummary& log_dir_summary, const User& user)
+{
+	int num_added = 0;
+	for (int i=0; i < log_dir_summary.numLogs(); ++i)
+	{
+		if (!_rides.contains(log_dir_summary.log(i)._filename))
+		{
+			addRide(log_dir_summary.log(i), user);
+			++num_added;
+		}
+	}
+	return num_added;
+}
+
+/****************************************/
+void TrainingLoad::rebuild(const LogDirectorySummary& log_dir_summary, const User& user)
+{
+	_ftp = user.ftp();
+	_rides.clear();
+	_first_day = QDate();
+	_daily_load.clear();
+
+	// Add the daily loads first so the series is computed once
+	for (int i=0; i < log_dir_summary.numLogs(); ++i)
+	{
+		RideLoad ride;
+		ride._date = log_dir_summary.log(i).date();
+		ride._load = rideLoad(log_dir_summary.log(i), user);
+		_rides.insert(log_dir_summary.log(i)._filename, ride);
+		addDailyLoad(ride._date, ride._load);
+	}
+	updateSeries(0);
+}
+
+/****************************************/
+int TrainingLoad::addDailyLoad(const QDate& day, double load)
+{
+	if (!_first_day.isValid())
+		_first_day = day;
+
+	// Prepend days, the whole series then needs updating anyway
+	if (day < _first_day)
+	{
+		const int num_days = day.daysTo(_first_day);
+		_daily_load.insert(_daily_load.begin(), num_days, 0.0);
+		_first_day = day;
+	}
+
+	const int idx = _first_day.daysTo(day);
+	if (idx >= (int)_daily_load.size())
+		_daily_load.resize(idx+1, 0.0);
+
+	_daily_load[idx] += load;
+	return idx;
+}
+
+/****************************************/
+void TrainingLoad::updateSeries(int first_idx)
+{
+	const int num_days = _daily_load.size();
+	_ctl.resize(num_days, 0.0);
+	_atl.resize(num_days, 0.0);
+
+	const double ctl_decay = exp(-1.0/CTL_TIME_CONSTANT);
+	const double atl_decay = exp(-1.0/ATL_TIME_CONSTANT);
+	for (int i=std::max(first_idx, 0); i < num_days; ++i)
+	{
+		const double prev_ctl = (i > 0 ? _ctl[i-1] : 0.0);
+		const double prev_atl = (i > 0 ? _atl[i-1] : 0.0);
+		_ctl[i] = prev_ctl*ctl_decay + _daily_load[i]*(1.0 - ctl_decay);
+		_atl[i] = prev_atl*atl_decay + _daily_load[i]*(1.0 - atl_decay);
+	}
+}
+
+/****************************************/
+QDate TrainingLoad::firstDay() const
+{
+	return _daily_load.empty() ? QDate() : _first_day;
+}
+
+/****************************************/
+QDate TrainingLoad::lastDay() const
+{
+	return _daily_load.empty() ? QDate() : _first_day.addDays(_daily_load.size()-1);
+}
+
+/****************************************/
+double TrainingLoad::dailyLoad(const QDate& day) const
+{
+	if (_daily_load.empty())
+		return 0.0;
+
+	const qint64 idx = _first_day.daysTo(day);
+	return (idx >= 0 && idx < (qint64)_daily_load.size()) ? _daily_load[idx] : 0.0;
+}
+
+/****************************************/
+double TrainingLoad::ctl(const QDate& day) const
+{
+	if (_ctl.empty())
+		return 0.0;
+
+	const qint64 idx = _first_day.daysTo(day);
+	if (idx < 0)
+		return 0.0;
+	if (idx < (qint64)_ctl.size())
+		return _ctl[idx];
+	return _ctl.back()*exp(-(idx - (qint64)_ctl.size() + 1)/CTL_TIME_CONSTANT);
+}
+
+/****************************************/
+double TrainingLoad::atl(const QDate& day) const
+{
+	if (_atl.empty())
+		return 0.0;
+
+	const qint64 idx = _first_day.daysTo(day);
+	if (idx < 0)
+		return 0.0;
+	if (idx < (qint64)_atl.size())
+		return _atl[idx];
+	return _atl.back()*exp(-(idx - (qint64)_atl.size() + 1)/ATL_TIME_CONSTANT);
+}
+
+/****************************************/
+double TrainingLoad::tsb(const QDate& day) const
+{
+	// Form going into the day, from the loads up to the day before
+	const QDate previous_day = day.addDays(-1);
+	return ctl(previous_day) - atl(previous_day);
+}
+
+/****************************************/
+bool TrainingLoad::readFromFile(const User& user)
+{
+	_rides.clear();
+	_first_day = QDate();
+	_daily_load.clear();
+	_ctl.clear();
+	_atl.clear();
+
+	QFile file(_log_directory + "/" + TRAINING_LOAD_FILENAME);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	qint32 version, ftp;
+	in >> magic >> version >> ftp;
+	if (magic != TRAINING_LOAD_MAGIC || version != TRAINING_LOAD_VERSION || ftp != user.ftp())
+		return false; // stale file, rebuild from the log directory summary
+	_ftp = ftp;
+
+	qint32 num_rides;
+	in >> num_rides;
+	for (int r=0; r < num_rides && in.status() == QDataStream::Ok; ++r)
+	{
+		QString filename;
+		RideLoad ride;
+		in >> filename >> ride._date >> ride._load;
+		_rides.insert(filename, ride);
+	}
+
+	// The series is saved too, so it is not computed again
+	qint32 num_days;
+	in >> _first_day >> num_days;
+	if (in.status() == QDataStream::Ok && num_days > 0)
+	{
+		_daily_load.resize(num_days);
+		_ctl.resize(num_days);
+		_atl.resize(num_days);
+		for (int i=0; i < num_days; ++i)
+			in >> _daily_load[i] >> _ctl[i] >> _atl[i];
+	}
+
+	if (in.status() != QDataStream::Ok)
+	{
+		_rides.clear();
+		_first_day = QDate();
+		_daily_load.clear();
+		_ctl.clear();
+		_atl.clear();
+		return false;
+	}
+	return true;
+}
+
+/****************************************/
+void TrainingLoad::writeToFile() const
+{
+	QSaveFile file(_log_directory + "/" + TRAINING_LOAD_FILENAME);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+
+	out << (quint32)TRAINING_LOAD_MAGIC << (qint32)TRAINING_LOAD_VERSION << (qint32)_ftp;
+
+	out << (qint32)_rides.size();
+	for (QMap<QString, RideLoad>::const_iterator it = _rides.begin(); it != _rides.end(); ++it)
+		out << it.key() << it.value()._date << it.value()._load;
+
+	out << _first_day << (qint32)_daily_load.size();
+	for (unsigned int i=0; i < _daily_load.size(); ++i)
+		out << _daily_load[i] << _ctl[i] << _atl[i];
+
+	file.commit();
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef TRAININGLOAD_H
+#define TRAININGLOAD_H
+
+#include <QString.h>
+#include <QDateTime.h>
+#include <QMap.h>
+
+#include <vector>
+
+#define CTL_TIME_CONSTANT 42.0 // days, chronic training load (fitness)
+#define ATL_TIME_CONSTANT 7.0 // days, acute training load (fatigue)
+
+struct LogSummary;
+class LogDirectorySummary;
+class User;
+
+/* Class to hold the training load of a rider over the whole history of the log directory.
+   The load of each day is the sum of the stress of its rides. The chronic (CTL) and acute
+   (ATL) training loads are exponentially weighted averages of the daily load, and the
+   training stress balance (TSB) is the difference between them on the previous day.
+   Since each day only depends on the day before, adding or removing a ride only updates
+   the series from the day of the ride onwards. */
+
+class TrainingLoad
+ {
+ public:
+	TrainingLoad(const QString& log_directory);
+	~TrainingLoad();
+
+	int numRides() const;
+	bool contains(const QString& filename) const;
+
+	// Stress of a ride: TSS from the average power if the ride has power and the user has an FTP,
+	// otherwise TRIMP from the time in each HR zone
+	static double rideLoad(const LogSummary& log_summary, const User& user);
+
+	// Add a ride, replacing any ride with the same filename
+	void addRide(const LogSummary& log_summary, const User& user);
+	bool removeRideByName(const QString& filename);
+
+	// Remove the rides which are no longer in a summary, and add the rides of the summary which
+	// are missing, each only updating the series from its day on. Return the number of rides changed
+	int removeMissingRides(const LogDirectorySummary& log_dir_summary);
+	int addMissingRides(const LogDirectorySummary& log_dir_summary, const User& user);
+
+	// Replace all the rides with those of a summary
+	void rebuild(const LogDirectorySummary& log_dir_summary, const User& user);
+
+	// Days of the series, invalid if there are no rides
+	QDate firstDay() const;
+	QDate lastDay() const;
+
+	// Series values of a day. After the last day the loads decay with no new rides
+	double dailyLoad(const QDate& day) const;
+	double ctl(const QDate& day) const;
+	double atl(const QDate& day) const;
+	double tsb(const QDate& day) const;
+
+	// Returns false if there is no file or its loads were computed with a different FTP
+	bool readFromFile(const User& user);
+	void writeToFile() const;
+
+ private:
+	struct RideLoad
+	{
+		QDate _date;
+		double _load;
+	};
+
+	// Add load to a day, extending the series to include it. Returns the index of the day
+	int addDailyLoad(const QDate& day, double load);
+
+	// Recompute the CTL and ATL from a day index to the end of the series
+	void updateSeries(int first_idx);
+
+	QString _log_directory;
+	int _ftp; // W, used for the ride loads
+
+	QMap<QString, RideLoad> _rides; // key=filename
+
+	QDate _first_day; // day of index 0 of the series
+	std::vector<double> _daily_load;
+	std::vector<double> _ctl;
+	std::vector<double> _atl;
+ };
+
+#endif // TRAININGLOAD_H
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "trainingloadwindow.h"
+#include "user.h"
+#include "logdirectorysummary.h"
+#include "trainingload.h"
+#include "dateselectorwidget.h"
+
+#include <qwt_plot.h>
+#include <qwt_plot_curve.h>
+#include <qwt_scale_draw.h>
+#include <qwt_legend.h>
+
+#include <QDateTime.h>
+#include <QIcon.h>
+#include <QBoxLayout.h>
+#include <QCheckBox.h>
+
+#include <algorithm>
+
+#define CTL_COLOUR Qt::darkBlue
+#define ATL_COLOUR Qt::darkRed
+#define TSB_COLOUR Qt::darkGreen
+
+/******************************************************/
+class DayScaleDraw: public QwtScaleDraw
+{
+public:
+	DayScaleDraw()
+	{}
+ 
+	virtual QwtText label(double v) const
+	{
+		return QDateTime::fromTime_t((int)v).toString("yyyy/MM/dd");
+	}
+};
+
+/******************************************************/
+TrainingLoadWindow::TrainingLoadWindow(boost::shared_ptr<User> user):
+QWidget()
+{
+	_user = user;
+
+	setWindowTitle(tr("Training Load"));
+	setWindowIcon(QIcon("./resources/rideviewer_head128x128.ico")); 
+
+	// Load the training load, rebuilding it from the summary if it is missing and updating the
+	// rides it differs from the summary by if it is out of date
+	LogDirectorySummary log_dir_summary(_user->logDirectory());
+	log_dir_summary.readFromFile();
+
+	_training_load.reset(new TrainingLoad(_user->logDirectory()));
+	if (!_training_load->readFromFile(*_user))
+	{
+		_training_load->rebuild(log_dir_summary, *_user);
+		_training_load->writeToFile();
+	}
+	else if (_training_load->removeMissingRides(log_dir_summary) + _training_load->addMissingRides(log_dir_summary, *_user) > 0)
+	{
+		_training_load->writeToFile();
+	}
+
+	// Create the plot
+	_plot = new QwtPlot();
+	_plot->setAxisScaleDraw(QwtPlot::xBottom, new DayScaleDraw());
+	_plot->setAxisLabelRotation(QwtPlot::xBottom, -90.0);
+	_plot->setAxisLabelAlignment(QwtPlot::xBottom, Qt::AlignLeft | Qt::AlignBottom);
+	_plot->insertLegend(new QwtLegend(), QwtPlot::TopLegend);
+
+	QwtText axis_text;
+	QFont font =  _plot->axisFont(QwtPlot::xBottom);
+	font.setPointSize(8);
+	axis_text.setFont(font);
+	axis_text.setText("Training load (TSS or TRIMP per day)");
+	_plot->setAxisTitle(QwtPlot::yLeft,axis_text);
+
+	_ctl_curve = new QwtPlotCurve("Fitness (CTL)");
+	_ctl_curve->setPen(QPen(CTL_COLOUR));
+	_ctl_curve->attach(_plot);
+
+	_atl_curve = new QwtPlotCurve("Fatigue (ATL)");
+	_atl_curve->setPen(QPen(ATL_COLOUR));
+	_atl_curve->attach(_plot);
+
+	_tsb_curve = new QwtPlotCurve("Form (TSB)");
+	_tsb_curve->setPen(QPen(TSB_COLOUR));
+	_tsb_curve->attach(_plot);
+
+	// Create GUI widgets
+	_ctl_cb = new QCheckBox("Fitness (CTL)");
+	_atl_cb = new QCheckBox("Fatigue (ATL)");
+	_tsb_cb = new QCheckBox("Form (TSB)");
+	_ctl_cb->setChecked(true);
+	_atl_cb->setChecked(true);
+	_tsb_cb->setChecked(true);
+
+	QPalette plt;
+	plt.setColor(QPalette::WindowText, CTL_COLOUR);
+	_ctl_cb->setPalette(plt);
+	plt.setColor(QPalette::WindowText, ATL_COLOUR);
+	_atl_cb->setPalette(plt);
+	plt.setColor(QPalette::WindowText, TSB_COLOUR);
+	_tsb_cb->setPalette(plt);
+
+	// The chart runs on to today, so the decay since the last ride shows
+	_date_selector_widget = new DateSelectorWidget();
+	if (_training_load->firstDay().isValid())
+	{
+		const QDate end_date = std::max(_training_load->lastDay(), QDate::currentDate());
+		_date_selector_widget->setRangeDates(_training_load->firstDay(), std::max(end_date, _training_load->firstDay().addDays(1)));
+	}
+
+	connect(_ctl_cb, SIGNAL(stateChanged(int)),this,SLOT(updatePlot()));
+	connect(_atl_cb, SIGNAL(stateChanged(int)),this,SLOT(updatePlot()));
+	connect(_tsb_cb, SIGNAL(stateChanged(int)),this,SLOT(updatePlot()));
+	connect(_date_selector_widget, SIGNAL(datesChanged()),this,SLOT(recomputePlotData()));
+
+	// Layout the GUI
+	QWidget* metric_ckboxs = new QWidget;
+	QVBoxLayout* vlayout = new QVBoxLayout(metric_ckboxs);
+	vlayout->addWidget(_ctl_cb);
+	vlayout->addWidget(_atl_cb);
+	vlayout->addWidget(_tsb_cb);
+
+	QWidget* controls = new QWidget;
+	QHBoxLayout* hlayout = new QHBoxLayout(controls);
+	hlayout->addWidget(_date_selector_widget);
+	hlayout->addWidget(metric_ckboxs);
+
+	QVBoxLayout* layout = new QVBoxLayout(this);
+	layout->addWidget(_plot);
+	layout->addWidget(controls);
+
+	setMinimumSize(800,400);
+	show();
+
+	recomputePlotData();
+}
+ 
+/******************************************************/
+TrainingLoadWindow::~TrainingLoadWindow()
+{
+
+}
+
+/******************************************************/
+void TrainingLoadWindow::recomputePlotData()
+{
+	QVector<double> x_data, ctl_data, atl_data, tsb_data;
+	if (_training_load->firstDay().isValid())
+	{
+		// Clip the selected range to the series
+		const QDate first_day = std::max(_date_selector_widget->minDate(), _training_load->firstDay());
+		const QDate last_day = _date_selector_widget->maxDate();
+		for (QDate day = first_day; day <= last_day; day = day.addDays(1))
+		{
+			x_data.push_back(QDateTime(day).toTime_t());
+			ctl_data.push_back(_training_load->ctl(day));
+			atl_data.push_back(_training_load->atl(day));
+			tsb_data.push_back(_training_load->tsb(day));
+		}
+	}
+
+	_ctl_curve->setSamples(x_data, ctl_data);
+	_atl_curve->setSamples(x_data, atl_data);
+	_tsb_curve->setSamples(x_data, tsb_data);
+
+	updatePlot();
+}
+
+/******************************************************/
+void TrainingLoadWindow::updatePlot()
+{
+	_ctl_curve->setVisible(_ctl_cb->isChecked());
+	_atl_curve->setVisible(_atl_cb->isChecked());
+	_tsb_curve->setVisible(_tsb_cb->isChecked());
+
+	_plot->setAxisAutoScale(QwtPlot::xBottom);
+	_plot->setAxisAutoScale(QwtPlot::yLeft);
+	_plot->replot();
+}
\ No newline at end of file
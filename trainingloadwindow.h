@@ -0,0 +1,46 @@
+#ifndef TRAININGLOADWINDOW_H
+#define TRAININGLOADWINDOW_H
+ 
+#include <Qwidget.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+
+class User;
+class TrainingLoad;
+class QwtPlotCurve;
+class QwtPlot;
+class QCheckBox;
+class DateSelectorWidget;
+
+/* Window to show the performance management chart of a rider: the fitness (CTL), fatigue (ATL)
+   and form (TSB) over the rides in the log directory. */
+
+class TrainingLoadWindow : public QWidget
+{
+	Q_OBJECT
+public:
+	TrainingLoadWindow(boost::shared_ptr<User> user);
+	~TrainingLoadWindow();
+
+private slots:
+	void updatePlot();
+	void recomputePlotData();
+
+private:
+	boost::shared_ptr<User> _user;
+	boost::scoped_ptr<TrainingLoad> _training_load;
+
+	QwtPlot* _plot;
+	QwtPlotCurve* _ctl_curve;
+	QwtPlotCurve* _atl_curve;
+	QwtPlotCurve* _tsb_curve;
+
+	QCheckBox* _ctl_cb;
+	QCheckBox* _atl_cb;
+	QCheckBox* _tsb_cb;
+
+	DateSelectorWidget* _date_selector_widget;
+};
+ 
+#endif // TRAININGLOADWINDOW_H
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "uniformlog.h"
+#include "datalog.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+/****************************************/
+UniformLog::UniformLog():
+_period(1.0/UNIFORM_SAMPLE_RATE),
+_start_time(0.0),
+_recorded_time(0.0),
+_moving_time(0.0)
+{}
+
+/****************************************/
+UniformLog::~UniformLog()
+{}
+
+/****************************************/
+void UniformLog::clear()
+{
+	_start_time = 0.0;
+	_valid.clear();
+	_moving.clear();
+	_dist.clear();
+	_alt.clear();
+	_heart_rate.clear();
+	_cadence.clear();
+	_speed.clear();
+	_power.clear();
+	_recorded_time = 0.0;
+	_moving_time = 0.0;
+}
+
+/****************************************/
+void UniformLog::resample(DataLog& data_log, double rate)
+{
+	assert(rate > 0.0);
+
+	clear();
+	_period = 1.0/rate;
+
+	const int n = data_log.numPoints();
+	if (n < 2 || !data_log.timeValid())
+		return;
+
+	const double* time = &data_log.time()[0];
+	_start_time = time[0];
+	const int num_samples = (int)floor((time[n-1] - time[0])*rate) + 1;
+
+	// Preallocate everything, then fill it in one pass
+	_valid.resize(num_samples);
+	_moving.resize(num_samples);
+	_dist.resize(num_samples);
+	_alt.resize(num_samples);
+	_heart_rate.resize(num_samples);
+	_cadence.resize(num_samples);
+	_speed.resize(num_samples);
+	_power.resize(num_samples);
+
+	const double* dist = &data_log.dist()[0];
+	const double* alt = &data_log.alt()[0];
+	const double* heart_rate = &data_log.heartRate()[0];
+	const double* cadence = &data_log.cadence()[0];
+	const double* speed = &data_log.speed()[0];
+	const double* power = &data_log.power()[0];
+	const bool speed_valid = data_log.speedValid();
+
+	int num_valid = 0;
+	int num_moving = 0;
+	int j = 0;
+	for (int i=0; i < num_samples; ++i)
+	{
+		// The samples and the points are both in time order, so each step is visited once
+		const double t = _start_time + i*_period;
+		while (j < n-2 && time[j+1] <= t)
+			++j;
+
+		const double dt = time[j+1] - time[j];
+		const bool valid = (dt <= UNIFORM_GAP_THD || t == time[j]);
+		const double frac = (valid && dt > 0.0) ? std::min((t - time[j])/dt, 1.0) : 0.0;
+
+		_dist[i] = dist[j] + frac*(dist[j+1] - dist[j]);
+		_alt[i] = alt[j] + frac*(alt[j+1] - alt[j]);
+		_heart_rate[i] = heart_rate[j] + frac*(heart_rate[j+1] - heart_rate[j]);
+		_cadence[i] = cadence[j] + frac*(cadence[j+1] - cadence[j]);
+		_speed[i] = speed[j] + frac*(speed[j+1] - speed[j]);
+		_power[i] = power[j] + frac*(power[j+1] - power[j]);
+
+		const bool moving = valid && (!speed_valid || _speed[i] >= MOVING_SPEED_THD);
+		_valid[i] = valid;
+		_moving[i] = moving;
+		num_valid += valid;
+		num_moving += moving;
+	}
+
+	_recorded_time = num_valid*_period;
+	_moving_time = num_moving*_period;
+}
+
+/****************************************/
+int UniformLog::index(double time) const
+{
+	if (_valid.empty())
+		return 0;
+
+	const int idx = (int)floor((time - _start_time)/_period);
+	return std::min(std::max(idx, 0), numSamples()-1);
+}
+
+/****************************************/
+double UniformLog::elapsedTime() const
+{
+	return _valid.empty() ? 0.0 : (numSamples()-1)*_period;
+}
+
+/****************************************/
+double UniformLog::timeInRange(const std::vector<double>& channel, double min_value, double max_value, int idx_start, int idx_end) const
+{
+	if (idx_end < 0)
+		idx_end = numSamples();
+	assert(idx_start >= 0 && idx_end <= numSamples());
+
+	// Masked count, without branches
+	int count = 0;
+	for (int i=idx_start; i < idx_end; ++i)
+		count += _valid[i] & (channel[i] >= min_value) & (channel[i] < max_value);
+	return count*_period;
+}
+
+/****************************************/
+double UniformLog::average(const std::vector<double>& channel, int idx_start, int idx_end) const
+{
+	if (idx_end < 0)
+		idx_end = numSamples();
+	assert(idx_start >= 0 && idx_end <= numSamples());
+
+	double sum = 0.0;
+	int count = 0;
+	for (int i=idx_start; i < idx_end; ++i)
+	{
+		sum += _valid[i]*channel[i];
+		count += _valid[i];
+	}
+	return (count > 0) ? sum/count : 0.0;
+}
+
+/****************************************/
+double UniformLog::movingTime(int idx_start, int idx_end) const
+{
+	assert(idx_start >= 0 && idx_end <= numSamples());
+
+	int count = 0;
+	for (int i=idx_start; i < idx_end; ++i)
+		count += _moving[i];
+	return count*_period;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef UNIFORMLOG_H
+#define UNIFORMLOG_H
+
+#include <vector>
+
+#define UNIFORM_SAMPLE_RATE 1.0 // Hz, default rate of the uniform samples
+#define UNIFORM_GAP_THD 10.0 // sec, longer steps between points are gaps (auto-pause, lost signal)
+#define MOVING_SPEED_THD 2.0 // km/h, slower samples are stopped
+
+class DataLog;
+
+/* Class to hold the points of a log resampled at a fixed rate. Log points are irregular
+   (smart recording, auto-pause, empty trackpoints), so time weighted computations over
+   point indecies have to handle the steps between points themselves. With a uniform stride
+   each sample stands for the same time, the sample of a time is found without a search,
+   and the time weighted computations reduce to masked sums.
+   Samples inside a gap have no data: they hold the values of the point before the gap and
+   are cleared in the valid mask. Samples slower than MOVING_SPEED_THD are cleared in the
+   moving mask. */
+
+class UniformLog
+ {
+ public:
+	UniformLog();
+	~UniformLog();
+
+	// Resample the points of a log in one pass. Sample i is at startTime() + i*period()
+	void resample(DataLog& data_log, double rate = UNIFORM_SAMPLE_RATE);
+	void clear();
+
+	int numSamples() const { return (int)_valid.size(); }
+	double period() const { return _period; } // sec
+	double startTime() const { return _start_time; } // sec
+
+	// Sample at or before a time, clamped to the samples
+	int index(double time) const;
+	double time(int idx) const { return _start_time + idx*_period; }
+
+	// Masks, 1 for samples with data (or moving), 0 otherwise
+	const std::vector<unsigned char>& valid() const { return _valid; }
+	const std::vector<unsigned char>& moving() const { return _moving; }
+
+	// Channels, in the units of the log
+	const std::vector<double>& dist() const { return _dist; }
+	const std::vector<double>& alt() const { return _alt; }
+	const std::vector<double>& heartRate() const { return _heart_rate; }
+	const std::vector<double>& cadence() const { return _cadence; }
+	const std::vector<double>& speed() const { return _speed; }
+	const std::vector<double>& power() const { return _power; }
+
+	// Times (sec) of the whole log
+	double elapsedTime() const; // including gaps
+	double recordedTime() const { return _recorded_time; } // excluding gaps
+	double movingTime() const { return _moving_time; } // excluding gaps and stops
+
+	// Time (sec) of the valid samples from idx_start to idx_end (exclusive, -1 for all samples)
+	// with a channel value in [min_value, max_value)
+	double timeInRange(const std::vector<double>& channel, double min_value, double max_value, int idx_start = 0, int idx_end = -1) const;
+
+	// Time weighted average of a channel over the valid samples
+	double average(const std::vector<double>& channel, int idx_start = 0, int idx_end = -1) const;
+
+	// Time (sec) of the moving samples
+	double movingTime(int idx_start, int idx_end) const;
+
+ private:
+	double _period;
+	double _start_time;
+
+	std::vector<unsigned char> _valid;
+	std::vector<unsigned char> _moving;
+
+	std::vector<double> _dist;
+	std::vector<double> _alt;
+	std::vector<double> _heart_rate;
+	std::vector<double> _cadence;
+	std::vector<double> _speed;
+	std::vector<double> _power;
+
+	double _recorded_time;
+	double _moving_time;
+ };
+
+#endif // UNIFORMLOG_H
\ No newline at end of file
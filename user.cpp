@@ -14,7 +14,8 @@ User::User(
 	int hr_zone2,
 	int hr_zone3,
 	int hr_zone4,
-	int hr_zone5):
+	int hr_zone5,
+	int ftp):
 _name(name),
 _log_directory(log_directory),
 _weight(weight),
@@ -22,11 +23,13 @@ _hr_zone1(hr_zone1),
 _hr_zone2(hr_zone2),
 _hr_zone3(hr_zone3),
 _hr_zone4(hr_zone4),
-_hr_zone5(hr_zone5)
+_hr_zone5(hr_zone5),
+_ftp(ftp)
 {}
 
 /****************************************/
-User::User()
+User::User():
+_ftp(0)
 {
 
 }
@@ -83,6 +86,12 @@ int User::zone5() const
 	return _hr_zone5;
 }
 
+/****************************************/
+int User::ftp() const
+{
+	return _ftp;
+}
+
 /****************************************/
 bool User::readFromFile(const QString& filename)
 {
@@ -104,6 +113,7 @@ bool User::readFromFile(const QString& filename)
 		_hr_zone3 = user.firstChildElement("HRZone3").firstChild().nodeValue().toDouble();
 		_hr_zone4 = user.firstChildElement("HRZone4").firstChild().nodeValue().toDouble();
 		_hr_zone5 = user.firstChildElement("HRZone5").firstChild().nodeValue().toDouble();
+		_ftp = user.firstChildElement("FTP").firstChild().nodeValue().toInt(); // 0 for riders saved without one
 	}
 	return read_success;
 }
@@ -155,6 +165,11 @@ void User::writeToFile(const QString& filename) const
 	text = dom_document.createTextNode(QString::number(_hr_zone5,'f',2));
 	hr_zone5.appendChild(text);
 
+	QDomElement ftp = dom_document.createElement("FTP");
+	user.appendChild(ftp);
+	text = dom_document.createTextNode(QString::number(_ftp));
+	ftp.appendChild(text);
+
 	const int indent = 4;
 	QString xml = dom_document.toString(indent);
 	std::ofstream file;
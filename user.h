@@ -15,7 +15,8 @@ class User
 		 int hr_zone2,
 		 int hr_zone3,
 		 int hr_zone4,
-		 int hr_zone5);
+		 int hr_zone5,
+		 int ftp);
 	User();
 	~User();
 
@@ -27,6 +28,7 @@ class User
 	int zone3() const;
 	int zone4() const;
 	int zone5() const;
+	int ftp() const;
 
 	bool readFromFile(const QString& filename);
 	void writeToFile(const QString& filename) const;
@@ -40,6 +42,7 @@ class User
 	 int _hr_zone3; // tempo
 	 int _hr_zone4; // threshold
 	 int _hr_zone5; // V02 max
+	 int _ftp; // functional threshold power (W), 0 if not known
  };
 
 #endif // USER_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef WEBMERCATOR_H
+#define WEBMERCATOR_H
+
+#include <math.h>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define WEB_MERCATOR_TILE_SIZE 256.0 // pixels
+#define WEB_MERCATOR_MAX_LTD 85.05112878 // deg, projection is undefined at the poles
+#define WEB_MERCATOR_EQUATOR_RESOLUTION 156543.03392 // metres per pixel at zoom 0
+
+// Spherical mercator projection, as used by google maps. Coordinates are in pixels
+// of the world map at the given zoom level (0,0 is the north west corner)
+// https://developers.google.com/maps/documentation/javascript/coordinates
+
+namespace WebMercator
+{
+	// Width (and height) of the world in pixels at the zoom level
+	inline double worldSize(int zoom)
+	{
+		return WEB_MERCATOR_TILE_SIZE * (double)(1 << zoom);
+	}
+
+	inline double xFromLgd(double lgd, int zoom)
+	{
+		return (lgd + 180.0)/360.0 * worldSize(zoom);
+	}
+
+	inline double yFromLtd(double ltd, int zoom)
+	{
+		const double ltd_clamped = std::min(std::max(ltd, -WEB_MERCATOR_MAX_LTD), WEB_MERCATOR_MAX_LTD);
+		const double sin_ltd = sin(ltd_clamped*M_PI/180.0);
+		return (0.5 - log((1.0 + sin_ltd)/(1.0 - sin_ltd))/(4.0*M_PI)) * worldSize(zoom);
+	}
+
+	inline double lgdFromX(double x, int zoom)
+	{
+		return x/worldSize(zoom)*360.0 - 180.0;
+	}
+
+	inline double ltdFromY(double y, int zoom)
+	{
+		const double n = M_PI - 2.0*M_PI*y/worldSize(zoom);
+		return atan(0.5*(exp(n) - exp(-n)))*180.0/M_PI;
+	}
+
+	// Size of a pixel on the ground, in metres
+	inline double metresPerPixel(double ltd, int zoom)
+	{
+		return WEB_MERCATOR_EQUATOR_RESOLUTION * cos(ltd*M_PI/180.0) / (double)(1 << zoom);
+	}
+};
+
+#endif // WEBMERCATOR_H
\ No newline at end of file